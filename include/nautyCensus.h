@@ -0,0 +1,99 @@
+#ifndef NAUTY_CENSUS_H
+#define NAUTY_CENSUS_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Register a graph in CSR form. Vertex v has out-neighbours
+// neighbors[offsets[v] .. offsets[v+1]-1]. Self-loops and repeated edges
+// are ignored. Returns a graph id >= 0, or -1 for a negative vertex count
+// and -2 for a neighbour outside 0..numVertices-1.
+int64_t nautyRegisterGraph(
+    int64_t numVertices,   // Number of vertices
+    int64_t offsets[],     // numVertices+1 row offsets
+    int64_t neighbors[],   // Concatenated out-neighbour lists
+    int64_t directed       // Nonzero for a digraph
+);
+
+// Drop a registered graph. Returns 0, or -1 for an unknown id.
+int64_t nautyReleaseGraph(int64_t graphId);
+
+// Estimate the census of connected induced motifSize-vertex subgraphs of a
+// registered graph by importance sampling. Classes are identified by their
+// canonical packed adjacency (bit i*motifSize+j for edge i->j).
+//
+// Sampling stops after sampleBudget samples, or earlier once every class
+// frequency has a 95% confidence half-width <= targetError (0 disables
+// early stopping). Classes are written in decreasing frequency, at most
+// maxClasses of them. Returns the number of classes found (which may exceed
+// maxClasses), or:
+//   -1 unknown graph id
+//   -2 motifSize outside 2..8
+//   -3 sampleBudget <= 0
+//
+// Samples are drawn in fixed chunks, each from a stream seeded by seed and
+// the chunk's position, and combined in chunk order, so the results depend
+// only on seed, sampleBudget and targetError, not on numThreads.
+int64_t nautySampleCensus(
+    int64_t graphId,
+    int64_t motifSize,
+    int64_t sampleBudget,      // Maximum number of samples
+    double targetError,        // Early-stop CI half-width on frequencies
+    int64_t seed,              // RNG seed
+    int64_t numThreads,        // <= 0 uses all hardware threads
+    int64_t maxClasses,        // Capacity of the output arrays
+    int64_t classKeys[],       // Canonical packed adjacency per class
+    double frequencies[],      // Estimated fraction of subgraphs in class
+    double ciLow[],            // 95% confidence interval on frequency
+    double ciHigh[],
+    double estimatedCounts[],  // Estimated number of subgraphs in class
+    int64_t* samplesUsed       // Samples actually drawn (may be null)
+);
+
+// Exact census of connected induced motifSize-vertex subgraphs by ESU
+// enumeration. Classes are written in decreasing count. Returns the number
+// of classes found, or -1 unknown graph id, -2 motifSize outside 2..8.
+int64_t nautyExactCensus(
+    int64_t graphId,
+    int64_t motifSize,
+    int64_t numThreads,        // <= 0 uses all hardware threads
+    int64_t maxClasses,
+    int64_t classKeys[],
+    int64_t counts[]
+);
+
+// Motif significance against a degree-preserving null model. Each replicate
+// is an in-memory copy of the registered graph randomised by
+// swapsPerEdge * |E| attempted double edge swaps; replicates are censused in
+// parallel and share the canonical cache. For each class,
+//   z = (observed - randomMean) / randomStdDev
+// which is 0 or +-infinity when the replicates have no spread. Classes are
+// written in decreasing z. Returns the number of classes found, or:
+//   -1 unknown graph id
+//   -2 motifSize outside 2..8
+//   -3 sampleBudget < 0
+//   -4 numReplicates < 1 or swapsPerEdge < 0
+int64_t nautyMotifSignificance(
+    int64_t graphId,
+    int64_t motifSize,
+    int64_t numReplicates,
+    int64_t swapsPerEdge,
+    int64_t sampleBudget,      // 0 for exact censuses, else samples per graph
+    int64_t seed,
+    int64_t numThreads,        // <= 0 uses all hardware threads
+    int64_t maxClasses,
+    int64_t classKeys[],
+    double observed[],         // Count in the registered graph
+    double randomMean[],       // Mean count over replicates
+    double randomStdDev[],
+    double zScores[]
+);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // NAUTY_CENSUS_H
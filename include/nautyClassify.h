@@ -29,6 +29,140 @@ int64_t c_nautyClassify(
 
 );
 
+// Label the batchSize n x n adjacency matrices of subgraph (as
+// c_nautyClassify; results receives n entries per matrix) with one of
+// nauty's vertex invariants, which can cut the search on regular and other
+// hard graphs by a large factor. invariant, the levels and invarArg are
+// labelg's -i, -I and -K (labelg's defaults are 0, 1:1 and 3). An
+// invariant changes which labelling is canonical, so results are
+// comparable only between calls with the same settings.
+//
+// With NAUTY_INVARIANT_AUTO the first few graphs that need a search are
+// labelled under each of none, adjtriang, distances, refinvar and
+// cellquads (at the root, argument 0), and the fastest is used for the
+// whole batch. chosen (may be null) receives the settings used, as
+// {invariant, minInvarLevel, maxInvarLevel, invarArg}, so later batches
+// can pass them explicitly and stay comparable.
+// Returns 0 on success, -1 if subgraphSize < 1, -4 for an invalid invariant.
+#define NAUTY_INVARIANT_AUTO -1
+int64_t nautyClassifyInvariant(
+    int64_t subgraph[],
+    int64_t subgraphSize,
+    int64_t results[],
+    int64_t batchSize,
+    int64_t invariant,         // 0..16, or NAUTY_INVARIANT_AUTO
+    int64_t minInvarLevel,
+    int64_t maxInvarLevel,
+    int64_t invarArg,
+    int64_t chosen[]           // 4 values out (may be null)
+);
+
+// Label a batch as nautyClassifyInvariant does, with search settings chosen
+// by workload rather than nauty's defaults:
+//   "default"       nautyClassify's settings
+//   "tiny-motif"    many graphs of a few vertices: always branch on the
+//                   first non-singleton cell, no invariant
+//   "sparse-large"  large sparse graphs: nauty's sparse-graph search with
+//                   its own target cell rule at tc_level 0 (the first
+//                   non-singleton cell), Schreier pruning
+//   "regular-hard"  regular graphs: nauty's best cell at every level, the
+//                   distances invariant at the root, Schreier pruning
+// Except for "default", symmetric matrices are labelled as undirected
+// graphs, which lets nauty use its cheaper automorphism tests and cell
+// choice on them. Each profile gives its own canonical labelling, so
+// results compare only between calls with the same profile.
+// nauty_profile_bench times each profile on representative graph families.
+// Returns 0 on success, -1 if subgraphSize < 1, -4 for an unknown profile.
+int64_t nautyClassifyProfile(
+    int64_t subgraph[],
+    int64_t subgraphSize,
+    int64_t results[],
+    int64_t batchSize,
+    const char* profile
+);
+
+// Label the batchSize n x n adjacency matrices of subgraph exactly as
+// nautyClassify does, spreading each graph's search over numThreads
+// threads (<= 0: one per hardware thread). The subtrees below the root of
+// nauty's search tree are searched concurrently, and the automorphisms
+// found in any of them are shared, so subtrees equivalent to one already
+// started are skipped. Pays off for large, highly symmetric graphs
+// (strongly regular, CFI-like) whose search takes milliseconds or more.
+// Returns 0 on success, -1 if subgraphSize < 1.
+int64_t nautyClassifyParallel(
+    int64_t subgraph[],
+    int64_t subgraphSize,
+    int64_t results[],
+    int64_t batchSize,
+    int64_t numThreads
+);
+
+// The automorphism group of each of the batchSize n x n adjacency matrices
+// of subgraph, searched as nautyClassifyParallel searches on numThreads
+// threads (<= 0: one per hardware thread). The order is that of a
+// stabiliser chain built from the generators every thread found, as
+// groupMantissa[i] * 10^groupExponent[i] (nauty's grpsize1 and grpsize2),
+// and numOrbits[i] is the number of vertex orbits.
+// Returns 0 on success, -1 if subgraphSize < 1.
+int64_t nautyClassifyGroup(
+    int64_t subgraph[],
+    int64_t subgraphSize,
+    int64_t batchSize,
+    int64_t numThreads,
+    double groupMantissa[],
+    int64_t groupExponent[],
+    int64_t numOrbits[]
+);
+
+// Size the calling thread's labelling buffers (the wrapper's matrices and
+// work arrays and nauty's own module storage) for graphs of up to maxN
+// vertices. Every classify call on this thread then reuses them from
+// graph to graph and allocates nothing for graphs that size or smaller,
+// so mixed-size batches stop growing them step by step. Only the edge
+// arrays of sparse-mode profiles still grow with the edge count. The
+// buffers stay until nautyClassifyRelease or the thread's exit.
+// Returns 0, or -1 if maxN < 1 or exceeds nauty's limit.
+int64_t nautyClassifyReserve(int64_t maxN);
+
+// Free all of the calling thread's labelling buffers now: the wrapper's and
+// nauty's (nauty_freedyn and the other modules' freedyn). A thread's
+// buffers are also freed when it exits. Returns 0.
+int64_t nautyClassifyRelease(void);
+
+// Cap, in bytes, on the labelling buffers one thread keeps between classify
+// calls; 0 (the default) means no cap. A thread whose buffers exceed it at
+// the end of a classify call frees them all, as nautyClassifyRelease does,
+// so one occasional huge graph no longer leaves its high-water mark behind
+// for the rest of the thread's life. Returns 0, or -1 if bytes < 0.
+int64_t nautyClassifyMemoryBudget(int64_t bytes);
+
+// Free the calling thread's labelling buffers now. With allThreads != 0
+// every other thread frees its own at the end of its next classify call
+// (only a thread can free its own buffers). Returns the bytes freed on the
+// calling thread, as nautyClassifyMemory counts them.
+int64_t nautyClassifyTrim(int64_t allThreads);
+
+// Bytes of labelling buffers held by each live thread that has run nauty or
+// a classify call, as of its last one, into bytes[0..maxThreads-1]. The
+// wrapper's buffers are counted exactly; nauty's module buffers as an upper
+// bound from the largest graph under 320 vertices since they were last
+// freed (nauty frees them itself after larger ones). Returns the number of
+// such threads, which may exceed maxThreads, or -1 if maxThreads < 0.
+int64_t nautyClassifyMemory(int64_t bytes[], int64_t maxThreads);
+
+// Counts over all nautyClassify, nautyClassifyInvariant,
+// nautyClassifyProfile and nautyClassifyParallel calls in the process,
+// since start-up or the last reset. Graphs whose unit partition
+// refines to a discrete one have a trivial automorphism group and are
+// labelled without nauty's search; [1] / [0] is that fast path's hit rate.
+// Writes NAUTY_CLASSIFY_STATS values to stats, resets the counts if
+// reset != 0, and returns 0:
+//   [0] graphs classified
+//   [1] graphs labelled by refinement alone
+//   [2] nauty search tree nodes for the rest
+#define NAUTY_CLASSIFY_STATS 3
+int64_t nautyClassifyStats(int64_t stats[], int64_t reset);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,105 @@
+#ifndef NAUTY_CONTAINER_H
+#define NAUTY_CONTAINER_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Layouts for nautyContainerWrite
+#define NAUTY_CONTAINER_DENSE 0   // m*n setword rows per graph, fixed stride
+#define NAUTY_CONTAINER_CSR   1   // Per-graph CSR block, any number of vertices
+
+// A container is a binary file of graphs that loads without decoding:
+//   64-byte header: magic "NAUTYGC", version, word size (64), layout,
+//                   flags, n (0 if sizes differ), m, graph count, and the
+//                   file offsets of the index and hash column
+//   data:           dense records of m*n setwords (nauty's row layout, bit 0
+//                   of a row being its most significant bit), or CSR blocks
+//                   of uint32 n, arc count, n+1 offsets and the targets,
+//                   padded to 8 bytes; undirected edges appear both ways
+//   index:          count+1 uint64 record offsets
+//   hash column:    optional (hash[0], hash[1], index) uint64 triples
+//                   sorted by hash, for lookup by canonical form
+// Everything is in the writer's byte order.
+
+// Convert a graph6, sparse6 or digraph6 file into a container, in input
+// order. With canonicalize set each graph is stored in canonical form;
+// otherwise graphs are stored as read (for input that is already
+// canonical, such as nautyClassifyStream output). withHashes adds the hash
+// column. Returns 0, or:
+//   -1 input cannot be opened
+//   -2 output cannot be written, or is "-" or an existing non-regular file
+//   -3 malformed input line, or a graph of more than 65536 vertices
+//   -4 invalid layout
+//   -5 graphs differ in directedness, or in size with the dense layout
+// On -3 and -5 the partly written output file is removed.
+int64_t nautyContainerWrite(
+    const char* inputPath,     // "-" for stdin
+    const char* outputPath,    // Must be a regular file
+    int64_t layout,            // NAUTY_CONTAINER_*
+    int64_t canonicalize,      // Nonzero to canonically label each graph
+    int64_t withHashes,        // Nonzero to add the sorted hash column
+    int64_t numThreads,        // <= 0 uses all hardware threads
+    int64_t* graphsWritten     // Graphs stored (may be null)
+);
+
+// Map a container read-only. Returns a container id >= 0, or -1 if the file
+// cannot be opened and -2 if it is not a valid container.
+int64_t nautyContainerOpen(const char* path);
+
+// Unmap a container. Pointers into it become invalid. Returns 0, or -1 for
+// an unknown id.
+int64_t nautyContainerClose(int64_t containerId);
+
+// Number of graphs, or -1 for an unknown id.
+int64_t nautyContainerCount(int64_t containerId);
+
+// Copy graph index into an adjacency matrix (row-major, 1 for an arc), as
+// nautyClassify takes. Returns its vertex count, or -1 for an unknown id,
+// -2 for an index out of range and -3 if it has more than maxVertices.
+int64_t nautyContainerGraph(
+    int64_t containerId,
+    int64_t index,
+    int64_t adjacency[],       // maxVertices*maxVertices entries
+    int64_t maxVertices
+);
+
+// Zero-copy access to graph index of a dense container: its m*n setword
+// rows, valid until the container is closed. Sets *n and *m. Returns null
+// for an unknown id, an index out of range or a CSR container.
+const uint64_t* nautyContainerRows(
+    int64_t containerId,
+    int64_t index,
+    int64_t* n,
+    int64_t* m
+);
+
+// Zero-copy access to graph index of a CSR container: vertex v has arcs to
+// targets[offsets[v] .. offsets[v+1]-1]. Returns the vertex count, or -1
+// for an unknown id, -2 for an index out of range and -3 for a dense
+// container.
+int64_t nautyContainerCsr(
+    int64_t containerId,
+    int64_t index,
+    const uint32_t** offsets,
+    const uint32_t** targets
+);
+
+// Find a graph, given as an adjacency matrix, in a container of canonical
+// graphs: it is canonically labelled and its hash binary-searched in the
+// hash column, and the match checked row for row. Returns the index of the
+// stored graph, or -1 for an unknown id, -2 if the container has no hash
+// column and -3 if the graph is not present.
+int64_t nautyContainerFind(
+    int64_t containerId,
+    int64_t adjacency[],       // n*n entries, nonzero for an arc
+    int64_t n
+);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // NAUTY_CONTAINER_H
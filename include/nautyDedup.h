@@ -0,0 +1,108 @@
+#ifndef NAUTY_DEDUP_H
+#define NAUTY_DEDUP_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Output modes for nautyDedupStream
+#define NAUTY_DEDUP_CANONICAL 0   // Canonical form of each new graph (uniqg default)
+#define NAUTY_DEDUP_INPUT     1   // Each new graph exactly as read (uniqg -k)
+#define NAUTY_DEDUP_HASH      2   // Binary hash of each new graph (uniqg -H)
+#define NAUTY_DEDUP_COUNT     3   // No output, only counts (uniqg -u)
+
+// Hash functions for nautyDedupStream
+#define NAUTY_HASH_FAST   0   // Multiply-mix hash of the canonical rows
+#define NAUTY_HASH_SHA256 1   // SHA-256 of the canonical rows, as uniqg
+
+// Remove isomorphic duplicates from a graph6, sparse6 or digraph6 file, as
+// uniqg does: graphs are labelled in parallel, their canonical forms hashed
+// straight from the rows, and the first graph of each class is written in
+// input order. Hashes are split across numThreads table shards, each owned
+// by one thread. keyBits (128 or 256) is the hash width kept; SHA-256 with
+// 256 bits gives uniqg's hashes. The fast hash is several times cheaper and
+// just as good when no one is crafting collisions. "-" selects
+// stdin/stdout; outputPath may be null with NAUTY_DEDUP_COUNT.
+// Returns 0 on success, or:
+//   -1 input cannot be opened
+//   -2 output cannot be opened or written
+//   -3 malformed input line, or a graph of more than 65536 vertices
+//   -4 invalid outputMode
+//   -5 invalid keyBits
+//   -6 invalid hashFunction
+int64_t nautyDedupStream(
+    const char* inputPath,
+    const char* outputPath,
+    int64_t outputMode,        // NAUTY_DEDUP_*
+    int64_t hashFunction,      // NAUTY_HASH_FAST or NAUTY_HASH_SHA256
+    int64_t keyBits,           // 128 or 256
+    int64_t numThreads,        // <= 0 uses all hardware threads
+    int64_t* graphsRead,       // Graphs read (may be null)
+    int64_t* graphsUnique      // Distinct graphs found (may be null)
+);
+
+// nautyDedupStream restricted to one slice of hash space, so that numShards
+// processes, on one machine or many, can split a file between them. Every
+// graph is labelled and hashed, but only those in shard shardIndex are
+// kept. A graph's shard is the low 32 bits of its key's second word times
+// numShards, shifted right by 32, which depends only on the graph, the
+// hash function and keyBits. Shard outputs are disjoint, so together they
+// hold every class exactly once; nautyDedupMerge joins them. Returns the
+// nautyDedupStream codes, or -9 for an invalid shard.
+int64_t nautyDedupShard(
+    const char* inputPath,
+    const char* outputPath,
+    int64_t outputMode,        // NAUTY_DEDUP_*
+    int64_t hashFunction,      // NAUTY_HASH_FAST or NAUTY_HASH_SHA256
+    int64_t keyBits,           // 128 or 256
+    int64_t shardIndex,        // 0 .. numShards - 1
+    int64_t numShards,         // Number of processes splitting the file
+    int64_t numThreads,        // <= 0 uses all hardware threads
+    int64_t* graphsRead,       // Graphs read (may be null)
+    int64_t* graphsUnique      // Distinct graphs in this shard (may be null)
+);
+
+// Concatenate the outputs of nautyDedupShard, in the order given, into
+// outputPath ("-" for stdout). For graph output, the ">>graph6<<" style
+// header, which one of the shards holds, is moved to the front. Returns 0,
+// -1 if a shard cannot be read, -2 if the output cannot be written, or -4
+// for an invalid outputMode.
+int64_t nautyDedupMerge(
+    const char* const* shardPaths,
+    int64_t numPaths,
+    const char* outputPath,
+    int64_t outputMode         // NAUTY_DEDUP_* the shards were written with
+);
+
+// nautyDedupStream for files with more distinct graphs than fit in memory.
+// Keys are buffered up to memoryBytes, then sorted and spilled as binary
+// runs to unlinked files in tempDir, and the runs are merged with
+// read-ahead to find the first graph of each class. Runs are merged a
+// bounded number at a time, set by memoryBytes and the open-file limit, so
+// any number of them can be spilled. Graph output needs a
+// second pass over the input, so it must then be a regular file. Output is
+// the same as nautyDedupStream's, in input order. tempDir may be null for
+// $TMPDIR or /tmp; memoryBytes <= 0 gives 1 GiB.
+// Returns the nautyDedupStream codes, or:
+//   -7 temporary runs cannot be written or read back
+//   -8 input is not a regular file and output needs a second pass
+int64_t nautyDedupExternal(
+    const char* inputPath,
+    const char* outputPath,
+    int64_t outputMode,        // NAUTY_DEDUP_*
+    int64_t hashFunction,      // NAUTY_HASH_FAST or NAUTY_HASH_SHA256
+    int64_t keyBits,           // 128 or 256
+    int64_t memoryBytes,       // Memory for buffered keys
+    const char* tempDir,       // Directory for runs (may be null)
+    int64_t numThreads,        // <= 0 uses all hardware threads
+    int64_t* graphsRead,       // Graphs read (may be null)
+    int64_t* graphsUnique      // Distinct graphs found (may be null)
+);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // NAUTY_DEDUP_H
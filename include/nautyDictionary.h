@@ -0,0 +1,66 @@
+#ifndef NAUTY_DICTIONARY_H
+#define NAUTY_DICTIONARY_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// A class dictionary gives each motif class a stable dense id: classes are
+// numbered 0, 1, 2, ... in the order they are first added by any run, and
+// the numbering is kept in a file so every later run, process and locale
+// sharing the file sees the same ids. The file is a 64-byte header followed
+// by one 16-byte (class key, motif size) entry per class, the entry's
+// position being its id; it is only ever appended to, under flock, so it
+// must be on a filesystem that honours flock. Class keys are the canonical
+// packed adjacency the census functions write.
+//
+// Lookups of known classes read an in-memory table without locking. A miss
+// first picks up entries other processes have appended, then appends the
+// class if it is still missing.
+
+// Open a dictionary, creating an empty one if path does not exist. Returns
+// a dictionary id >= 0, or -1 if the file cannot be opened or created and
+// -2 if it is not a valid dictionary.
+int64_t nautyDictionaryOpen(const char* path);
+
+// Close a dictionary. Returns 0, or -1 for an unknown id.
+int64_t nautyDictionaryClose(int64_t dictId);
+
+// Number of classes this process knows of, or -1 for an unknown id.
+int64_t nautyDictionarySize(int64_t dictId);
+
+// Write the id of each of count classes of motifSize vertices to classIds,
+// adding those not yet in the dictionary. Returns the number of classes
+// this call added, or:
+//   -1 unknown dictionary id
+//   -2 motifSize outside 2..8, or a key with bits beyond motifSize^2
+//   -3 the dictionary file cannot be written
+int64_t nautyDictionaryIds(
+    int64_t dictId,
+    int64_t motifSize,
+    const int64_t classKeys[],   // Canonical packed adjacency per class
+    int64_t count,
+    int64_t classIds[]           // Output: stable id per class
+);
+
+// The id of one class without adding it. Returns the id, or -1 unknown
+// dictionary id, -2 invalid motifSize or key, -3 class not in the
+// dictionary.
+int64_t nautyDictionaryFind(int64_t dictId, int64_t motifSize, int64_t classKey);
+
+// The class with a given id. Returns 0, or -1 unknown dictionary id, -2 no
+// such class.
+int64_t nautyDictionaryClass(
+    int64_t dictId,
+    int64_t classId,
+    int64_t* motifSize,
+    int64_t* classKey
+);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // NAUTY_DICTIONARY_H
@@ -0,0 +1,69 @@
+#ifndef NAUTY_STREAM_H
+#define NAUTY_STREAM_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Output formats for nautyClassifyStream
+#define NAUTY_OUTPUT_CANONICAL 0   // Canonical graph in the input's format, one per line
+#define NAUTY_OUTPUT_HASH      1   // 16-byte binary hash of the canonical graph
+
+// Canonically label every graph in a graph6, sparse6 or digraph6 file in
+// parallel. "-" selects stdin/stdout, so pipes work. With ordered != 0 the
+// output follows input order; otherwise batches are written as they finish.
+// Returns 0 on success, or:
+//   -1 input cannot be opened
+//   -2 output cannot be opened or written
+//   -3 malformed input line, or a graph of more than 65536 vertices
+//      (output stops at the batch containing it)
+//   -4 invalid outputFormat
+int64_t nautyClassifyStream(
+    const char* inputPath,
+    const char* outputPath,
+    int64_t outputFormat,      // NAUTY_OUTPUT_CANONICAL or NAUTY_OUTPUT_HASH
+    int64_t ordered,           // Keep input order
+    int64_t numThreads,        // <= 0 uses all hardware threads
+    int64_t* graphsProcessed   // Graphs written (may be null)
+);
+
+// Parallel replacement for labelg: canonically label every graph of a
+// graph6, sparse6 or digraph6 file exactly as labelg would, writing the
+// results in input order and in the input's format. The arguments match
+// labelg's options; labelg's defaults are vertexFormat = null, invariant = 0,
+// levels 1:1 and invarArg 3.
+// Returns as nautyClassifyStream, with -4 meaning an invalid invariant.
+int64_t nautyLabelStream(
+    const char* inputPath,
+    const char* outputPath,
+    const char* vertexFormat,  // labelg -f colour string (may be null)
+    int64_t invariant,         // labelg -i, 0..16 (0 = none)
+    int64_t minInvarLevel,     // labelg -I min
+    int64_t maxInvarLevel,     // labelg -I max
+    int64_t invarArg,          // labelg -K
+    int64_t numThreads,        // <= 0 uses all hardware threads
+    int64_t* graphsProcessed   // Graphs written (may be null)
+);
+
+// Queue statistics of the last streaming run on the calling thread, by any
+// of the streaming APIs (labelling, dedup, containers), for tuning the
+// thread count. Regular files are read ahead of the workers, pipes by a
+// reader thread; labelling runs on the workers, so the balance between
+// them shows in how often each side waits on the work queue. Writes
+// NAUTY_STREAM_STATS values to stats and returns 0:
+//   [0] batches read (about 1 MiB each)
+//   [1] times the reader found the work queue full: labelling is the limit
+//   [2] times a worker found the work queue empty: input is the limit
+//   [3] work queue depth summed over the batches taken; / [0] is the mean
+//   [4] work queue capacity, in batches
+//   [5] times the writer found no finished batch waiting
+#define NAUTY_STREAM_STATS 6
+int64_t nautyStreamStats(int64_t stats[]);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // NAUTY_STREAM_H
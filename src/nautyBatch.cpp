@@ -0,0 +1,244 @@
+#include "nautyBatch.h"
+#include <algorithm>
+#include <cstring>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#define NAUTY_BATCH_X86 1
+#endif
+
+namespace {
+
+// Lane state, vertex-major, so every loop over lanes is a run of vector ops
+// with no branches on the graphs.
+struct LaneState {
+    uint64_t rows[MAX_PACKED_SIZE][BATCH_LANES];
+    uint64_t colour[MAX_PACKED_SIZE][BATCH_LANES];
+    uint64_t sig[MAX_PACKED_SIZE][BATCH_LANES];
+    uint64_t first[MAX_PACKED_SIZE][BATCH_LANES];
+    uint64_t cells[BATCH_LANES];
+};
+
+// Each round gives vertex v the signature (colour of v, number of out- and
+// of in-neighbours of each colour) and recolours every vertex by the rank
+// of its signature among the lane's distinct ones. Colours stay below
+// k <= 8 and counts of a loopless graph below 8, so each count takes 3 bits:
+// out-counts from bit 0, in-counts from bit 24, the colour from bit 48.
+// refine1 splits by arcs out of a cell of several vertices but by arcs into
+// a single one, so it needs both directions to split no further than this.
+__attribute__((always_inline)) inline void refineLanesBody(const uint64_t* packed, int k,
+                                                           LaneState& s) {
+    const uint64_t rowMask = (1ULL << k) - 1;
+    for (int v = 0; v < k; v++) {
+        for (int l = 0; l < BATCH_LANES; l++) {
+            s.rows[v][l] = packed[l] >> (v * k) & rowMask;
+            s.colour[v][l] = 0;
+        }
+    }
+    for (int l = 0; l < BATCH_LANES; l++) s.cells[l] = 1;
+
+    for (int round = 0; round < k; round++) {
+        for (int v = 0; v < k; v++) {
+            for (int l = 0; l < BATCH_LANES; l++) s.sig[v][l] = s.colour[v][l] << 48;
+            for (int j = 0; j < k; j++) {
+                for (int l = 0; l < BATCH_LANES; l++) {
+                    s.sig[v][l] += (s.rows[v][l] >> j & 1) << (s.colour[j][l] * 3);
+                    s.sig[v][l] += (s.rows[j][l] >> v & 1) << (24 + s.colour[j][l] * 3);
+                }
+            }
+        }
+        // first[u] marks the first vertex with its signature.
+        for (int u = 0; u < k; u++) {
+            for (int l = 0; l < BATCH_LANES; l++) s.first[u][l] = 1;
+            for (int w = 0; w < u; w++) {
+                for (int l = 0; l < BATCH_LANES; l++) {
+                    s.first[u][l] &= (uint64_t)(s.sig[w][l] != s.sig[u][l]);
+                }
+            }
+        }
+        for (int v = 0; v < k; v++) {
+            for (int l = 0; l < BATCH_LANES; l++) s.colour[v][l] = 0;
+            for (int u = 0; u < k; u++) {
+                for (int l = 0; l < BATCH_LANES; l++) {
+                    s.colour[v][l] += s.first[u][l] & (uint64_t)(s.sig[u][l] < s.sig[v][l]);
+                }
+            }
+        }
+        uint64_t split = 0;
+        for (int l = 0; l < BATCH_LANES; l++) {
+            uint64_t cells = 0;
+            for (int u = 0; u < k; u++) cells += s.first[u][l];
+            split |= cells ^ s.cells[l];
+            s.cells[l] = cells;
+        }
+        if (split == 0) break;
+    }
+}
+
+void refineLanesGeneric(const uint64_t* packed, int k, LaneState& s) {
+    refineLanesBody(packed, k, s);
+}
+
+#ifdef NAUTY_BATCH_X86
+// The same rounds four lanes to a register. Each group of four runs until
+// none of its lanes splits, with the arcs unpacked once into one bit per
+// lane.
+__attribute__((target("avx2")))
+void refineLanesAvx2(const uint64_t* packed, int k, LaneState& s) {
+    const __m256i one = _mm256_set1_epi64x(1);
+    const __m256i inBase = _mm256_set1_epi64x(24);
+    for (int base = 0; base < BATCH_LANES; base += 4) {
+        __m256i p = _mm256_loadu_si256((const __m256i*)(packed + base));
+        __m256i arc[MAX_PACKED_SIZE][MAX_PACKED_SIZE];
+        __m256i colour[MAX_PACKED_SIZE], sig[MAX_PACKED_SIZE], first[MAX_PACKED_SIZE];
+        for (int v = 0; v < k; v++) {
+            for (int j = 0; j < k; j++) {
+                arc[v][j] = _mm256_and_si256(_mm256_srl_epi64(p, _mm_cvtsi32_si128(v * k + j)), one);
+            }
+            colour[v] = _mm256_setzero_si256();
+        }
+        __m256i cells = one;
+
+        for (int round = 0; round < k; round++) {
+            __m256i outShift[MAX_PACKED_SIZE], inShift[MAX_PACKED_SIZE];
+            for (int j = 0; j < k; j++) {
+                outShift[j] = _mm256_add_epi64(colour[j], _mm256_add_epi64(colour[j], colour[j]));
+                inShift[j] = _mm256_add_epi64(outShift[j], inBase);
+            }
+            for (int v = 0; v < k; v++) {
+                __m256i x = _mm256_slli_epi64(colour[v], 48);
+                for (int j = 0; j < k; j++) {
+                    x = _mm256_add_epi64(x, _mm256_sllv_epi64(arc[v][j], outShift[j]));
+                    x = _mm256_add_epi64(x, _mm256_sllv_epi64(arc[j][v], inShift[j]));
+                }
+                sig[v] = x;
+            }
+            __m256i next = _mm256_setzero_si256();
+            for (int u = 0; u < k; u++) {
+                first[u] = one;
+                for (int w = 0; w < u; w++) {
+                    first[u] = _mm256_andnot_si256(_mm256_cmpeq_epi64(sig[w], sig[u]), first[u]);
+                }
+                next = _mm256_add_epi64(next, first[u]);
+            }
+            for (int v = 0; v < k; v++) {
+                __m256i c = _mm256_setzero_si256();
+                for (int u = 0; u < k; u++) {
+                    c = _mm256_add_epi64(c, _mm256_and_si256(first[u],
+                                                             _mm256_cmpgt_epi64(sig[v], sig[u])));
+                }
+                colour[v] = c;
+            }
+            bool split = _mm256_movemask_epi8(_mm256_cmpeq_epi64(next, cells)) != -1;
+            cells = next;
+            if (!split) break;
+        }
+        _mm256_storeu_si256((__m256i*)(s.cells + base), cells);
+    }
+}
+#endif
+
+struct Kernel {
+    const char* name;
+    void (*refine)(const uint64_t*, int, LaneState&);
+    bool (*supported)();
+};
+
+bool always() { return true; }
+
+#ifdef NAUTY_BATCH_X86
+bool haveAvx2() {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+}
+#endif
+
+const Kernel kernels[] = {
+    {"generic", refineLanesGeneric, always},
+#ifdef NAUTY_BATCH_X86
+    {"avx2", refineLanesAvx2, haveAvx2},
+#endif
+};
+const int NUM_KERNELS = sizeof(kernels) / sizeof(kernels[0]);
+
+const Kernel* bestKernel() {
+    for (int i = NUM_KERNELS - 1; i > 0; i--) {
+        if (kernels[i].supported()) return &kernels[i];
+    }
+    return &kernels[0];
+}
+
+const Kernel* kernel = bestKernel();
+
+// Refine all BATCH_LANES lanes of padded, leaving the cell counts in s.
+void refineLanes(const uint64_t* padded, int k, LaneState& s) {
+    kernel->refine(padded, k, s);
+}
+
+// The canonical form nauty gives a graph whose unit partition refines to a
+// discrete one: the graph relabelled by the refined lab. False if refine1
+// does not end discrete after all.
+bool discreteCanonical(uint64_t packed, int k, uint64_t& canon) {
+    graph g[MAX_PACKED_SIZE];
+    int lab[MAX_PACKED_SIZE];
+    unpackGraph(packed, k, g);
+    if (!discreteLabel(g, 1, k, lab)) return false;
+
+    canon = 0;
+    for (int i = 0; i < k; i++) {
+        for (int j = 0; j < k; j++) {
+            canon |= (packed >> (lab[i] * k + lab[j]) & 1) << (i * k + j);
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+void refinePackedLanes(const uint64_t* packed, int count, int k, int* cells) {
+    uint64_t padded[BATCH_LANES] = {};
+    std::memcpy(padded, packed, count * sizeof(uint64_t));
+    LaneState s;
+    refineLanes(padded, k, s);
+    for (int l = 0; l < count; l++) cells[l] = (int)s.cells[l];
+}
+
+int64_t canonicalPackedBatch(const uint64_t* packed, int64_t count, int k, bool digraph,
+                             uint64_t* out) {
+    // Every undirected graph on fewer than six vertices has a nontrivial
+    // automorphism, so none refines to a discrete partition.
+    if (!digraph && k < 6) {
+        for (int64_t i = 0; i < count; i++) out[i] = canonicalPacked(packed[i], k, digraph);
+        return count;
+    }
+    int64_t searched = 0;
+    LaneState s;
+    for (int64_t base = 0; base < count; base += BATCH_LANES) {
+        int lanes = (int)std::min<int64_t>(BATCH_LANES, count - base);
+        uint64_t padded[BATCH_LANES] = {};
+        std::memcpy(padded, packed + base, lanes * sizeof(uint64_t));
+        refineLanes(padded, k, s);
+        for (int l = 0; l < lanes; l++) {
+            if (s.cells[l] == (uint64_t)k && discreteCanonical(padded[l], k, out[base + l])) {
+                continue;
+            }
+            out[base + l] = canonicalPacked(padded[l], k, digraph);
+            searched++;
+        }
+    }
+    return searched;
+}
+
+const char* batchKernelName() {
+    return kernel->name;
+}
+
+bool selectBatchKernel(const char* name) {
+    for (const Kernel& kn : kernels) {
+        if (std::strcmp(kn.name, name) == 0 && kn.supported()) {
+            kernel = &kn;
+            return true;
+        }
+    }
+    return false;
+}
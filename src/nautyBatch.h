@@ -0,0 +1,33 @@
+#ifndef NAUTY_BATCH_H
+#define NAUTY_BATCH_H
+
+// Internal batched canonical labelling of packed graphs (k <= 8). Not part
+// of the C API.
+
+#include "nautyCore.h"
+
+// Graphs refined together, one per vector lane.
+const int BATCH_LANES = 32;
+
+// Colour refinement of the unit partition of up to BATCH_LANES packed
+// k-vertex graphs in lockstep: every graph takes each round, and the rounds
+// stop once none of them splits a cell. cells[i] receives the number of
+// cells of graph i's stable partition, counting out- and in-neighbours of
+// each colour. refine1 never splits the unit partition further, so it can
+// only end discrete if cells[i] == k; for undirected graphs it then does.
+void refinePackedLanes(const uint64_t* packed, int count, int k, int* cells);
+
+// out[i] = canonicalPacked(packed[i], k, digraph) for each of count graphs.
+// Graphs that refine to a discrete partition are labelled from the
+// refinement alone, as nauty would, and only the rest run nauty's search.
+// Returns how many did.
+int64_t canonicalPackedBatch(const uint64_t* packed, int64_t count, int k, bool digraph,
+                             uint64_t* out);
+
+// Lane kernels, best last: "generic" and "avx2". The best one the CPU
+// supports is chosen at load time; selectBatchKernel switches for tests and
+// returns false if the CPU lacks it.
+const char* batchKernelName();
+bool selectBatchKernel(const char* name);
+
+#endif // NAUTY_BATCH_H
@@ -0,0 +1,634 @@
+#include "nautyCensus.h"
+#include "nautyCore.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace {
+
+// Registered graph. Adjacency lists are sorted and free of duplicates.
+// The undirected view drives subgraph expansion; the directed one (only
+// kept for digraphs) decides the motif class.
+struct CsrGraph {
+    int64_t n = 0;
+    bool directed = false;
+    std::vector<int64_t> outOffsets, outNbrs;
+    std::vector<int64_t> undOffsets, undNbrs;
+
+    int64_t degree(int64_t v) const { return undOffsets[v + 1] - undOffsets[v]; }
+    int64_t numEdges() const { return (int64_t)undNbrs.size() / 2; }
+
+    bool adjacent(int64_t u, int64_t v) const {
+        return std::binary_search(undNbrs.begin() + undOffsets[u],
+                                  undNbrs.begin() + undOffsets[u + 1], v);
+    }
+    bool hasArc(int64_t u, int64_t v) const {
+        if (!directed) return adjacent(u, v);
+        return std::binary_search(outNbrs.begin() + outOffsets[u],
+                                  outNbrs.begin() + outOffsets[u + 1], v);
+    }
+};
+
+std::mutex registry_mutex;
+std::unordered_map<int64_t, std::shared_ptr<const CsrGraph>> registry;
+int64_t next_graph_id = 0;
+
+std::shared_ptr<const CsrGraph> lookupGraph(int64_t graphId) {
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    auto it = registry.find(graphId);
+    return it == registry.end() ? nullptr : it->second;
+}
+
+// Build sorted, duplicate-free CSR arrays from (u, v) pairs.
+void buildCsr(int64_t n, std::vector<std::pair<int64_t, int64_t>>& edges,
+              std::vector<int64_t>& offsets, std::vector<int64_t>& nbrs) {
+    std::sort(edges.begin(), edges.end());
+    edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+
+    offsets.assign(n + 1, 0);
+    for (const auto& e : edges) offsets[e.first + 1]++;
+    for (int64_t v = 0; v < n; v++) offsets[v + 1] += offsets[v];
+
+    nbrs.resize(edges.size());
+    for (size_t i = 0; i < edges.size(); i++) nbrs[i] = edges[i].second;
+}
+
+const double Z_95 = 1.959963984540054;
+const int64_t CHUNK_SIZE = 256;
+const int64_t MIN_SAMPLES_FOR_STOP = 1000;
+
+// Draws connected induced k-subgraphs by growing a random edge along
+// uniformly chosen boundary edges. Each sample is weighted by the inverse of
+// the exact probability of drawing its vertex set, which makes the weighted
+// class totals unbiased estimates of the true subgraph counts.
+class SubgraphSampler {
+public:
+    SubgraphSampler(const CsrGraph& g, int k, uint64_t seed)
+        : g(g), k(k), rng(seed) {}
+
+    void reseed(uint64_t seed) { rng = FastRng(seed); }
+
+    // Returns false if the walk got stuck in a component with fewer than k
+    // vertices; such samples still count towards the sample total.
+    bool sample(uint64_t& packed, double& weight) {
+        int64_t arcs = (int64_t)g.undNbrs.size();
+        if (arcs == 0) return false;
+
+        int64_t arc = (int64_t)rng.below(arcs);
+        int64_t u = std::upper_bound(g.undOffsets.begin(), g.undOffsets.end(), arc)
+                    - g.undOffsets.begin() - 1;
+        verts[0] = u;
+        verts[1] = g.undNbrs[arc];
+        int size = 2;
+        int64_t degSum = g.degree(verts[0]) + g.degree(verts[1]);
+        int64_t internal = 1;
+
+        while (size < k) {
+            if (degSum - 2 * internal == 0) return false;
+
+            // Rejection-sample a uniform boundary edge.
+            int64_t next;
+            for (;;) {
+                int64_t r = (int64_t)rng.below(degSum);
+                int i = 0;
+                while (r >= g.degree(verts[i])) r -= g.degree(verts[i++]);
+                next = g.undNbrs[g.undOffsets[verts[i]] + r];
+                if (std::find(verts, verts + size, next) == verts + size) break;
+            }
+
+            for (int i = 0; i < size; i++) {
+                if (g.adjacent(next, verts[i])) internal++;
+            }
+            degSum += g.degree(next);
+            verts[size++] = next;
+        }
+
+        uint8_t undAdj[MAX_PACKED_SIZE] = {0};
+        packed = 0;
+        for (int i = 0; i < k; i++) {
+            for (int j = 0; j < k; j++) {
+                if (i == j) continue;
+                if (j > i && g.adjacent(verts[i], verts[j])) {
+                    undAdj[i] |= 1 << j;
+                    undAdj[j] |= 1 << i;
+                }
+                if (g.hasArc(verts[i], verts[j])) packed |= 1ULL << (i * k + j);
+            }
+        }
+
+        weight = 1.0 / setProbability(undAdj);
+        return true;
+    }
+
+private:
+    // Probability that the walk produces exactly this vertex set, summed over
+    // all orders in which it could have been grown (dynamic program over
+    // subsets; the boundary size of a subset only depends on its members).
+    double setProbability(const uint8_t* undAdj) {
+        int full = (1 << k) - 1;
+        double prob[1 << MAX_PACKED_SIZE];
+        std::fill(prob, prob + full + 1, 0.0);
+        double start = 1.0 / (double)g.numEdges();
+
+        for (int i = 0; i < k; i++) {
+            for (int j = i + 1; j < k; j++) {
+                if (undAdj[i] & (1 << j)) prob[(1 << i) | (1 << j)] = start;
+            }
+        }
+
+        for (int mask = 3; mask < full; mask++) {
+            if (prob[mask] == 0) continue;
+            int64_t boundary = 0;
+            for (int i = 0; i < k; i++) {
+                if (mask & (1 << i)) {
+                    boundary += g.degree(verts[i]) - __builtin_popcount(undAdj[i] & mask);
+                }
+            }
+            for (int x = 0; x < k; x++) {
+                if (mask & (1 << x)) continue;
+                int links = __builtin_popcount(undAdj[x] & mask);
+                if (links) prob[mask | (1 << x)] += prob[mask] * links / (double)boundary;
+            }
+        }
+        return prob[full];
+    }
+
+    const CsrGraph& g;
+    int k;
+    FastRng rng;
+    int64_t verts[MAX_PACKED_SIZE];
+};
+
+// Running sums of sample weights; see frequencyHalfWidth for their use.
+struct ClassSums {
+    double weight = 0;
+    double weightSq = 0;
+};
+
+struct CensusSums {
+    int64_t samples = 0;
+    double total = 0;
+    double totalSq = 0;
+    std::map<uint64_t, ClassSums> classes;
+
+    void merge(const CensusSums& other) {
+        samples += other.samples;
+        total += other.total;
+        totalSq += other.totalSq;
+        for (const auto& entry : other.classes) {
+            ClassSums& sums = classes[entry.first];
+            sums.weight += entry.second.weight;
+            sums.weightSq += entry.second.weightSq;
+        }
+    }
+
+    double frequency(const ClassSums& c) const {
+        return total > 0 ? c.weight / total : 0;
+    }
+
+    // 95% half-width of the ratio estimator weight/total, by linearisation:
+    // z_i = y_i - R t_i, and y_i t_i == y_i^2 because y_i is t_i or 0.
+    double frequencyHalfWidth(const ClassSums& c) const {
+        if (samples < 2 || total <= 0) return INFINITY;
+        double r = frequency(c);
+        double zSq = c.weightSq * (1 - 2 * r) + r * r * totalSq;
+        double meanTotal = total / samples;
+        double variance = zSq / (samples - 1) / (samples * meanTotal * meanTotal);
+        return Z_95 * std::sqrt(std::max(variance, 0.0));
+    }
+
+    bool converged(double targetError) const {
+        if (targetError <= 0 || samples < MIN_SAMPLES_FOR_STOP || total <= 0) return false;
+        for (const auto& entry : classes) {
+            if (frequencyHalfWidth(entry.second) > targetError) return false;
+        }
+        return true;
+    }
+};
+
+// Build a registered-graph structure from self-loop-free arcs.
+std::shared_ptr<CsrGraph> makeCsrGraph(int64_t n, bool directed,
+                                       std::vector<std::pair<int64_t, int64_t>>& arcs) {
+    auto g = std::make_shared<CsrGraph>();
+    g->n = n;
+    g->directed = directed;
+
+    std::vector<std::pair<int64_t, int64_t>> undirectedArcs;
+    undirectedArcs.reserve(2 * arcs.size());
+    for (const auto& a : arcs) {
+        undirectedArcs.emplace_back(a.first, a.second);
+        undirectedArcs.emplace_back(a.second, a.first);
+    }
+    buildCsr(n, undirectedArcs, g->undOffsets, g->undNbrs);
+    if (directed) buildCsr(n, arcs, g->outOffsets, g->outNbrs);
+    return g;
+}
+
+uint64_t packInduced(const CsrGraph& g, const int64_t* verts, int k) {
+    uint64_t packed = 0;
+    for (int i = 0; i < k; i++) {
+        for (int j = 0; j < k; j++) {
+            if (i != j && g.hasArc(verts[i], verts[j])) packed |= 1ULL << (i * k + j);
+        }
+    }
+    return packed;
+}
+
+// Chunk c holds samples [c * CHUNK_SIZE, (c + 1) * CHUNK_SIZE) and draws
+// them from its own stream, seeded by the seed and its first index.
+// Finished chunks are merged in index order, and the stopping rule is
+// checked after each one, so the estimate depends only on the seed and the
+// budget, never on the thread count or on which thread took which chunk.
+CensusSums runSampledCensus(const CsrGraph& g, int k, int64_t sampleBudget,
+                            double targetError, uint64_t seed, int threads) {
+    CanonCache& cache = sharedCanonCache();
+    CensusSums global;
+    std::map<int64_t, CensusSums> finished;  // Chunks waiting for a lower one
+    int64_t nextToMerge = 0;
+    std::mutex global_mutex;
+    std::atomic<int64_t> claimed(0);
+    std::atomic<bool> stop(false);
+
+    runThreads(threads, [&](int) {
+        SubgraphSampler sampler(g, k, seed);
+        std::vector<uint64_t> packed(CHUNK_SIZE), canons(CHUNK_SIZE);
+        std::vector<double> weights(CHUNK_SIZE);
+        while (!stop.load(std::memory_order_relaxed)) {
+            int64_t first = claimed.fetch_add(CHUNK_SIZE);
+            if (first >= sampleBudget) break;
+            int64_t count = std::min(CHUNK_SIZE, sampleBudget - first);
+
+            CensusSums local;
+            int64_t drawn = 0;
+            sampler.reseed(mix64(seed ^ (uint64_t)first));
+            for (int64_t s = 0; s < count; s++) {
+                local.samples++;
+                if (sampler.sample(packed[drawn], weights[drawn])) drawn++;
+            }
+            // Label the chunk's samples together.
+            cache.canonicalBatch(packed.data(), drawn, k, g.directed, canons.data());
+            for (int64_t s = 0; s < drawn; s++) {
+                double weight = weights[s];
+                ClassSums& sums = local.classes[canons[s]];
+                sums.weight += weight;
+                sums.weightSq += weight * weight;
+                local.total += weight;
+                local.totalSq += weight * weight;
+            }
+
+            std::lock_guard<std::mutex> lock(global_mutex);
+            if (stop) break;
+            finished[first / CHUNK_SIZE] = std::move(local);
+            while (!stop && !finished.empty() && finished.begin()->first == nextToMerge) {
+                global.merge(finished.begin()->second);
+                finished.erase(finished.begin());
+                nextToMerge++;
+                if (global.converged(targetError)) stop = true;
+            }
+        }
+    });
+    return global;
+}
+
+// Exact census by ESU enumeration (Wernicke 2006): every connected induced
+// k-subgraph is produced exactly once, rooted at its smallest vertex.
+class SubgraphEnumerator {
+public:
+    SubgraphEnumerator(const CsrGraph& g, int k, std::map<uint64_t, double>& counts)
+        : g(g), k(k), counts(counts), cache(sharedCanonCache()) {}
+
+    void enumerateFrom(int64_t root) {
+        this->root = root;
+        verts[0] = root;
+        std::vector<int64_t> extension;
+        for (int64_t i = g.undOffsets[root]; i < g.undOffsets[root + 1]; i++) {
+            if (g.undNbrs[i] > root) extension.push_back(g.undNbrs[i]);
+        }
+        extend(1, extension);
+    }
+
+    // Label the subgraphs still buffered and count them.
+    void flush() {
+        canons.resize(pending.size());
+        cache.canonicalBatch(pending.data(), (int64_t)pending.size(), k, g.directed,
+                             canons.data());
+        for (uint64_t canon : canons) counts[canon] += 1;
+        pending.clear();
+    }
+
+private:
+    void extend(int size, std::vector<int64_t>& extension) {
+        if (size == k) {
+            pending.push_back(packInduced(g, verts, k));
+            if ((int64_t)pending.size() == CHUNK_SIZE) flush();
+            return;
+        }
+        while (!extension.empty()) {
+            int64_t w = extension.back();
+            extension.pop_back();
+
+            // Add the exclusive neighbours of w: not in or next to the subgraph.
+            std::vector<int64_t> next = extension;
+            for (int64_t i = g.undOffsets[w]; i < g.undOffsets[w + 1]; i++) {
+                int64_t u = g.undNbrs[i];
+                if (u <= root) continue;
+                bool exclusive = true;
+                for (int j = 0; j < size && exclusive; j++) {
+                    exclusive = u != verts[j] && !g.adjacent(u, verts[j]);
+                }
+                if (exclusive) next.push_back(u);
+            }
+            verts[size] = w;
+            extend(size + 1, next);
+        }
+    }
+
+    const CsrGraph& g;
+    int k;
+    std::map<uint64_t, double>& counts;
+    CanonCache& cache;
+    std::vector<uint64_t> pending, canons;
+    int64_t root = 0;
+    int64_t verts[MAX_PACKED_SIZE];
+};
+
+std::map<uint64_t, double> runExactCensus(const CsrGraph& g, int k, int threads) {
+    const int64_t ROOTS_PER_CLAIM = 64;
+    std::map<uint64_t, double> global;
+    std::mutex global_mutex;
+    std::atomic<int64_t> claimed(0);
+
+    runThreads(threads, [&](int) {
+        std::map<uint64_t, double> local;
+        SubgraphEnumerator enumerator(g, k, local);
+        for (;;) {
+            int64_t first = claimed.fetch_add(ROOTS_PER_CLAIM);
+            if (first >= g.n) break;
+            int64_t last = std::min(g.n, first + ROOTS_PER_CLAIM);
+            for (int64_t v = first; v < last; v++) enumerator.enumerateFrom(v);
+        }
+        enumerator.flush();
+        std::lock_guard<std::mutex> lock(global_mutex);
+        for (const auto& entry : local) global[entry.first] += entry.second;
+    });
+    return global;
+}
+
+// Degree-preserving random copy of g by double edge swaps: arcs a->b and
+// c->d become a->d and c->b unless that creates a loop or a repeated edge.
+// Undirected edges are swapped with a random orientation.
+std::shared_ptr<CsrGraph> randomizedCopy(const CsrGraph& g, int64_t swapsPerEdge,
+                                         uint64_t seed) {
+    std::vector<std::pair<int64_t, int64_t>> edges;
+    const std::vector<int64_t>& offsets = g.directed ? g.outOffsets : g.undOffsets;
+    const std::vector<int64_t>& nbrs = g.directed ? g.outNbrs : g.undNbrs;
+    for (int64_t u = 0; u < g.n; u++) {
+        for (int64_t i = offsets[u]; i < offsets[u + 1]; i++) {
+            if (g.directed || u < nbrs[i]) edges.emplace_back(u, nbrs[i]);
+        }
+    }
+
+    auto key = [&](int64_t u, int64_t v) {
+        if (!g.directed && u > v) std::swap(u, v);
+        return (uint64_t)u * (uint64_t)g.n + (uint64_t)v;
+    };
+    std::unordered_set<uint64_t> present;
+    present.reserve(edges.size() * 2);
+    for (const auto& e : edges) present.insert(key(e.first, e.second));
+
+    FastRng rng(seed);
+    int64_t m = (int64_t)edges.size();
+    int64_t attempts = m >= 2 ? swapsPerEdge * m : 0;
+    for (int64_t s = 0; s < attempts; s++) {
+        int64_t i = (int64_t)rng.below(m);
+        int64_t j = (int64_t)rng.below(m);
+        if (i == j) continue;
+
+        int64_t a = edges[i].first, b = edges[i].second;
+        int64_t c = edges[j].first, d = edges[j].second;
+        if (!g.directed && (rng.next() & 1)) std::swap(c, d);
+        if (a == d || c == b) continue;
+        if (present.count(key(a, d)) || present.count(key(c, b))) continue;
+
+        present.erase(key(a, b));
+        present.erase(key(c, d));
+        present.insert(key(a, d));
+        present.insert(key(c, b));
+        edges[i] = {a, d};
+        edges[j] = {c, b};
+    }
+
+    return makeCsrGraph(g.n, g.directed, edges);
+}
+
+// Class counts of g: exact if sampleBudget is 0, otherwise estimated.
+std::map<uint64_t, double> censusCounts(const CsrGraph& g, int k, int64_t sampleBudget,
+                                        uint64_t seed, int threads) {
+    if (sampleBudget == 0) return runExactCensus(g, k, threads);
+
+    CensusSums sums = runSampledCensus(g, k, sampleBudget, 0, seed, threads);
+    std::map<uint64_t, double> counts;
+    for (const auto& entry : sums.classes) {
+        counts[entry.first] = entry.second.weight / sums.samples;
+    }
+    return counts;
+}
+
+} // namespace
+
+extern "C" {
+
+int64_t nautyRegisterGraph(
+    int64_t numVertices,
+    int64_t offsets[],
+    int64_t neighbors[],
+    int64_t directed
+) {
+    if (numVertices < 0) return -1;
+
+    std::vector<std::pair<int64_t, int64_t>> arcs;
+    for (int64_t u = 0; u < numVertices; u++) {
+        for (int64_t i = offsets[u]; i < offsets[u + 1]; i++) {
+            int64_t v = neighbors[i];
+            if (v < 0 || v >= numVertices) return -2;
+            if (u != v) arcs.emplace_back(u, v);
+        }
+    }
+    std::shared_ptr<CsrGraph> g = makeCsrGraph(numVertices, directed != 0, arcs);
+
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    int64_t id = next_graph_id++;
+    registry[id] = g;
+    return id;
+}
+
+int64_t nautyReleaseGraph(int64_t graphId) {
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    return registry.erase(graphId) ? 0 : -1;
+}
+
+int64_t nautySampleCensus(
+    int64_t graphId,
+    int64_t motifSize,
+    int64_t sampleBudget,
+    double targetError,
+    int64_t seed,
+    int64_t numThreads,
+    int64_t maxClasses,
+    int64_t classKeys[],
+    double frequencies[],
+    double ciLow[],
+    double ciHigh[],
+    double estimatedCounts[],
+    int64_t* samplesUsed
+) {
+    std::shared_ptr<const CsrGraph> g = lookupGraph(graphId);
+    if (!g) return -1;
+    if (motifSize < 2 || motifSize > MAX_PACKED_SIZE) return -2;
+    if (sampleBudget <= 0) return -3;
+
+    CensusSums global = runSampledCensus(*g, (int)motifSize, sampleBudget, targetError,
+                                         (uint64_t)seed, resolveThreadCount(numThreads));
+
+    std::vector<std::pair<uint64_t, ClassSums>> classes(global.classes.begin(),
+                                                        global.classes.end());
+    std::stable_sort(classes.begin(), classes.end(), [](const auto& a, const auto& b) {
+        return a.second.weight > b.second.weight;
+    });
+
+    int64_t written = std::min<int64_t>(maxClasses, (int64_t)classes.size());
+    for (int64_t i = 0; i < written; i++) {
+        const ClassSums& sums = classes[i].second;
+        double freq = global.frequency(sums);
+        double half = global.frequencyHalfWidth(sums);
+        classKeys[i] = (int64_t)classes[i].first;
+        frequencies[i] = freq;
+        ciLow[i] = std::max(0.0, freq - half);
+        ciHigh[i] = std::min(1.0, freq + half);
+        estimatedCounts[i] = sums.weight / global.samples;
+    }
+    if (samplesUsed) *samplesUsed = global.samples;
+
+    return (int64_t)classes.size();
+}
+
+int64_t nautyExactCensus(
+    int64_t graphId,
+    int64_t motifSize,
+    int64_t numThreads,
+    int64_t maxClasses,
+    int64_t classKeys[],
+    int64_t counts[]
+) {
+    std::shared_ptr<const CsrGraph> g = lookupGraph(graphId);
+    if (!g) return -1;
+    if (motifSize < 2 || motifSize > MAX_PACKED_SIZE) return -2;
+
+    std::map<uint64_t, double> census =
+        runExactCensus(*g, (int)motifSize, resolveThreadCount(numThreads));
+
+    std::vector<std::pair<uint64_t, double>> classes(census.begin(), census.end());
+    std::stable_sort(classes.begin(), classes.end(), [](const auto& a, const auto& b) {
+        return a.second > b.second;
+    });
+
+    int64_t written = std::min<int64_t>(maxClasses, (int64_t)classes.size());
+    for (int64_t i = 0; i < written; i++) {
+        classKeys[i] = (int64_t)classes[i].first;
+        counts[i] = (int64_t)classes[i].second;
+    }
+    return (int64_t)classes.size();
+}
+
+int64_t nautyMotifSignificance(
+    int64_t graphId,
+    int64_t motifSize,
+    int64_t numReplicates,
+    int64_t swapsPerEdge,
+    int64_t sampleBudget,
+    int64_t seed,
+    int64_t numThreads,
+    int64_t maxClasses,
+    int64_t classKeys[],
+    double observed[],
+    double randomMean[],
+    double randomStdDev[],
+    double zScores[]
+) {
+    std::shared_ptr<const CsrGraph> g = lookupGraph(graphId);
+    if (!g) return -1;
+    if (motifSize < 2 || motifSize > MAX_PACKED_SIZE) return -2;
+    if (sampleBudget < 0) return -3;
+    if (numReplicates < 1 || swapsPerEdge < 0) return -4;
+
+    int k = (int)motifSize;
+    int threads = resolveThreadCount(numThreads);
+
+    // A sampled census is seeded per chunk (see runSampledCensus), so the
+    // observed counts do not depend on the thread count either.
+    std::map<uint64_t, double> original = censusCounts(*g, k, sampleBudget, seed, threads);
+
+    // One replicate per claim; each is randomised and counted on one thread,
+    // seeded by its index so results do not depend on the thread count.
+    std::vector<std::map<uint64_t, double>> replicates(numReplicates);
+    std::atomic<int64_t> claimed(0);
+    runThreads((int)std::min<int64_t>(threads, numReplicates), [&](int) {
+        for (;;) {
+            int64_t r = claimed.fetch_add(1);
+            if (r >= numReplicates) break;
+            uint64_t replicateSeed = (uint64_t)seed + 0x9e3779b97f4a7c15ULL * (uint64_t)(r + 1);
+            std::shared_ptr<CsrGraph> copy = randomizedCopy(*g, swapsPerEdge, replicateSeed);
+            replicates[r] = censusCounts(*copy, k, sampleBudget, replicateSeed, 1);
+        }
+    });
+
+    struct Significance {
+        uint64_t key;
+        double observed, mean, stdDev, z;
+    };
+    std::map<uint64_t, double> allClasses = original;
+    for (const auto& counts : replicates) {
+        for (const auto& entry : counts) allClasses.emplace(entry.first, 0.0);
+    }
+
+    std::vector<Significance> results;
+    for (const auto& entry : allClasses) {
+        double sum = 0, sumSq = 0;
+        for (const auto& counts : replicates) {
+            auto it = counts.find(entry.first);
+            double c = it == counts.end() ? 0 : it->second;
+            sum += c;
+            sumSq += c * c;
+        }
+        double mean = sum / numReplicates;
+        double variance = numReplicates > 1
+            ? std::max(0.0, (sumSq - numReplicates * mean * mean) / (numReplicates - 1))
+            : 0.0;
+        double stdDev = std::sqrt(variance);
+        double diff = entry.second - mean;
+        double z = stdDev > 0 ? diff / stdDev : (diff == 0 ? 0 : std::copysign(INFINITY, diff));
+        results.push_back({entry.first, entry.second, mean, stdDev, z});
+    }
+    std::stable_sort(results.begin(), results.end(), [](const auto& a, const auto& b) {
+        return a.z > b.z;
+    });
+
+    int64_t written = std::min<int64_t>(maxClasses, (int64_t)results.size());
+    for (int64_t i = 0; i < written; i++) {
+        classKeys[i] = (int64_t)results[i].key;
+        observed[i] = results[i].observed;
+        randomMean[i] = results[i].mean;
+        randomStdDev[i] = results[i].stdDev;
+        zScores[i] = results[i].z;
+    }
+    return (int64_t)results.size();
+}
+
+} // extern "C"
@@ -1,12 +1,238 @@
 #include "nautyClassify.h"
-#include <nauty.h>
+#include "nautyCore.h"
+#include "nautyMemory.h"
+#include "nautyParallel.h"
+#include "nautySchreier.h"
+#include "nautySetOps.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <cstring>
 #include <iostream>
 #include <mutex>
-#include <memory>
+#include <vector>
 
 static std::mutex cout_mutex;
-static std::mutex nauty_mutex;
+
+// Process-wide counts for nautyClassifyStats, over all threads.
+static std::atomic<int64_t> graphsClassified{0};
+static std::atomic<int64_t> graphsRefinedOnly{0};
+static std::atomic<int64_t> nodesSearched{0};
+
+namespace {
+
+// Invariants NAUTY_INVARIANT_AUTO chooses between, each applied at the root
+// only: none, adjtriang, distances, refinvar and cellquads.
+const LabelgOptions AUTO_CANDIDATES[] = {
+    {nullptr, 0, 1, 1, 0},
+    {nullptr, 2, 1, 1, 0},
+    {nullptr, 8, 1, 1, 0},
+    {nullptr, 16, 1, 1, 0},
+    {nullptr, 6, 1, 1, 0},
+};
+
+// Graphs needing a search that each candidate is timed on.
+const int AUTO_SAMPLE = 8;
+
+// Fraction of the best time so far a later candidate must beat.
+const double AUTO_MARGIN = 0.9;
+
+// Named search settings for nautyClassifyProfile.
+struct ClassifyProfile {
+    const char* name;
+    TargetStrategy target;
+    int tcLevel;
+    bool schreier;
+    int invariant;    // labelg -i number, applied at the root only
+    bool sparse;      // Search through nausparse.c
+    bool undirected;  // Label symmetric matrices as graphs, not digraphs
+};
+
+const ClassifyProfile PROFILES[] = {
+    // nautyClassify's own settings.
+    {"default", TARGET_NAUTY, 100, false, 0, false, false},
+    // Many graphs of a few vertices. Most refine to a discrete partition;
+    // for the rest the tree is small and scanning the partition for the
+    // best cell, or keeping Schreier structures, costs more than it saves.
+    {"tiny-motif", TARGET_FIRST, 0, false, 0, false, true},
+    // Hundreds of vertices and few edges: sparse refinement and Schreier
+    // pruning as labelg uses from 33 vertices. sparsenauty keeps nausparse's
+    // own dispatch, so the target is unused; its targetcell_sg calls
+    // bestcell_sg (quadratic in the number of cells) only up to tc_level,
+    // and at tc_level 0 takes the first non-singleton cell at every level.
+    {"sparse-large", TARGET_NAUTY, 0, true, 0, true, true},
+    // Regular graphs, where refinement alone splits nothing: choose cells
+    // carefully at every level, split the root with distances, and prune
+    // with Schreier's method.
+    {"regular-hard", TARGET_BEST, 100, true, 8, false, true},
+};
+
+// Per-thread matrices and nauty arrays for the batch entry points, grown to
+// the largest graph seen by the thread.
+struct ClassifyScratch {
+    std::vector<graph> g;
+    std::vector<graph> canong;
+    std::vector<int> lab, ptn, orbits;
+    std::vector<setword> workspace;
+    std::vector<char> used;
+    bool digraph = true;
+
+    void reserve(int m, int n) {
+        if (g.size() < (size_t)m * n) {
+            g.resize((size_t)m * n);
+            canong.resize((size_t)m * n);
+        }
+        if (lab.size() < (size_t)n) {
+            lab.resize(n);
+            ptn.resize(n);
+            orbits.resize(n);
+            used.resize(n);
+        }
+        if (workspace.size() < (size_t)(100 * m)) workspace.resize(100 * m);
+    }
+
+    void release() {
+        freeVector(g);
+        freeVector(canong);
+        freeVector(lab);
+        freeVector(ptn);
+        freeVector(orbits);
+        freeVector(workspace);
+        freeVector(used);
+    }
+
+    size_t bytes() const {
+        return capacityBytes(g) + capacityBytes(canong) + capacityBytes(lab) +
+               capacityBytes(ptn) + capacityBytes(orbits) + capacityBytes(workspace) +
+               capacityBytes(used);
+    }
+};
+
+thread_local ClassifyScratch classifyScratch;
+
+const bool scratchRegistered = registerScratch({
+    [](int m, int n) { classifyScratch.reserve(m, n); },
+    [] { classifyScratch.release(); },
+    [] { return classifyScratch.bytes(); },
+});
+
+// Load an n x n adjacency matrix into classifyScratch.g: as in
+// nautyClassify, entries equal to 1 off the diagonal are arcs. It is
+// labelled as a digraph unless undirected is set and the matrix symmetric.
+void loadMatrix(const int64_t* matrix, int m, int n, bool undirected) {
+    ClassifyScratch& cs = classifyScratch;
+    cs.reserve(m, n);
+    bool symmetric = undirected;
+    for (int i = 0; i < n; i++) {
+        set* gv = GRAPHROW(cs.g.data(), i, m);
+        EMPTYSET(gv, m);
+        for (int j = 0; j < n; j++) {
+            bool arc = i != j && matrix[(size_t)i * n + j] == 1;
+            if (arc) ADDELEMENT(gv, j);
+            if (symmetric && arc != (i != j && matrix[(size_t)j * n + i] == 1)) symmetric = false;
+        }
+    }
+    cs.digraph = !symmetric;
+}
+
+// Search the graph in classifyScratch under settings, leaving the
+// labelling in results. Returns the number of search tree nodes.
+int64_t searchLoaded(int m, int n, const SearchSettings& settings, int64_t* results) {
+    ClassifyScratch& cs = classifyScratch;
+    statsblk stats;
+    canonicalLabel(cs.g.data(), m, n, cs.digraph, cs.lab.data(), cs.canong.data(), &stats,
+                   &settings);
+    for (int i = 0; i < n; i++) results[i] = cs.lab[i];
+    return (int64_t)stats.numnodes;
+}
+
+// Label the graph in classifyScratch if refinement alone does; false if it
+// needs a search.
+bool refineLoaded(int m, int n, int64_t* results) {
+    ClassifyScratch& cs = classifyScratch;
+    if (!discreteLabel(cs.g.data(), m, n, cs.lab.data())) return false;
+    for (int i = 0; i < n; i++) results[i] = cs.lab[i];
+    return true;
+}
+
+// Label count matrices of n vertices into results under settings. With
+// autoInvariant, settings.invariant is replaced by the candidate found
+// fastest on the batch's first graphs that need a search.
+void classifyBatch(const int64_t* subgraph, int n, int64_t* results, int64_t batchSize,
+                   SearchSettings& settings, bool autoInvariant, bool undirected) {
+    int64_t count = batchSize > 1 ? batchSize : 1;
+    int m = SETWORDSNEEDED(n);
+    size_t matrixSize = (size_t)n * n;
+
+    int64_t next = 0, refined = 0, nodes = 0;
+    if (autoInvariant) {
+        // Label the leading graphs that refinement settles, and set aside
+        // the first few that need a search to time the candidates on.
+        std::vector<int64_t> sample;
+        for (; next < count && (int)sample.size() < AUTO_SAMPLE; next++) {
+            loadMatrix(subgraph + next * matrixSize, m, n, undirected);
+            if (refineLoaded(m, n, results + next * n)) {
+                refined++;
+            } else {
+                sample.push_back(next);
+            }
+        }
+
+        // Candidates run cheapest first. A later one must beat the best so
+        // far by AUTO_MARGIN, so timer noise on easy graphs does not pick a
+        // costlier invariant, and is abandoned once it cannot.
+        settings.invariant = AUTO_CANDIDATES[0];
+        SearchSettings trialSettings = settings;
+        std::vector<int64_t> trial(sample.size() * n), best(sample.size() * n);
+        // Untimed, so the first candidate does not pay for cold caches and
+        // growing scratch.
+        for (size_t s = 0; s < sample.size(); s++) {
+            loadMatrix(subgraph + sample[s] * matrixSize, m, n, undirected);
+            searchLoaded(m, n, settings, trial.data() + s * n);
+        }
+        double bestTime = -1;
+        for (const LabelgOptions& candidate : AUTO_CANDIDATES) {
+            if (sample.empty()) break;
+            double limit = bestTime < 0 ? -1 : bestTime * AUTO_MARGIN;
+            trialSettings.invariant = candidate;
+            auto start = std::chrono::steady_clock::now();
+            double time = 0;
+            int64_t candidateNodes = 0;
+            size_t s = 0;
+            for (; s < sample.size() && (limit < 0 || time < limit); s++) {
+                loadMatrix(subgraph + sample[s] * matrixSize, m, n, undirected);
+                candidateNodes += searchLoaded(m, n, trialSettings, trial.data() + s * n);
+                time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start)
+                           .count();
+            }
+            if (s == sample.size() && (limit < 0 || time < limit)) {
+                settings.invariant = candidate;
+                bestTime = time;
+                nodes = candidateNodes;
+                best.swap(trial);
+            }
+        }
+        for (size_t s = 0; s < sample.size(); s++) {
+            std::memcpy(results + sample[s] * n, best.data() + s * n, n * sizeof(int64_t));
+        }
+    }
+
+    for (; next < count; next++) {
+        loadMatrix(subgraph + next * matrixSize, m, n, undirected);
+        if (refineLoaded(m, n, results + next * n)) {
+            refined++;
+        } else {
+            nodes += searchLoaded(m, n, settings, results + next * n);
+        }
+    }
+
+    graphsClassified.fetch_add(count, std::memory_order_relaxed);
+    graphsRefinedOnly.fetch_add(refined, std::memory_order_relaxed);
+    nodesSearched.fetch_add(nodes, std::memory_order_relaxed);
+    settleThreadMemory();
+}
+
+} // namespace
 
 extern "C" {
 
@@ -37,28 +263,22 @@ int64_t nautyClassify(
         return -1;
     }
 
-    // Allocate arrays with exact sizes needed
-    std::unique_ptr<graph[]> g(new graph[m * subgraphSize]);
-    std::unique_ptr<graph[]> canong(new graph[m * subgraphSize]);
-    std::unique_ptr<int[]> lab(new int[subgraphSize]);
-    std::unique_ptr<int[]> ptn(new int[subgraphSize]);
-    std::unique_ptr<int[]> orbits(new int[subgraphSize]);
-    std::unique_ptr<setword[]> workspace(new setword[100 * m]); // Increased workspace
-    std::unique_ptr<bool[]> used(new bool[subgraphSize]);
-
-    // Zero out the arrays
-    std::memset(g.get(), 0, sizeof(graph) * m * subgraphSize);
-    std::memset(canong.get(), 0, sizeof(graph) * m * subgraphSize);
-    std::memset(lab.get(), 0, sizeof(int) * subgraphSize);
-    std::memset(ptn.get(), 0, sizeof(int) * subgraphSize);
-    std::memset(orbits.get(), 0, sizeof(int) * subgraphSize);
-    std::memset(workspace.get(), 0, sizeof(setword) * 100 * m);
-    std::memset(used.get(), 0, sizeof(bool) * subgraphSize);
+    // The thread's scratch, reused from graph to graph: every row of g is
+    // cleared below and nauty writes the rest before reading it.
+    ClassifyScratch& cs = classifyScratch;
+    cs.reserve(m, subgraphSize);
+    graph* g = cs.g.data();
+    graph* canong = cs.canong.data();
+    int* lab = cs.lab.data();
+    int* ptn = cs.ptn.data();
+    int* orbits = cs.orbits.data();
+    char* used = cs.used.data();
+    std::memset(used, 0, subgraphSize);
 
     // Perform nauty check if requested
     if (performCheck) {
         print_verbose("Performing nauty_check...");
-        std::lock_guard<std::mutex> lock(nauty_mutex);
+        NautyGuard guard((int)subgraphSize);
         try {
             nauty_check(WORDSIZE, m, subgraphSize, NAUTYVERSIONID);
             print_verbose("nauty_check passed");
@@ -77,30 +297,39 @@ int64_t nautyClassify(
 
     // Convert input matrix to nauty graph format
     for (int i = 0; i < subgraphSize; i++) {
-        set* gv = GRAPHROW(g.get(), i, m);
+        set* gv = GRAPHROW(g, i, m);
         EMPTYSET(gv, m);
         
         for (int j = 0; j < subgraphSize; j++) {
             if (i != j && subgraph[i * subgraphSize + j] == 1) {
                 ADDELEMENT(gv, j);
-                print_verbose("Added edge: " + std::to_string(i) + " -> " + std::to_string(j));
+                if (verbose) print_verbose("Added edge: " + std::to_string(i) + " -> " + std::to_string(j));
             }
         }
     }
 
-    print_verbose("\nCalling nauty with m=" + std::to_string(m) + ", n=" + std::to_string(subgraphSize));
+    // Small asymmetric subgraphs mostly refine to a discrete partition at
+    // the root, and nauty's labelling is then the refined one: skip the
+    // search setup for them.
+    graphsClassified.fetch_add(1, std::memory_order_relaxed);
+    if (discreteLabel(g, m, subgraphSize, lab)) {
+        graphsRefinedOnly.fetch_add(1, std::memory_order_relaxed);
+        print_verbose("\nPartition refined to discrete; nauty search skipped");
+    } else {
+        print_verbose("\nCalling nauty with m=" + std::to_string(m) + ", n=" + std::to_string(subgraphSize));
 
-    // Create options (must be thread-local)
-    DEFAULTOPTIONS_GRAPH(options);
-    options.getcanon = TRUE;
-    options.defaultptn = TRUE;
-    options.digraph = TRUE;
-    statsblk stats;
+        // Create options (must be thread-local)
+        DEFAULTOPTIONS_GRAPH(options);
+        options.getcanon = TRUE;
+        options.defaultptn = TRUE;
+        options.digraph = TRUE;
+        options.dispatch = graphDispatch();
+        statsblk stats;
 
-    {
-        std::lock_guard<std::mutex> lock(nauty_mutex);
-        nauty(g.get(), lab.get(), ptn.get(), nullptr, orbits.get(), &options, &stats, 
-              workspace.get(), 100 * m, m, subgraphSize, canong.get());
+        NautyGuard guard((int)subgraphSize);
+        nauty(g, lab, ptn, nullptr, orbits, &options, &stats,
+              cs.workspace.data(), 100 * m, m, subgraphSize, canong);
+        nodesSearched.fetch_add((int64_t)stats.numnodes, std::memory_order_relaxed);
     }
 
     print_verbose("Nauty completed. Validating results...");
@@ -123,10 +352,11 @@ int64_t nautyClassify(
     // Copy results
     for (int i = 0; i < subgraphSize; i++) {
         results[i] = lab[i];
-        print_verbose("results[" + std::to_string(i) + "] = " + std::to_string(results[i]));
+        if (verbose) print_verbose("results[" + std::to_string(i) + "] = " + std::to_string(results[i]));
     }
 
     print_verbose("\n==== Nauty Classification Complete ====\n");
+    settleThreadMemory();
     return 0;
 }
 
@@ -165,4 +395,176 @@ int64_t c_nautyClassify(
     return 0;
 }
 
+int64_t nautyClassifyInvariant(
+    int64_t subgraph[],
+    int64_t subgraphSize,
+    int64_t results[],
+    int64_t batchSize,
+    int64_t invariant,
+    int64_t minInvarLevel,
+    int64_t maxInvarLevel,
+    int64_t invarArg,
+    int64_t chosen[]
+) {
+    if (subgraphSize < 1) return -1;
+    if (invariant < NAUTY_INVARIANT_AUTO || invariant >= NUM_INVARIANTS) return -4;
+
+    SearchSettings settings;
+    settings.invariant.invariant = (int)invariant;
+    settings.invariant.minInvarLevel = (int)minInvarLevel;
+    settings.invariant.maxInvarLevel = (int)maxInvarLevel;
+    settings.invariant.invarArg = (int)invarArg;
+    classifyBatch(subgraph, (int)subgraphSize, results, batchSize, settings,
+                  invariant == NAUTY_INVARIANT_AUTO, false);
+
+    if (chosen) {
+        const LabelgOptions& used = settings.invariant;
+        chosen[0] = used.invariant;
+        chosen[1] = used.minInvarLevel;
+        chosen[2] = used.maxInvarLevel;
+        chosen[3] = used.invarArg;
+    }
+    return 0;
+}
+
+int64_t nautyClassifyProfile(
+    int64_t subgraph[],
+    int64_t subgraphSize,
+    int64_t results[],
+    int64_t batchSize,
+    const char* profile
+) {
+    if (subgraphSize < 1) return -1;
+    const ClassifyProfile* found = nullptr;
+    for (const ClassifyProfile& p : PROFILES) {
+        if (profile && std::strcmp(p.name, profile) == 0) found = &p;
+    }
+    if (!found) return -4;
+
+    SearchSettings settings;
+    settings.invariant.invariant = found->invariant;
+    settings.invariant.minInvarLevel = 1;
+    settings.invariant.maxInvarLevel = 1;
+    settings.invariant.invarArg = 0;
+    settings.tcLevel = found->tcLevel;
+    settings.schreier = found->schreier;
+    settings.dispatch = graphDispatch(found->target);
+    settings.sparse = found->sparse;
+    classifyBatch(subgraph, (int)subgraphSize, results, batchSize, settings, false,
+                  found->undirected);
+    return 0;
+}
+
+int64_t nautyClassifyParallel(
+    int64_t subgraph[],
+    int64_t subgraphSize,
+    int64_t results[],
+    int64_t batchSize,
+    int64_t numThreads
+) {
+    if (subgraphSize < 1) return -1;
+    int n = (int)subgraphSize;
+    int m = SETWORDSNEEDED(n);
+    int threads = resolveThreadCount(numThreads);
+    int64_t count = batchSize > 1 ? batchSize : 1;
+    ClassifyScratch& cs = classifyScratch;
+
+    int64_t refined = 0, nodes = 0;
+    for (int64_t i = 0; i < count; i++) {
+        int64_t* out = results + i * n;
+        loadMatrix(subgraph + i * (size_t)n * n, m, n, false);
+        if (refineLoaded(m, n, out)) {
+            refined++;
+            continue;
+        }
+        statsblk stats;
+        parallelCanonicalLabel(cs.g.data(), m, n, cs.digraph, cs.lab.data(), cs.canong.data(),
+                               &stats, nullptr, threads);
+        for (int v = 0; v < n; v++) out[v] = cs.lab[v];
+        nodes += (int64_t)stats.numnodes;
+    }
+
+    graphsClassified.fetch_add(count, std::memory_order_relaxed);
+    graphsRefinedOnly.fetch_add(refined, std::memory_order_relaxed);
+    nodesSearched.fetch_add(nodes, std::memory_order_relaxed);
+    settleThreadMemory();
+    return 0;
+}
+
+int64_t nautyClassifyGroup(
+    int64_t subgraph[],
+    int64_t subgraphSize,
+    int64_t batchSize,
+    int64_t numThreads,
+    double groupMantissa[],
+    int64_t groupExponent[],
+    int64_t numOrbits[]
+) {
+    if (subgraphSize < 1) return -1;
+    int n = (int)subgraphSize;
+    int m = SETWORDSNEEDED(n);
+    int threads = resolveThreadCount(numThreads);
+    int64_t count = batchSize > 1 ? batchSize : 1;
+    ClassifyScratch& cs = classifyScratch;
+
+    // One context for the batch: its segments and permutations are reused
+    // from graph to graph.
+    SchreierGroup group;
+    for (int64_t i = 0; i < count; i++) {
+        loadMatrix(subgraph + i * (size_t)n * n, m, n, false);
+        double mantissa = 1;
+        int exponent = 0, orbits = n;
+        if (!discreteLabel(cs.g.data(), m, n, cs.lab.data())) {
+            parallelCanonicalLabel(cs.g.data(), m, n, cs.digraph, cs.lab.data(),
+                                   cs.canong.data(), nullptr, nullptr, threads, &group);
+            group.order(&mantissa, &exponent);
+            orbits = group.orbits(cs.orbits.data());
+        }
+        groupMantissa[i] = mantissa;
+        groupExponent[i] = exponent;
+        numOrbits[i] = orbits;
+    }
+    settleThreadMemory();
+    return 0;
+}
+
+int64_t nautyClassifyReserve(int64_t maxN) {
+    if (maxN < 1 || maxN > NAUTY_INFINITY - 2) return -1;
+    reserveThreadMemory((int)maxN);
+    return 0;
+}
+
+int64_t nautyClassifyRelease(void) {
+    releaseThreadMemory();
+    return 0;
+}
+
+int64_t nautyClassifyMemoryBudget(int64_t bytes) {
+    if (bytes < 0) return -1;
+    setMemoryBudget((size_t)bytes);
+    return 0;
+}
+
+int64_t nautyClassifyTrim(int64_t allThreads) {
+    size_t before = threadRetainedBytes();
+    if (allThreads) requestTrimAll();
+    releaseThreadMemory();
+    return (int64_t)(before - threadRetainedBytes());
+}
+
+int64_t nautyClassifyMemory(int64_t bytes[], int64_t maxThreads) {
+    if (maxThreads < 0) return -1;
+    return threadMemoryReport(bytes, (int)std::min<int64_t>(maxThreads, INT32_MAX));
+}
+
+int64_t nautyClassifyStats(int64_t stats[], int64_t reset) {
+    std::atomic<int64_t>* counters[NAUTY_CLASSIFY_STATS] = {
+        &graphsClassified, &graphsRefinedOnly, &nodesSearched};
+    for (int i = 0; i < NAUTY_CLASSIFY_STATS; i++) {
+        stats[i] = reset ? counters[i]->exchange(0, std::memory_order_relaxed)
+                         : counters[i]->load(std::memory_order_relaxed);
+    }
+    return 0;
+}
+
 } // extern "C"
\ No newline at end of file
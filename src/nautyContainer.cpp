@@ -0,0 +1,402 @@
+#include "nautyContainer.h"
+#include "nautyPipeline.h"
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <fcntl.h>
+#include <memory>
+#include <mutex>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <unordered_map>
+
+namespace {
+
+const char MAGIC[8] = {'N', 'A', 'U', 'T', 'Y', 'G', 'C', '\0'};
+const uint32_t VERSION = 1;
+
+const uint32_t FLAG_DIRECTED = 1;
+const uint32_t FLAG_CANONICAL = 2;
+const uint32_t FLAG_HASHES = 4;
+
+struct ContainerHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t wordSize;
+    uint32_t layout;
+    uint32_t flags;
+    uint32_t n;
+    uint32_t m;
+    uint64_t count;
+    uint64_t indexOffset;
+    uint64_t hashOffset;
+    uint64_t reserved;
+};
+static_assert(sizeof(ContainerHeader) == 64, "container header is 64 bytes");
+
+// Per-graph words the workers pass to the writer in batch.keys: the vertex
+// count with the directed flag in bit 32, then the two hash words.
+const int KEY_WORDS = 3;
+
+// Append graph g as a CSR block: n, arc count, offsets, targets, padding.
+void appendCsr(const graph* g, int m, int n, std::string& out) {
+    std::vector<uint32_t> block(2 + n + 1);
+    block[0] = n;
+    for (int v = 0; v < n; v++) {
+        block[2 + v] = (uint32_t)(block.size() - (2 + n + 1));
+        const set* row = GRAPHROW(g, v, m);
+        for (int w = -1; (w = nextelement(row, m, w)) >= 0;) block.push_back(w);
+    }
+    block[1] = (uint32_t)(block.size() - (2 + n + 1));
+    block[2 + n] = block[1];
+    if (block.size() % 2) block.push_back(0);
+    out.append((const char*)block.data(), block.size() * sizeof(uint32_t));
+}
+
+bool writeAt(int fd, const void* data, size_t size, off_t offset) {
+    const char* p = (const char*)data;
+    while (size > 0) {
+        ssize_t put = ::pwrite(fd, p, size, offset);
+        if (put <= 0) return false;
+        p += put;
+        size -= put;
+        offset += put;
+    }
+    return true;
+}
+
+struct Container {
+    ~Container() { ::munmap((void*)base, size); }
+
+    const char* base = nullptr;
+    size_t size = 0;
+    ContainerHeader header;
+    const uint64_t* index = nullptr;
+    const uint64_t* hashes = nullptr;
+
+    const char* record(int64_t i) const { return base + index[i]; }
+};
+
+std::mutex containers_mutex;
+std::unordered_map<int64_t, std::shared_ptr<const Container>> containers;
+int64_t next_container_id = 0;
+
+std::shared_ptr<const Container> lookupContainer(int64_t containerId) {
+    std::lock_guard<std::mutex> lock(containers_mutex);
+    auto it = containers.find(containerId);
+    return it == containers.end() ? nullptr : it->second;
+}
+
+// The CSR block of graph i, or null if it does not fit its record. Blocks
+// are checked when used rather than on open, so opening a container reads
+// only its index.
+const uint32_t* csrBlock(const Container& c, int64_t i) {
+    uint64_t bytes = c.index[i + 1] - c.index[i];
+    const uint32_t* block = (const uint32_t*)c.record(i);
+    if (bytes < 12) return nullptr;
+    uint64_t n = block[0], arcs = block[1];
+    if ((3 + n + arcs) * 4 > bytes || block[2 + n] != arcs) return nullptr;
+    return block;
+}
+
+// Vertex count of graph i, or -1 if its record is damaged.
+int storedVertices(const Container& c, int64_t i) {
+    if (c.header.layout == NAUTY_CONTAINER_DENSE) return (int)c.header.n;
+    const uint32_t* block = csrBlock(c, i);
+    return block ? (int)block[0] : -1;
+}
+
+// Rows of stored graph i into g, which holds m*n setwords.
+void loadRows(const Container& c, int64_t i, int m, int n, graph* g) {
+    if (c.header.layout == NAUTY_CONTAINER_DENSE) {
+        std::memcpy(g, c.record(i), (size_t)m * n * sizeof(graph));
+        return;
+    }
+    const uint32_t* offsets = csrBlock(c, i) + 2;
+    const uint32_t* targets = offsets + n + 1;
+    EMPTYGRAPH(g, m, n);
+    for (int v = 0; v < n; v++) {
+        for (uint32_t a = offsets[v]; a < offsets[v + 1] && a < offsets[n]; a++) {
+            if (targets[a] < (uint32_t)n) ADDELEMENT(GRAPHROW(g, v, m), targets[a]);
+        }
+    }
+}
+
+// Check the header and that every offset lies inside the file.
+bool validate(Container& c) {
+    if (c.size < sizeof(ContainerHeader)) return false;
+    std::memcpy(&c.header, c.base, sizeof(ContainerHeader));
+    const ContainerHeader& h = c.header;
+    if (std::memcmp(h.magic, MAGIC, sizeof(MAGIC)) != 0 || h.version != VERSION) return false;
+    if (h.wordSize != WORDSIZE || h.layout > NAUTY_CONTAINER_CSR) return false;
+    if (h.count > c.size / sizeof(uint64_t)) return false;
+    // Offsets come from the file: compare against the space left after
+    // them, so a damaged offset cannot wrap the sum past c.size.
+    if (h.indexOffset % 8 || h.indexOffset > c.size) return false;
+    if ((h.count + 1) * 8 > c.size - h.indexOffset) return false;
+    c.index = (const uint64_t*)(c.base + h.indexOffset);
+    if (h.flags & FLAG_HASHES) {
+        if (h.hashOffset % 8 || h.hashOffset > c.size) return false;
+        if (h.count * 24 > c.size - h.hashOffset) return false;
+        c.hashes = (const uint64_t*)(c.base + h.hashOffset);
+    }
+    if (h.layout == NAUTY_CONTAINER_DENSE && h.m != (h.n ? SETWORDSNEEDED(h.n) : 0)) {
+        return false;
+    }
+    uint64_t stride = (uint64_t)h.m * h.n * sizeof(graph);
+    for (uint64_t i = 0; i < h.count; i++) {
+        uint64_t start = c.index[i], end = c.index[i + 1];
+        if (start < sizeof(ContainerHeader) || start > end || end > h.indexOffset) return false;
+        if (h.layout == NAUTY_CONTAINER_DENSE && end - start != stride) return false;
+    }
+    return true;
+}
+
+} // namespace
+
+extern "C" {
+
+int64_t nautyContainerWrite(
+    const char* inputPath,
+    const char* outputPath,
+    int64_t layout,
+    int64_t canonicalize,
+    int64_t withHashes,
+    int64_t numThreads,
+    int64_t* graphsWritten
+) {
+    if (graphsWritten) *graphsWritten = 0;
+    if (layout != NAUTY_CONTAINER_DENSE && layout != NAUTY_CONTAINER_CSR) return -4;
+    // The trailer and header are written back into the file afterwards, so
+    // the output must be seekable: no stdout, pipes or devices.
+    struct stat st;
+    if (std::strcmp(outputPath, "-") == 0) return -2;
+    if (::stat(outputPath, &st) == 0 && !S_ISREG(st.st_mode)) return -2;
+    bool csr = layout == NAUTY_CONTAINER_CSR;
+    bool label = canonicalize != 0;
+    bool hashes = withHashes != 0;
+
+    // Workers encode each graph's record; the writer checks that the
+    // graphs agree, and records offsets and hashes for the trailer.
+    LineHandler encode = [csr, label, hashes](const char* line, size_t len,
+                                              LabelScratch& scratch, LineBatch& batch) {
+        ParsedGraph parsed;
+        if (!parseGraphLine(line, len, scratch, parsed)) return false;
+        int m = parsed.m, n = parsed.n;
+        graph* g = scratch.g.data();
+        if (n > 0 && label) {
+            canonicalLabel(g, m, n, parsed.digraph, scratch.lab.data(), scratch.canong.data(),
+                           nullptr);
+            g = scratch.canong.data();
+        }
+        if (csr) {
+            appendCsr(g, m, n, batch.output);
+        } else {
+            batch.output.append((const char*)g, (size_t)m * n * sizeof(graph));
+        }
+        uint64_t hash[2] = {0, 0};
+        if (hashes) hashGraph(g, m, n, parsed.digraph, hash);
+        batch.keys.push_back((uint64_t)n | (uint64_t)parsed.directed << 32);
+        batch.keys.push_back(hash[0]);
+        batch.keys.push_back(hash[1]);
+        batch.outputEnds.push_back(batch.output.size());
+        return true;
+    };
+
+    ContainerHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.wordSize = WORDSIZE;
+    header.layout = (uint32_t)layout;
+    header.flags = (label ? FLAG_CANONICAL : 0) | (hashes ? FLAG_HASHES : 0);
+
+    std::vector<uint64_t> index;
+    std::vector<std::array<uint64_t, 3>> hashColumn;
+    uint64_t offset = sizeof(ContainerHeader);
+    bool first = true, mismatch = false;
+    BatchFilter collect = [&](LineBatch& batch) {
+        for (size_t i = 0; i < batch.outputEnds.size(); i++) {
+            const uint64_t* key = &batch.keys[i * KEY_WORDS];
+            uint32_t n = (uint32_t)key[0];
+            bool directed = key[0] >> 32;
+            if (first) {
+                header.n = n;
+                header.m = n ? SETWORDSNEEDED(n) : 0;
+                if (directed) header.flags |= FLAG_DIRECTED;
+                first = false;
+            }
+            if (directed != ((header.flags & FLAG_DIRECTED) != 0)) mismatch = true;
+            if (n != header.n) {
+                if (!csr) mismatch = true;
+                header.n = 0;
+                header.m = 0;
+            }
+            if (hashes) hashColumn.push_back({key[1], key[2], (uint64_t)index.size()});
+            index.push_back(offset + (i ? batch.outputEnds[i - 1] : 0));
+        }
+        offset += batch.output.size();
+        if (mismatch) batch.output.clear();
+        if (batch.seq == 0) batch.output.insert(0, sizeof(ContainerHeader), '\0');
+    };
+
+    int64_t ret = runLinePipeline(inputPath, outputPath, true, numThreads, encode, collect,
+                                  nullptr);
+    // Without its trailer the output is not a container; remove it.
+    if (ret == -3 || mismatch) ::unlink(outputPath);
+    if (ret != 0) return ret;
+    if (mismatch) return -5;
+
+    // Append the index and hash column, then fill in the header.
+    std::sort(hashColumn.begin(), hashColumn.end());
+    header.count = index.size();
+    index.push_back(offset);
+    header.indexOffset = offset;
+    header.hashOffset = hashes ? offset + index.size() * sizeof(uint64_t) : 0;
+
+    int fd = ::open(outputPath, O_WRONLY);
+    if (fd < 0) return -2;
+    bool ok = writeAt(fd, index.data(), index.size() * sizeof(uint64_t), offset);
+    ok = ok && writeAt(fd, hashColumn.data(), hashColumn.size() * sizeof(hashColumn[0]),
+                       offset + index.size() * sizeof(uint64_t));
+    ok = ok && writeAt(fd, &header, sizeof(header), 0);
+    ok = ::close(fd) == 0 && ok;
+    if (!ok) return -2;
+    if (graphsWritten) *graphsWritten = header.count;
+    return 0;
+}
+
+int64_t nautyContainerOpen(const char* path) {
+    int fd = ::open(path, O_RDONLY);
+    if (fd < 0) return -1;
+    struct stat st;
+    if (::fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+        ::close(fd);
+        return -1;
+    }
+    if ((size_t)st.st_size < sizeof(ContainerHeader)) {
+        ::close(fd);
+        return -2;
+    }
+    void* map = ::mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (map == MAP_FAILED) return -1;
+
+    auto c = std::make_shared<Container>();
+    c->base = (const char*)map;
+    c->size = st.st_size;
+    if (!validate(*c)) return -2;
+
+    std::lock_guard<std::mutex> lock(containers_mutex);
+    int64_t id = next_container_id++;
+    containers[id] = c;
+    return id;
+}
+
+int64_t nautyContainerClose(int64_t containerId) {
+    std::lock_guard<std::mutex> lock(containers_mutex);
+    return containers.erase(containerId) ? 0 : -1;
+}
+
+int64_t nautyContainerCount(int64_t containerId) {
+    std::shared_ptr<const Container> c = lookupContainer(containerId);
+    return c ? (int64_t)c->header.count : -1;
+}
+
+int64_t nautyContainerGraph(
+    int64_t containerId,
+    int64_t index,
+    int64_t adjacency[],
+    int64_t maxVertices
+) {
+    std::shared_ptr<const Container> c = lookupContainer(containerId);
+    if (!c) return -1;
+    if (index < 0 || (uint64_t)index >= c->header.count) return -2;
+    int n = storedVertices(*c, index);
+    if (n < 0) return -2;
+    if (n > maxVertices) return -3;
+
+    int m = SETWORDSNEEDED(n);
+    std::vector<graph> g((size_t)m * n);
+    loadRows(*c, index, m, n, g.data());
+    for (int i = 0; i < n; i++) {
+        const set* row = GRAPHROW(g.data(), i, m);
+        for (int j = 0; j < n; j++) adjacency[i * n + j] = ISELEMENT(row, j) ? 1 : 0;
+    }
+    return n;
+}
+
+const uint64_t* nautyContainerRows(
+    int64_t containerId,
+    int64_t index,
+    int64_t* n,
+    int64_t* m
+) {
+    std::shared_ptr<const Container> c = lookupContainer(containerId);
+    if (!c || c->header.layout != NAUTY_CONTAINER_DENSE) return nullptr;
+    if (index < 0 || (uint64_t)index >= c->header.count) return nullptr;
+    *n = c->header.n;
+    *m = c->header.m;
+    return (const uint64_t*)c->record(index);
+}
+
+int64_t nautyContainerCsr(
+    int64_t containerId,
+    int64_t index,
+    const uint32_t** offsets,
+    const uint32_t** targets
+) {
+    std::shared_ptr<const Container> c = lookupContainer(containerId);
+    if (!c) return -1;
+    if (index < 0 || (uint64_t)index >= c->header.count) return -2;
+    if (c->header.layout != NAUTY_CONTAINER_CSR) return -3;
+    const uint32_t* block = csrBlock(*c, index);
+    if (!block) return -2;
+    *offsets = block + 2;
+    *targets = block + 2 + block[0] + 1;
+    return block[0];
+}
+
+int64_t nautyContainerFind(
+    int64_t containerId,
+    int64_t adjacency[],
+    int64_t n
+) {
+    std::shared_ptr<const Container> c = lookupContainer(containerId);
+    if (!c) return -1;
+    if (!c->hashes) return -2;
+    if (n < 0) return -3;
+
+    int m = SETWORDSNEEDED(n);
+    std::vector<graph> g((size_t)m * n), canong((size_t)m * n), stored((size_t)m * n);
+    std::vector<int> lab(n);
+    bool digraph = (c->header.flags & FLAG_DIRECTED) != 0;
+    EMPTYGRAPH(g.data(), m, n);
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j < n; j++) {
+            if (adjacency[i * n + j] == 0) continue;
+            ADDELEMENT(GRAPHROW(g.data(), i, m), j);
+            if (i == j) digraph = true;
+        }
+    }
+    if (n > 0) canonicalLabel(g.data(), m, (int)n, digraph, lab.data(), canong.data(), nullptr);
+    uint64_t hash[2];
+    hashGraph(canong.data(), m, (int)n, digraph, hash);
+
+    // Triples sort by hash first; check each with an equal hash.
+    typedef std::array<uint64_t, 3> Entry;
+    const Entry* column = (const Entry*)c->hashes;
+    const Entry* end = column + c->header.count;
+    Entry lowest = {hash[0], hash[1], 0};
+    for (const Entry* e = std::lower_bound(column, end, lowest);
+         e != end && (*e)[0] == hash[0] && (*e)[1] == hash[1]; ++e) {
+        int64_t i = (int64_t)(*e)[2];
+        if (i >= (int64_t)c->header.count || storedVertices(*c, i) != n) continue;
+        loadRows(*c, i, m, (int)n, stored.data());
+        if (std::equal(stored.begin(), stored.end(), canong.begin())) return i;
+    }
+    return -3;
+}
+
+} // extern "C"
@@ -0,0 +1,476 @@
+#include "nautyCore.h"
+#include "nautyBatch.h"
+#include "nautyMemory.h"
+#include "nautySetOps.h"
+#include <gtools.h>
+#include <nausparse.h>
+#include <nautinv.h>
+#include <thread>
+#include <vector>
+
+#if !HAVE_TLS
+static std::mutex nauty_mutex;
+#endif
+
+NautyGuard::NautyGuard(int n) {
+#if !HAVE_TLS
+    nauty_mutex.lock();
+#endif
+    noteNautyThread(n);
+}
+
+NautyGuard::~NautyGuard() {
+    publishThreadMemory();
+#if !HAVE_TLS
+    nauty_mutex.unlock();
+#endif
+}
+
+namespace {
+
+// Per-thread nauty scratch, grown to the largest graph seen by the thread.
+struct CanonScratch {
+    std::vector<int> ptn;
+    std::vector<int> orbits;
+    std::vector<int> count;
+    std::vector<set> active;
+    std::vector<setword> workspace;
+
+    void reserve(int m, int n) {
+        if (ptn.size() < (size_t)n) {
+            ptn.resize(n);
+            orbits.resize(n);
+        }
+        if (count.size() < (size_t)n) count.resize(n);
+        if (active.size() < (size_t)m) active.resize(m);
+        if (workspace.size() < (size_t)(100 * m)) workspace.resize(100 * m);
+    }
+
+    void release() {
+        freeVector(ptn);
+        freeVector(orbits);
+        freeVector(count);
+        freeVector(active);
+        freeVector(workspace);
+    }
+
+    size_t bytes() const {
+        return capacityBytes(ptn) + capacityBytes(orbits) + capacityBytes(count) +
+               capacityBytes(active) + capacityBytes(workspace);
+    }
+};
+
+thread_local CanonScratch scratch;
+
+// As in labelg.c.
+InvariantProc invariants[NUM_INVARIANTS] = {
+    nullptr, twopaths, adjtriang, triples, quadruples, celltrips, cellquads,
+    cellquins, distances, indsets, cliques, cellcliq, cellind, adjacencies,
+    cellfano, cellfano2, refinvar,
+};
+
+// Same as gtnauty.c.
+const int MIN_SCHREIER = 33;
+
+// Per-thread sparse forms for canonicalLabel's sparse mode, grown by
+// SG_ALLOC as needed.
+struct SparseScratch {
+    sparsegraph sg;
+    sparsegraph canon;
+    SparseScratch() {
+        SG_INIT(sg);
+        SG_INIT(canon);
+    }
+    ~SparseScratch() { release(); }
+
+    // Edge arrays grow with the graphs seen; only the vertex arrays are
+    // sized here.
+    void reserve(int n) {
+        DYNALLOC1(size_t, sg.v, sg.vlen, n, "SparseScratch");
+        DYNALLOC1(int, sg.d, sg.dlen, n, "SparseScratch");
+        DYNALLOC1(size_t, canon.v, canon.vlen, n, "SparseScratch");
+        DYNALLOC1(int, canon.d, canon.dlen, n, "SparseScratch");
+    }
+
+    void release() {
+        SG_FREE(sg);
+        SG_FREE(canon);
+    }
+
+    size_t bytes() const {
+        return (sg.vlen + canon.vlen) * sizeof(size_t) + (sg.dlen + canon.dlen) * sizeof(int) +
+               (sg.elen + canon.elen) * sizeof(int) + (sg.wlen + canon.wlen) * sizeof(sg_weight);
+    }
+};
+
+thread_local SparseScratch sparseScratch;
+
+// canonicalLabel through nauty's sparse dispatch; lab is the unit partition.
+void canonicalLabelSparse(graph* g, int m, int n, bool digraph, int* lab, graph* canong,
+                          statsblk* stats, const SearchSettings& settings) {
+    sparsegraph& sg = sparseScratch.sg;
+    size_t nde = 0;
+    for (size_t i = 0; i < (size_t)m * n; i++) nde += setwordPopcount(g[i]);
+    SG_ALLOC(sg, n, nde, "canonicalLabel");
+    sg.nv = n;
+    sg.nde = nde;
+    size_t k = 0;
+    for (int i = 0; i < n; i++) {
+        set* gi = GRAPHROW(g, i, m);
+        sg.v[i] = k;
+        for (int j = -1; (j = nextElement(gi, m, j)) >= 0;) sg.e[k++] = j;
+        sg.d[i] = (int)(k - sg.v[i]);
+    }
+
+    DEFAULTOPTIONS_SPARSEGRAPH(options);
+    options.getcanon = TRUE;
+    options.defaultptn = TRUE;
+    options.digraph = digraph ? TRUE : FALSE;
+    options.tc_level = settings.tcLevel;
+    options.schreier = settings.schreier ? TRUE : FALSE;
+    statsblk localStats;
+
+    NautyGuard guard(n);
+    sparsenauty(&sg, lab, scratch.ptn.data(), scratch.orbits.data(), &options,
+                stats ? stats : &localStats, &sparseScratch.canon);
+    graphDispatch()->updatecan(g, canong, lab, 0, m, n);
+}
+
+struct LabelgScratch {
+    std::vector<int> lab, ptn, orbits, count;
+    std::vector<set> active;
+    std::vector<setword> workspace;
+
+    void reserve(int m, int n) {
+        if (lab.size() < (size_t)n) {
+            lab.resize(n);
+            ptn.resize(n);
+            orbits.resize(n);
+            count.resize(n);
+        }
+        if (active.size() < (size_t)m) active.resize(m);
+        if (workspace.size() < (size_t)(1000 * m)) workspace.resize(1000 * m);
+    }
+
+    void release() {
+        freeVector(lab);
+        freeVector(ptn);
+        freeVector(orbits);
+        freeVector(count);
+        freeVector(active);
+        freeVector(workspace);
+    }
+
+    size_t bytes() const {
+        return capacityBytes(lab) + capacityBytes(ptn) + capacityBytes(orbits) +
+               capacityBytes(count) + capacityBytes(active) + capacityBytes(workspace);
+    }
+};
+
+thread_local LabelgScratch labelgScratch;
+
+const bool scratchRegistered = registerScratch({
+    [](int m, int n) {
+        scratch.reserve(m, n);
+        sparseScratch.reserve(n);
+        labelgScratch.reserve(m, n);
+    },
+    [] {
+        scratch.release();
+        sparseScratch.release();
+        labelgScratch.release();
+    },
+    [] { return scratch.bytes() + sparseScratch.bytes() + labelgScratch.bytes(); },
+});
+
+} // namespace
+
+InvariantProc invariantProc(int invariant) {
+    return invariants[invariant];
+}
+
+uint64_t mix64(uint64_t x) {
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return x;
+}
+
+void canonicalLabel(graph* g, int m, int n, bool digraph,
+                    int* lab, graph* canong, statsblk* stats,
+                    const SearchSettings* settings) {
+    scratch.reserve(m, n);
+
+    for (int i = 0; i < n; i++) {
+        lab[i] = i;
+        scratch.ptn[i] = 1;
+    }
+    scratch.ptn[n - 1] = 0;
+    if (settings && settings->sparse) {
+        canonicalLabelSparse(g, m, n, digraph, lab, canong, stats, *settings);
+        return;
+    }
+
+    DEFAULTOPTIONS_GRAPH(options);
+    options.getcanon = TRUE;
+    options.defaultptn = TRUE;
+    options.digraph = digraph ? TRUE : FALSE;
+    options.dispatch = graphDispatch();
+    if (settings) {
+        const LabelgOptions& inv = settings->invariant;
+        if (inv.invariant > 0) {
+            options.invarproc = invariants[inv.invariant];
+            options.mininvarlevel = inv.minInvarLevel;
+            options.maxinvarlevel = inv.maxInvarLevel;
+            options.invararg = inv.invarArg;
+        }
+        options.tc_level = settings->tcLevel;
+        options.schreier = settings->schreier ? TRUE : FALSE;
+        if (settings->dispatch) options.dispatch = settings->dispatch;
+    }
+    statsblk localStats;
+
+    NautyGuard guard(n);
+    nauty(g, lab, scratch.ptn.data(), nullptr, scratch.orbits.data(), &options,
+          stats ? stats : &localStats, scratch.workspace.data(), 100 * m, m, n, canong);
+}
+
+bool discreteLabel(graph* g, int m, int n, int* lab) {
+    scratch.reserve(m, n);
+    int* ptn = scratch.ptn.data();
+    set* active = scratch.active.data();
+
+    for (int i = 0; i < n; i++) {
+        lab[i] = i;
+        ptn[i] = 1;
+    }
+    ptn[n - 1] = 0;
+    EMPTYSET(active, m);
+    ADDELEMENT(active, 0);
+
+    dispatchvec* dispatch = graphDispatch();
+    int numcells = 1, code;
+    if (m == 1) {
+        dispatch->refine1(g, lab, ptn, 0, &numcells, scratch.count.data(), active, &code, 1, n);
+    } else {
+        dispatch->refine(g, lab, ptn, 0, &numcells, scratch.count.data(), active, &code, m, n);
+    }
+    return numcells == n;
+}
+
+void canonicalLabelg(graph* g, int m, int n, bool digraph,
+                     const LabelgOptions& opts, graph* canong) {
+    if (n == 0) return;
+    LabelgScratch& ls = labelgScratch;
+    ls.reserve(m, n);
+    int* lab = ls.lab.data();
+    int* ptn = ls.ptn.data();
+    int* count = ls.count.data();
+    set* active = ls.active.data();
+
+    NautyGuard guard(n);
+    int numcells = setlabptnfmt((char*)opts.vertexFormat, lab, ptn, active, m, n);
+    for (int i = 0; i < n && !digraph; i++) digraph = ISELEMENT(GRAPHROW(g, i, m), i);
+
+    dispatchvec* dispatch = graphDispatch();
+    int code;
+    if (m == 1) {
+        dispatch->refine1(g, lab, ptn, 0, &numcells, count, active, &code, 1, n);
+    } else {
+        dispatch->refine(g, lab, ptn, 0, &numcells, count, active, &code, m, n);
+    }
+
+    if (numcells == n || (!digraph && numcells >= n - 1)) {
+        for (int i = 0; i < n; i++) count[i] = lab[i];
+        dispatch->updatecan(g, canong, count, 0, m, n);
+        return;
+    }
+
+    DEFAULTOPTIONS_GRAPH(options);
+    options.getcanon = TRUE;
+    options.digraph = digraph ? TRUE : FALSE;
+    options.defaultptn = FALSE;
+    if (opts.invariant > 0) {
+        options.invarproc = invariants[opts.invariant];
+        options.mininvarlevel = opts.minInvarLevel;
+        options.maxinvarlevel = opts.maxInvarLevel;
+        options.invararg = opts.invarArg;
+    }
+    if (n >= MIN_SCHREIER) options.schreier = TRUE;
+    options.dispatch = dispatch;
+
+    statsblk stats;
+    EMPTYSET(active, m);
+    nauty(g, lab, ptn, active, ls.orbits.data(), &options, &stats, ls.workspace.data(),
+          1000 * m, m, n, canong);
+}
+
+void hashGraph(const graph* g, int m, int n, bool digraph, uint64_t out[2], uint64_t seed) {
+    const uint64_t K0 = 0xa0761d6478bd642fULL, K1 = 0xe7037ed1a0b428dbULL;
+    const uint64_t K2 = 0x8ebc6af09c88c6e3ULL, K3 = 0x589965cc75374cc3ULL;
+    auto mum = [](uint64_t a, uint64_t b) {
+        unsigned __int128 r = (unsigned __int128)a * b;
+        return (uint64_t)r ^ (uint64_t)(r >> 64);
+    };
+
+    uint64_t h0 = mum((uint64_t)n ^ K0 ^ seed, digraph ? K2 : K1);
+    uint64_t h1 = mum((uint64_t)n ^ K3 ^ mix64(seed), digraph ? K1 : K2);
+    size_t words = (size_t)m * (size_t)n;
+    for (size_t i = 0; i < words; i++) {
+        uint64_t w = (uint64_t)g[i];
+        h0 = mum(h0 ^ w ^ K1, K0 ^ i);
+        h1 = mum(h1 ^ w ^ K3, K2 ^ h0);
+    }
+    out[0] = mum(h0 ^ K2, h1 ^ K3);
+    out[1] = mum(h1 ^ K0, out[0] ^ K1);
+}
+
+// Bit-reverses a byte: packed rows count from bit 0, nauty sets from the top.
+static inline uint64_t reverseByte(uint64_t x) {
+    return ((x * 0x80200802ULL) & 0x0884422110ULL) * 0x0101010101ULL >> 32 & 0xff;
+}
+
+// Both directions move whole rows, without a branch per bit.
+void unpackGraph(uint64_t packed, int k, graph* g) {
+    const uint64_t rowMask = (1ULL << k) - 1;
+    for (int i = 0; i < k; i++) {
+        g[i] = (setword)reverseByte(packed >> (i * k) & rowMask) << (WORDSIZE - 8);
+    }
+}
+
+uint64_t packGraph(const graph* g, int k) {
+    const uint64_t rowMask = (1ULL << k) - 1;
+    uint64_t packed = 0;
+    for (int i = 0; i < k; i++) {
+        packed |= (reverseByte((uint64_t)(g[i] >> (WORDSIZE - 8))) & rowMask) << (i * k);
+    }
+    return packed;
+}
+
+uint64_t canonicalPacked(uint64_t packed, int k, bool digraph) {
+    graph g[MAX_PACKED_SIZE];
+    graph canong[MAX_PACKED_SIZE];
+    int lab[MAX_PACKED_SIZE];
+
+    unpackGraph(packed, k, g);
+    canonicalLabel(g, 1, k, digraph, lab, canong, nullptr);
+    return packGraph(canong, k);
+}
+
+CanonCache::CanonCache(size_t maxEntries)
+    : maxPerShard(maxEntries / NUM_SHARDS + 1) {}
+
+CanonCache::Shard& CanonCache::shardFor(uint64_t packed, int k, bool digraph) {
+    return shards[digraph ? 1 : 0][k][mix64(packed) % NUM_SHARDS];
+}
+
+uint64_t CanonCache::canonical(uint64_t packed, int k, bool digraph) {
+    Shard& shard = shardFor(packed, k, digraph);
+    {
+        std::lock_guard<std::mutex> lock(shard.lock);
+        auto it = shard.map.find(packed);
+        if (it != shard.map.end()) return it->second;
+    }
+
+    // Run nauty outside the shard lock; a racing thread computes the same value.
+    uint64_t canon = canonicalPacked(packed, k, digraph);
+
+    std::lock_guard<std::mutex> lock(shard.lock);
+    if (shard.map.size() < maxPerShard) {
+        shard.map.emplace(packed, canon);
+    }
+    return canon;
+}
+
+void CanonCache::canonicalBatch(const uint64_t* packed, int64_t count, int k, bool digraph,
+                                uint64_t* out) {
+    std::vector<int64_t> missed;
+    std::vector<uint64_t> misses;
+    for (int64_t i = 0; i < count; i++) {
+        Shard& shard = shardFor(packed[i], k, digraph);
+        std::lock_guard<std::mutex> lock(shard.lock);
+        auto it = shard.map.find(packed[i]);
+        if (it != shard.map.end()) {
+            out[i] = it->second;
+        } else {
+            missed.push_back(i);
+            misses.push_back(packed[i]);
+        }
+    }
+    if (missed.empty()) return;
+
+    std::vector<uint64_t> canons(misses.size());
+    canonicalPackedBatch(misses.data(), (int64_t)misses.size(), k, digraph, canons.data());
+    for (size_t j = 0; j < missed.size(); j++) {
+        out[missed[j]] = canons[j];
+        Shard& shard = shardFor(misses[j], k, digraph);
+        std::lock_guard<std::mutex> lock(shard.lock);
+        if (shard.map.size() < maxPerShard) shard.map.emplace(misses[j], canons[j]);
+    }
+}
+
+size_t CanonCache::size() const {
+    size_t total = 0;
+    for (const auto& byDigraph : shards) {
+        for (const auto& byK : byDigraph) {
+            for (const Shard& shard : byK) {
+                std::lock_guard<std::mutex> lock(shard.lock);
+                total += shard.map.size();
+            }
+        }
+    }
+    return total;
+}
+
+void CanonCache::clear() {
+    for (auto& byDigraph : shards) {
+        for (auto& byK : byDigraph) {
+            for (Shard& shard : byK) {
+                std::lock_guard<std::mutex> lock(shard.lock);
+                shard.map.clear();
+            }
+        }
+    }
+}
+
+CanonCache& sharedCanonCache() {
+    static CanonCache cache;
+    return cache;
+}
+
+int resolveThreadCount(int64_t numThreads) {
+    if (numThreads > 0) return (int)numThreads;
+    unsigned hw = std::thread::hardware_concurrency();
+    return hw ? (int)hw : 1;
+}
+
+FastRng::FastRng(uint64_t seed) {
+    // Expand the seed with splitmix64 so nearby seeds give unrelated streams.
+    for (int i = 0; i < 4; i++) {
+        seed += 0x9e3779b97f4a7c15ULL;
+        s[i] = mix64(seed);
+    }
+}
+
+uint64_t FastRng::next() {
+    auto rotl = [](uint64_t x, int r) { return (x << r) | (x >> (64 - r)); };
+    uint64_t result = rotl(s[1] * 5, 7) * 9;
+    uint64_t t = s[1] << 17;
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = rotl(s[3], 45);
+    return result;
+}
+
+uint64_t FastRng::below(uint64_t bound) {
+    return (uint64_t)(((unsigned __int128)next() * bound) >> 64);
+}
+
+double FastRng::uniform() {
+    return (next() >> 11) * (1.0 / 9007199254740992.0);
+}
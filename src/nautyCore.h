@@ -0,0 +1,331 @@
+#ifndef NAUTY_CORE_H
+#define NAUTY_CORE_H
+
+// Internal helpers shared by the wrapper modules. Not part of the C API.
+
+#include <nauty.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// nauty.h spells TLS as C11 _Thread_local, which C++ does not accept; the
+// GNU spelling has the same ABI, so use it for any headers included after.
+#if HAVE_TLS
+#undef TLS_ATTR
+#define TLS_ATTR __thread
+#endif
+
+// Serialises nauty calls when nauty was built without thread-local storage.
+// With a TLS build every thread has its own nauty state and no lock is taken.
+// n is the size of the graph nauty is about to run on, which sizes nauty's
+// buffers in the thread's memory account (nautyMemory.h).
+class NautyGuard {
+public:
+    explicit NautyGuard(int n = 0);
+    ~NautyGuard();
+    NautyGuard(const NautyGuard&) = delete;
+    NautyGuard& operator=(const NautyGuard&) = delete;
+};
+
+// Vertex invariants numbered as by labelg -i; 0 means none.
+const int NUM_INVARIANTS = 17;
+
+// labelg's choices of vertex colouring and invariant (-f, -i, -I, -K).
+struct LabelgOptions {
+    const char* vertexFormat = nullptr;
+    int invariant = 0;
+    int minInvarLevel = 1;
+    int maxInvarLevel = 1;
+    int invarArg = 3;
+};
+
+// nauty's procedure for labelg's invariant number, null for 0.
+typedef void (*InvariantProc)(graph*, int*, int*, int, int, int, int*, int, boolean, int, int);
+InvariantProc invariantProc(int invariant);
+
+// Search settings other than nauty's defaults. Each changes which
+// labelling is canonical, so labellings compare only under equal settings.
+struct SearchSettings {
+    LabelgOptions invariant;          // Invariant and levels; vertexFormat is ignored
+    int tcLevel = 100;                // options.tc_level; nauty uses 0 for digraphs
+    bool schreier = false;            // options.schreier
+    dispatchvec* dispatch = nullptr;  // Null for graphDispatch()
+    // Search the sparsegraph form through nausparse.c, whose refinement
+    // costs time in the edges rather than n * m. invariant and dispatch are
+    // then not used.
+    bool sparse = false;
+};
+
+// Canonically label g (n vertices, m setwords per row). lab receives the
+// canonical labelling and canong the relabelled graph. Scratch space is
+// per-thread and reused between calls. stats and settings may be null.
+void canonicalLabel(graph* g, int m, int n, bool digraph,
+                    int* lab, graph* canong, statsblk* stats,
+                    const SearchSettings* settings = nullptr);
+
+// Refine the unit partition of g as the root of nauty's search does. If it
+// ends discrete the automorphism group is trivial and lab is the labelling
+// nauty would return, digraph or not and whatever the invariant (nauty only
+// applies one to a partition that is not discrete), so the search can be
+// skipped; returns false if any cell remains.
+bool discreteLabel(graph* g, int m, int n, int* lab);
+
+// Canonically label g into canong exactly as labelg does (fcanonise_inv):
+// refine first, and skip the search when the partition is (almost) discrete.
+// Unlike fcanonise_inv it shares no options block, so threads may call it
+// concurrently.
+void canonicalLabelg(graph* g, int m, int n, bool digraph,
+                     const LabelgOptions& opts, graph* canong);
+
+// 128-bit non-cryptographic hash of a (canonical) graph's rows, mixed
+// wyhash-style with 64x64->128 multiplies. n and digraph are part of the key;
+// different seeds give independent hashes.
+void hashGraph(const graph* g, int m, int n, bool digraph, uint64_t out[2],
+               uint64_t seed = 0);
+
+// splitmix64 finaliser: a bijection that spreads every input bit.
+uint64_t mix64(uint64_t x);
+
+// Small graphs (k <= 8) are packed into 64 bits, bit i*k+j for edge i->j.
+const int MAX_PACKED_SIZE = 8;
+
+void unpackGraph(uint64_t packed, int k, graph* g);
+uint64_t packGraph(const graph* g, int k);
+
+// Canonical packed form of a packed k-vertex graph, running nauty.
+uint64_t canonicalPacked(uint64_t packed, int k, bool digraph);
+
+// Thread-safe memo of packed graph -> canonical packed form. Lookups for
+// the same (k, digraph) hit one of several independently locked shards.
+class CanonCache {
+public:
+    explicit CanonCache(size_t maxEntries = 1u << 22);
+
+    uint64_t canonical(uint64_t packed, int k, bool digraph);
+    // out[i] = canonical(packed[i], k, digraph); the misses are labelled
+    // together by canonicalPackedBatch.
+    void canonicalBatch(const uint64_t* packed, int64_t count, int k, bool digraph,
+                        uint64_t* out);
+    size_t size() const;
+    void clear();
+
+private:
+    static const int NUM_SHARDS = 64;
+    struct Shard {
+        mutable std::mutex lock;
+        std::unordered_map<uint64_t, uint64_t> map;
+    };
+    Shard& shardFor(uint64_t packed, int k, bool digraph);
+
+    size_t maxPerShard;
+    Shard shards[2][MAX_PACKED_SIZE + 1][NUM_SHARDS];
+};
+
+// Process-wide cache shared by all census runs.
+CanonCache& sharedCanonCache();
+
+// numThreads <= 0 means one thread per hardware thread.
+int resolveThreadCount(int64_t numThreads);
+
+// Run `body(t)` on `threads` threads, the calling thread being t == 0.
+template <typename Body>
+void runThreads(int threads, Body body) {
+    std::vector<std::thread> pool;
+    for (int t = 1; t < threads; t++) pool.emplace_back(body, t);
+    body(0);
+    for (auto& th : pool) th.join();
+}
+
+// xoshiro256** generator; one instance per thread, never shared.
+class FastRng {
+public:
+    explicit FastRng(uint64_t seed);
+
+    uint64_t next();
+    // Uniform integer in [0, bound).
+    uint64_t below(uint64_t bound);
+    // Uniform double in [0, 1).
+    double uniform();
+
+private:
+    uint64_t s[4];
+};
+
+// Blocking FIFO with a fixed capacity, for handing work between threads.
+// close() wakes everyone; pop() then drains what is left and returns false.
+template <typename T>
+class BoundedQueue {
+public:
+    // How often each side had to wait, and the depth seen by each pop.
+    struct Counters {
+        uint64_t pushes = 0;
+        uint64_t fullWaits = 0;
+        uint64_t pops = 0;
+        uint64_t emptyWaits = 0;
+        uint64_t depthSum = 0;
+    };
+
+    explicit BoundedQueue(size_t capacity) : capacity(capacity) {}
+
+    bool push(T item) {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (!closed && items.size() >= capacity) counts.fullWaits++;
+        notFull.wait(lock, [&] { return closed || items.size() < capacity; });
+        if (closed) return false;
+        items.push_back(std::move(item));
+        counts.pushes++;
+        notEmpty.notify_one();
+        return true;
+    }
+
+    bool pop(T& item) {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (!closed && items.empty()) counts.emptyWaits++;
+        notEmpty.wait(lock, [&] { return closed || !items.empty(); });
+        if (items.empty()) return false;
+        counts.pops++;
+        counts.depthSum += items.size();
+        item = std::move(items.front());
+        items.pop_front();
+        notFull.notify_one();
+        return true;
+    }
+
+    void close() {
+        std::lock_guard<std::mutex> lock(mutex);
+        closed = true;
+        notFull.notify_all();
+        notEmpty.notify_all();
+    }
+
+    size_t size() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return items.size();
+    }
+
+    Counters counters() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return counts;
+    }
+
+    size_t limit() const { return capacity; }
+
+private:
+    size_t capacity;
+    Counters counts;
+    bool closed = false;
+    std::deque<T> items;
+    std::mutex mutex;
+    std::condition_variable notFull, notEmpty;
+};
+
+// Waits that spin briefly, then yield, then sleep, so idle threads give
+// their core back. Call pause() once per unsuccessful check.
+class Backoff {
+public:
+    void pause() {
+        if (++spins < 64) return;
+        if (spins < 128) {
+            std::this_thread::yield();
+        } else {
+            std::this_thread::sleep_for(std::chrono::microseconds(50));
+        }
+    }
+
+private:
+    int spins = 0;
+};
+
+// Where one thread waits for a condition that other threads make true. The
+// waiter spins and yields briefly, then blocks, so an idle thread costs no
+// wakeups. A thread that may have made the condition true calls wake()
+// afterwards; the fences on both sides make sure it either is seen by the
+// waiter's check or sees the waiter and notifies it.
+class WaitPoint {
+public:
+    template <typename Ready>
+    void wait(Ready ready) {
+        Backoff backoff;
+        for (int i = 0; i < SPINS; i++) {
+            if (ready()) return;
+            backoff.pause();
+        }
+        std::unique_lock<std::mutex> lock(mutex);
+        waiters.fetch_add(1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        cv.wait(lock, ready);
+        waiters.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    void wake() {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (waiters.load(std::memory_order_relaxed) == 0) return;
+        std::lock_guard<std::mutex> lock(mutex);
+        cv.notify_all();
+    }
+
+private:
+    // Backoff's spinning and yielding steps, before it would sleep.
+    static const int SPINS = 128;
+
+    std::atomic<int> waiters{0};
+    std::mutex mutex;
+    std::condition_variable cv;
+};
+
+// Lock-free FIFO between exactly one producer and one consumer thread.
+// close() is called by the producer; pop() then drains what is left and
+// returns false. A side that finds the queue full or empty blocks after a
+// short spin, and the other side wakes it.
+template <typename T>
+class SpscQueue {
+public:
+    explicit SpscQueue(size_t capacity) {
+        size_t size = 1;
+        while (size < capacity) size <<= 1;
+        items.resize(size);
+        mask = size - 1;
+    }
+
+    void push(const T& item) {
+        size_t t = tail.load(std::memory_order_relaxed);
+        notFull.wait([&] { return t - head.load(std::memory_order_acquire) <= mask; });
+        items[t & mask] = item;
+        tail.store(t + 1, std::memory_order_release);
+        notEmpty.wake();
+    }
+
+    bool pop(T& item) {
+        size_t h = head.load(std::memory_order_relaxed);
+        notEmpty.wait([&] {
+            return h != tail.load(std::memory_order_acquire) ||
+                   closed.load(std::memory_order_acquire);
+        });
+        if (h == tail.load(std::memory_order_acquire)) return false;
+        item = items[h & mask];
+        head.store(h + 1, std::memory_order_release);
+        notFull.wake();
+        return true;
+    }
+
+    void close() {
+        closed.store(true, std::memory_order_release);
+        notEmpty.wake();
+    }
+
+private:
+    std::vector<T> items;
+    size_t mask;
+    alignas(64) std::atomic<size_t> head{0};
+    alignas(64) std::atomic<size_t> tail{0};
+    std::atomic<bool> closed{false};
+    WaitPoint notEmpty, notFull;
+};
+
+#endif // NAUTY_CORE_H
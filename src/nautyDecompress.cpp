@@ -0,0 +1,251 @@
+#include "nautyDecompress.h"
+#include <algorithm>
+#include <cerrno>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+#include <zlib.h>
+
+namespace {
+
+const size_t READ_BYTES = 1 << 20;
+// Compressed bytes per parallel group, about a pipeline batch of text.
+const size_t GROUP_BYTES = 1 << 18;
+// zlib counts in uInt.
+const size_t MAX_CHUNK = 1u << 30;
+
+uint32_t le16(const unsigned char* p) { return p[0] | p[1] << 8; }
+uint32_t le32(const unsigned char* p) { return le16(p) | le16(p + 2) << 16; }
+
+// Size of the BGZF member at p, from its "BC" extra subfield, or 0 if p is
+// not one or it runs past left bytes.
+size_t bgzfMemberSize(const unsigned char* p, size_t left) {
+    if (left < 18 || p[0] != 0x1f || p[1] != 0x8b || p[2] != 8 || !(p[3] & 4)) return 0;
+    size_t xlen = le16(p + 10);
+    if (12 + xlen > left) return 0;
+    for (size_t i = 12; i + 4 <= 12 + xlen;) {
+        size_t slen = le16(p + i + 2);
+        if (p[i] == 'B' && p[i + 1] == 'C' && slen == 2 && i + 6 <= 12 + xlen) {
+            size_t member = le16(p + i + 4) + 1;
+            return member >= 12 + xlen + 8 && member <= left ? member : 0;
+        }
+        i += 4 + slen;
+    }
+    return 0;
+}
+
+// Inflates as it reads, one member after another.
+class StreamGzipReader : public GzipReader {
+public:
+    StreamGzipReader(const char* data, size_t size, int fd) : data(data), size(size), fd(fd) {
+        std::memset(&strm, 0, sizeof(strm));
+        failed = ::inflateInit2(&strm, 15 + 16) != Z_OK;
+        if (fd >= 0) {
+            // The prefix is the caller's buffer, which it is about to reuse.
+            buffer.assign(data, data + size);
+            this->data = buffer.data();
+        }
+    }
+
+    ~StreamGzipReader() override { ::inflateEnd(&strm); }
+
+    ssize_t read(char* dst, size_t max) override {
+        if (failed) return -1;
+        strm.next_out = (Bytef*)dst;
+        strm.avail_out = (uInt)std::min(max, MAX_CHUNK);
+        uInt start = strm.avail_out;
+        while (strm.avail_out == start) {
+            if (strm.avail_in == 0 && !refill()) {
+                // Input may only end between members.
+                if (!betweenMembers) failed = true;
+                return failed ? -1 : 0;
+            }
+            int ret = ::inflate(&strm, Z_NO_FLUSH);
+            if (ret == Z_STREAM_END) {
+                ::inflateReset(&strm);
+                betweenMembers = true;
+            } else if (ret == Z_OK) {
+                betweenMembers = false;
+            } else {
+                failed = true;
+                return -1;
+            }
+        }
+        return start - strm.avail_out;
+    }
+
+private:
+    bool refill() {
+        if (pos == size && fd >= 0) {
+            buffer.resize(READ_BYTES);
+            ssize_t got;
+            do {
+                got = ::read(fd, buffer.data(), buffer.size());
+            } while (got < 0 && errno == EINTR);
+            if (got < 0) failed = true;
+            if (got <= 0) return false;
+            data = buffer.data();
+            size = got;
+            pos = 0;
+        }
+        if (pos == size) return false;
+        size_t chunk = std::min(size - pos, MAX_CHUNK);
+        strm.next_in = (Bytef*)(data + pos);
+        strm.avail_in = (uInt)chunk;
+        pos += chunk;
+        return true;
+    }
+
+    const char* data;
+    size_t size;
+    size_t pos = 0;
+    int fd;
+    std::vector<char> buffer;
+    z_stream strm;
+    bool failed = false;
+    bool betweenMembers = false;
+};
+
+// Inflates groups of BGZF members on a pool of threads, at most a window
+// of groups ahead of the reader, and hands them over in order.
+class ParallelGzipReader : public GzipReader {
+public:
+    ParallelGzipReader(const char* data, size_t size, int numThreads)
+        : data((const unsigned char*)data), size(size), window(2 * numThreads) {
+        for (int t = 0; t < numThreads; t++) threads.emplace_back([this] { work(); });
+    }
+
+    ~ParallelGzipReader() override {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        changed.notify_all();
+        for (auto& t : threads) t.join();
+    }
+
+    ssize_t read(char* dst, size_t max) override {
+        while (taken == current.text.size()) {
+            std::unique_lock<std::mutex> lock(mutex);
+            changed.wait(lock, [&] { return done.count(nextSeq) || (ended && nextSeq == endSeq); });
+            if (!done.count(nextSeq)) return 0;
+            current = std::move(done[nextSeq]);
+            done.erase(nextSeq++);
+            taken = 0;
+            changed.notify_all();
+            if (!current.ok) return -1;
+        }
+        size_t count = std::min(max, current.text.size() - taken);
+        std::memcpy(dst, current.text.data() + taken, count);
+        taken += count;
+        return count;
+    }
+
+private:
+    struct Group {
+        std::vector<char> text;
+        bool ok = true;
+    };
+
+    void work() {
+        z_stream strm;
+        std::memset(&strm, 0, sizeof(strm));
+        bool ready = ::inflateInit2(&strm, 15 + 16) == Z_OK;
+        std::vector<std::pair<size_t, size_t>> members;
+        for (;;) {
+            int64_t seq;
+            bool valid = ready;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                changed.wait(lock, [&] {
+                    return stopping || ended || cutSeq < nextSeq + window;
+                });
+                if (stopping || ended) break;
+                if (cut == size) {
+                    ended = true;
+                    endSeq = cutSeq;
+                    changed.notify_all();
+                    break;
+                }
+                seq = cutSeq++;
+                members.clear();
+                size_t start = cut;
+                while (cut < size && cut - start < GROUP_BYTES) {
+                    size_t member = bgzfMemberSize(data + cut, size - cut);
+                    if (member == 0) {
+                        // Not BGZF from here on; nothing after this can be cut.
+                        valid = false;
+                        cut = size;
+                        break;
+                    }
+                    members.emplace_back(cut, member);
+                    cut += member;
+                }
+            }
+
+            Group group;
+            size_t total = 0;
+            for (auto& m : members) total += le32(data + m.first + m.second - 4);
+            group.text.resize(total);
+            size_t produced = 0;
+            for (auto& m : members) {
+                if (!valid) break;
+                uInt isize = le32(data + m.first + m.second - 4);
+                strm.next_in = (Bytef*)(data + m.first);
+                strm.avail_in = (uInt)m.second;
+                strm.next_out = (Bytef*)group.text.data() + produced;
+                strm.avail_out = isize;
+                valid = ::inflate(&strm, Z_FINISH) == Z_STREAM_END && strm.avail_out == 0 &&
+                        strm.avail_in == 0;
+                ::inflateReset(&strm);
+                produced += isize;
+            }
+            group.ok = valid;
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                done[seq] = std::move(group);
+            }
+            changed.notify_all();
+        }
+        ::inflateEnd(&strm);
+    }
+
+    const unsigned char* data;
+    size_t size;
+    int64_t window;
+    std::vector<std::thread> threads;
+
+    std::mutex mutex;
+    std::condition_variable changed;
+    size_t cut = 0;
+    int64_t cutSeq = 0;
+    int64_t nextSeq = 0;
+    int64_t endSeq = 0;
+    bool ended = false;
+    bool stopping = false;
+    std::map<int64_t, Group> done;
+
+    // The group being read; only the reading thread touches these.
+    Group current;
+    size_t taken = 0;
+};
+
+} // namespace
+
+bool isGzip(const char* data, size_t size) {
+    return size >= 2 && (unsigned char)data[0] == 0x1f && (unsigned char)data[1] == 0x8b;
+}
+
+std::unique_ptr<GzipReader> openGzip(const char* data, size_t size, int fd, int numThreads) {
+    if (fd < 0 && bgzfMemberSize((const unsigned char*)data, size) > 0) {
+        return std::unique_ptr<GzipReader>(
+            new ParallelGzipReader(data, size, std::max(numThreads, 1)));
+    }
+    return std::unique_ptr<GzipReader>(new StreamGzipReader(data, size, fd));
+}
@@ -0,0 +1,32 @@
+#ifndef NAUTY_DECOMPRESS_H
+#define NAUTY_DECOMPRESS_H
+
+// Internal gzip decoding for the line pipeline's reader. Not part of the C
+// API.
+
+#include <cstddef>
+#include <memory>
+#include <sys/types.h>
+
+// True if data starts with the gzip magic bytes, which no graph6, sparse6
+// or digraph6 text can.
+bool isGzip(const char* data, size_t size);
+
+// Decompressed bytes of a gzip stream, including concatenated members.
+class GzipReader {
+public:
+    virtual ~GzipReader() {}
+
+    // Up to max bytes into dst. Returns the count, 0 at the end, or -1 if
+    // the input cannot be read or is corrupt or truncated.
+    virtual ssize_t read(char* dst, size_t max) = 0;
+};
+
+// A reader over size bytes at data followed by the rest of fd, or over data
+// alone if fd is -1 (a mapped file). In memory, BGZF input (bgzip's output,
+// whose members each record their compressed size) is inflated a group of
+// members at a time on numThreads threads; anything else is inflated on
+// the calling thread as it is read.
+std::unique_ptr<GzipReader> openGzip(const char* data, size_t size, int fd, int numThreads);
+
+#endif // NAUTY_DECOMPRESS_H
@@ -0,0 +1,340 @@
+#include "nautyDedup.h"
+#include "nautyExternalSort.h"
+#include "nautyHashSet.h"
+#include "nautyPipeline.h"
+#include "nautySha256.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sys/stat.h>
+
+namespace {
+
+// Label one line, and record its hash key and the text to write if it
+// turns out to be new. With keyWords 0 no key is computed, and input
+// lines are not labelled at all.
+bool dedupLine(const char* line, size_t len, int outputMode, int hashFunction, int keyWords,
+               LabelScratch& scratch, LineBatch& batch) {
+    ParsedGraph parsed;
+    if (!parseGraphLine(line, len, scratch, parsed)) return false;
+
+    int m = parsed.m, n = parsed.n;
+    graph* canong = scratch.canong.data();
+    if (n > 0 && (keyWords > 0 || outputMode == NAUTY_DEDUP_CANONICAL)) {
+        canonicalLabel(scratch.g.data(), m, n, parsed.digraph, scratch.lab.data(), canong,
+                       nullptr);
+    }
+
+    uint64_t digest[4];
+    if (keyWords == 0) {
+        // Keys were found on an earlier pass.
+    } else if (hashFunction == NAUTY_HASH_SHA256) {
+        sha256(canong, (size_t)m * n * sizeof(graph), (uint8_t*)digest);
+    } else {
+        hashGraph(canong, m, n, parsed.digraph, digest);
+        if (keyWords > 2) hashGraph(canong, m, n, parsed.digraph, digest + 2, 1);
+    }
+    batch.keys.insert(batch.keys.end(), digest, digest + keyWords);
+
+    if (outputMode == NAUTY_DEDUP_HASH) {
+        batch.output.append((const char*)digest, keyWords * sizeof(uint64_t));
+    } else if (outputMode != NAUTY_DEDUP_COUNT) {
+        if (parsed.header) batch.output.append(parsed.header, parsed.headerLen);
+        if (outputMode == NAUTY_DEDUP_INPUT && parsed.text[0] == ';') {
+            // An incremental line means nothing without the lines kept before it.
+            appendGraph(parsed, scratch.g.data(), batch.output);
+        } else if (outputMode == NAUTY_DEDUP_INPUT) {
+            batch.output.append(parsed.text, parsed.textLen);
+            batch.output.push_back('\n');
+        } else {
+            appendGraph(parsed, canong, batch.output);
+        }
+    }
+    batch.outputEnds.push_back(batch.output.size());
+    return true;
+}
+
+// Validate the arguments shared by both dedup entry points.
+int64_t checkDedupArgs(int64_t outputMode, int64_t hashFunction, int64_t keyBits,
+                       const char*& outputPath) {
+    if (outputMode < NAUTY_DEDUP_CANONICAL || outputMode > NAUTY_DEDUP_COUNT) return -4;
+    if (keyBits != 128 && keyBits != 256) return -5;
+    if (hashFunction != NAUTY_HASH_FAST && hashFunction != NAUTY_HASH_SHA256) return -6;
+    if (!outputPath) {
+        if (outputMode != NAUTY_DEDUP_COUNT) return -2;
+        outputPath = "/dev/null";
+    }
+    return 0;
+}
+
+} // namespace
+
+extern "C" {
+
+int64_t nautyDedupStream(
+    const char* inputPath,
+    const char* outputPath,
+    int64_t outputMode,
+    int64_t hashFunction,
+    int64_t keyBits,
+    int64_t numThreads,
+    int64_t* graphsRead,
+    int64_t* graphsUnique
+) {
+    return nautyDedupShard(inputPath, outputPath, outputMode, hashFunction, keyBits, 0, 1,
+                           numThreads, graphsRead, graphsUnique);
+}
+
+int64_t nautyDedupShard(
+    const char* inputPath,
+    const char* outputPath,
+    int64_t outputMode,
+    int64_t hashFunction,
+    int64_t keyBits,
+    int64_t shardIndex,
+    int64_t numShards,
+    int64_t numThreads,
+    int64_t* graphsRead,
+    int64_t* graphsUnique
+) {
+    if (graphsRead) *graphsRead = 0;
+    if (graphsUnique) *graphsUnique = 0;
+    int64_t bad = checkDedupArgs(outputMode, hashFunction, keyBits, outputPath);
+    if (bad) return bad;
+    if (numShards < 1 || numShards > UINT32_MAX || shardIndex < 0 || shardIndex >= numShards) {
+        return -9;
+    }
+
+    int keyWords = (int)(keyBits / 64);
+    int mode = (int)outputMode;
+    int hash = (int)hashFunction;
+    ShardedHashSet seen(keyWords, resolveThreadCount(numThreads));
+
+    LineHandler handleLine = [mode, hash, keyWords](const char* line, size_t len,
+                                                    LabelScratch& scratch, LineBatch& batch) {
+        return dedupLine(line, len, mode, hash, keyWords, scratch, batch);
+    };
+
+    // Batches arrive in input order and are inserted across the shards in
+    // that order, so the first graph of each class wins. With several
+    // processes, keys outside this one's shard never reach the table.
+    std::string kept;
+    std::vector<uint8_t> isNew, keep;
+    std::vector<uint64_t> shardKeys;
+    std::vector<uint32_t> members;
+    BatchFilter keepNew = [&](LineBatch& batch) {
+        size_t count = batch.outputEnds.size();
+        keep.resize(count);
+        if (numShards == 1) {
+            seen.insertBatch(batch.keys.data(), count, keep.data());
+        } else {
+            shardKeys.clear();
+            members.clear();
+            for (size_t i = 0; i < count; i++) {
+                const uint64_t* key = &batch.keys[i * keyWords];
+                keep[i] = 0;
+                if (((uint64_t)(uint32_t)key[1] * numShards >> 32) != (uint64_t)shardIndex) {
+                    continue;
+                }
+                shardKeys.insert(shardKeys.end(), key, key + keyWords);
+                members.push_back((uint32_t)i);
+            }
+            isNew.resize(members.size());
+            seen.insertBatch(shardKeys.data(), members.size(), isNew.data());
+            for (size_t j = 0; j < members.size(); j++) keep[members[j]] = isNew[j];
+        }
+
+        kept.clear();
+        size_t start = 0;
+        for (size_t i = 0; i < count; i++) {
+            size_t end = batch.outputEnds[i];
+            if (keep[i]) kept.append(batch.output, start, end - start);
+            start = end;
+        }
+        batch.output.swap(kept);
+    };
+
+    int64_t ret = runLinePipeline(inputPath, outputPath, true, numThreads, handleLine,
+                                  keepNew, graphsRead);
+    if (graphsUnique) *graphsUnique = seen.size();
+    return ret;
+}
+
+int64_t nautyDedupMerge(
+    const char* const* shardPaths,
+    int64_t numPaths,
+    const char* outputPath,
+    int64_t outputMode
+) {
+    if (outputMode < NAUTY_DEDUP_CANONICAL || outputMode > NAUTY_DEDUP_COUNT) return -4;
+
+    // The first graph of the input carries the header, and is the first
+    // graph of whichever shard kept it. Find it before copying anything.
+    std::vector<FILE*> shards;
+    std::vector<size_t> skip(numPaths, 0);
+    std::string header;
+    auto closeShards = [&shards] {
+        for (FILE* f : shards) std::fclose(f);
+    };
+    for (int64_t i = 0; i < numPaths; i++) {
+        FILE* f = std::fopen(shardPaths[i], "rb");
+        if (!f) {
+            closeShards();
+            return -1;
+        }
+        shards.push_back(f);
+        if (outputMode == NAUTY_DEDUP_HASH) continue;
+        char start[64];
+        size_t got = std::fread(start, 1, sizeof(start), f);
+        std::rewind(f);
+        if (got >= 2 && start[0] == '>' && start[1] == '>') {
+            const char* close = (const char*)memmem(start, got, "<<", 2);
+            if (close && !std::memchr(start, '\n', close - start)) {
+                skip[i] = close + 2 - start;
+                if (header.empty()) header.assign(start, skip[i]);
+            }
+        }
+    }
+
+    bool toStdout = std::strcmp(outputPath, "-") == 0;
+    FILE* out = toStdout ? stdout : std::fopen(outputPath, "wb");
+    if (!out) {
+        closeShards();
+        return -2;
+    }
+    bool ok = std::fwrite(header.data(), 1, header.size(), out) == header.size();
+    bool readFailed = false;
+    std::vector<char> buf(1 << 20);
+    for (int64_t i = 0; i < numPaths && ok; i++) {
+        std::fseek(shards[i], (long)skip[i], SEEK_SET);
+        size_t got;
+        while (ok && (got = std::fread(buf.data(), 1, buf.size(), shards[i])) > 0) {
+            ok = std::fwrite(buf.data(), 1, got, out) == got;
+        }
+        if (std::ferror(shards[i])) readFailed = true;
+    }
+    closeShards();
+    ok = (toStdout ? std::fflush(out) : std::fclose(out)) == 0 && ok;
+    if (!ok) return -2;
+    return readFailed ? -1 : 0;
+}
+
+int64_t nautyDedupExternal(
+    const char* inputPath,
+    const char* outputPath,
+    int64_t outputMode,
+    int64_t hashFunction,
+    int64_t keyBits,
+    int64_t memoryBytes,
+    const char* tempDir,
+    int64_t numThreads,
+    int64_t* graphsRead,
+    int64_t* graphsUnique
+) {
+    if (graphsRead) *graphsRead = 0;
+    if (graphsUnique) *graphsUnique = 0;
+    int64_t bad = checkDedupArgs(outputMode, hashFunction, keyBits, outputPath);
+    if (bad) return bad;
+
+    int mode = (int)outputMode;
+    int hash = (int)hashFunction;
+    int keyWords = (int)(keyBits / 64);
+    bool graphOutput = mode == NAUTY_DEDUP_CANONICAL || mode == NAUTY_DEDUP_INPUT;
+    if (graphOutput) {
+        struct stat st;
+        if (std::strcmp(inputPath, "-") == 0) return -8;
+        if (::stat(inputPath, &st) != 0) return -1;
+        if (!S_ISREG(st.st_mode)) return -8;
+    }
+    std::string dir = tempDir ? tempDir : "";
+    if (dir.empty()) {
+        const char* env = std::getenv("TMPDIR");
+        dir = env && *env ? env : "/tmp";
+    }
+    size_t budget = memoryBytes > 0 ? (size_t)memoryBytes : (size_t)1 << 30;
+
+    // Pass 1: hash every graph and sort (key, index) records on disk, so
+    // the merge yields each key with the index of its first occurrence.
+    ExternalSorter byKey(keyWords + 1, keyWords, budget, dir);
+    LineHandler hashLine = [hash, keyWords](const char* line, size_t len,
+                                            LabelScratch& scratch, LineBatch& batch) {
+        return dedupLine(line, len, NAUTY_DEDUP_COUNT, hash, keyWords, scratch, batch);
+    };
+    int64_t index = 0;
+    std::vector<uint64_t> record(keyWords + 1);
+    BatchFilter spill = [&](LineBatch& batch) {
+        for (size_t i = 0; i < batch.outputEnds.size(); i++) {
+            std::memcpy(record.data(), &batch.keys[i * keyWords], keyWords * sizeof(uint64_t));
+            record[keyWords] = (uint64_t)index++;
+            byKey.add(record.data());
+        }
+        batch.output.clear();
+    };
+    int64_t read = 0;
+    int64_t ret = runLinePipeline(inputPath, "/dev/null", true, numThreads, hashLine, spill,
+                                  &read);
+    if (graphsRead) *graphsRead = read;
+    if (ret != 0) return ret;
+    if (!byKey.finish()) return -7;
+
+    // Re-sort the first occurrences by index to restore input order. Hash
+    // output carries its key along; graph output needs only the index.
+    int firstWords = mode == NAUTY_DEDUP_HASH ? keyWords + 1 : 1;
+    ExternalSorter byIndex(firstWords, 1, budget / 2, dir);
+    int64_t unique = 0;
+    const uint64_t* r;
+    while (byKey.next(r)) {
+        unique++;
+        if (mode == NAUTY_DEDUP_COUNT) continue;
+        record[0] = r[keyWords];
+        std::memcpy(record.data() + 1, r, (firstWords - 1) * sizeof(uint64_t));
+        if (!byIndex.add(record.data())) return -7;
+    }
+    if (byKey.failed() || !byIndex.finish()) return -7;
+    if (graphsUnique) *graphsUnique = unique;
+
+    if (mode == NAUTY_DEDUP_COUNT) {
+        return 0;
+    } else if (mode == NAUTY_DEDUP_HASH) {
+        bool toStdout = std::strcmp(outputPath, "-") == 0;
+        FILE* out = toStdout ? stdout : std::fopen(outputPath, "wb");
+        if (!out) return -2;
+        bool ok = true;
+        while (ok && byIndex.next(r)) {
+            ok = std::fwrite(r + 1, sizeof(uint64_t), keyWords, out) == (size_t)keyWords;
+        }
+        ok = (toStdout ? std::fflush(out) : std::fclose(out)) == 0 && ok;
+        if (!ok) return -2;
+        return byIndex.failed() ? -7 : 0;
+    }
+
+    // Pass 2: read the input again and keep the graphs at the first
+    // occurrence indices, which arrive in the same order as the batches.
+    LineHandler outputLine = [mode](const char* line, size_t len, LabelScratch& scratch,
+                                    LineBatch& batch) {
+        return dedupLine(line, len, mode, 0, 0, scratch, batch);
+    };
+    index = 0;
+    bool haveNext = byIndex.next(r);
+    int64_t nextIndex = haveNext ? (int64_t)r[0] : -1;
+    std::string kept;
+    BatchFilter keepFirst = [&](LineBatch& batch) {
+        kept.clear();
+        size_t start = 0;
+        for (size_t i = 0; i < batch.outputEnds.size(); i++, index++) {
+            size_t end = batch.outputEnds[i];
+            if (index == nextIndex) {
+                kept.append(batch.output, start, end - start);
+                nextIndex = byIndex.next(r) ? (int64_t)r[0] : -1;
+            }
+            start = end;
+        }
+        batch.output.swap(kept);
+    };
+    ret = runLinePipeline(inputPath, outputPath, true, numThreads, outputLine, keepFirst,
+                          nullptr);
+    if (ret != 0) return ret;
+    return byIndex.failed() ? -7 : 0;
+}
+
+} // extern "C"
@@ -0,0 +1,106 @@
+#include "nautyDedup.h"
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+static void usage() {
+    std::cerr << "Usage: nauty_dedup [-k|-H|-u] [-S] [-b#] [-T#] [-M# [-t dir]] [--shard i/N]\n"
+              << "                   [infile [outfile]]\n"
+              << "       nauty_dedup -m [-k|-H] outfile shardfile...\n"
+              << "  Remove isomorphs from graph6, sparse6 or digraph6 graphs in parallel.\n"
+              << "  -k   write the first graph of each class as read (default: canonical)\n"
+              << "  -H   write binary hashes of the classes instead of graphs\n"
+              << "  -u   write nothing, only count the classes\n"
+              << "  -S   hash with SHA-256, as uniqg (default: fast hash)\n"
+              << "  -b#  key bits, 128 or 256 (default: 128, or 256 with -S)\n"
+              << "  -T#  number of worker threads (default: all cores)\n"
+              << "  -M#  spill to disk, keeping # MiB of keys in memory\n"
+              << "  -t   directory for spilled runs (default: $TMPDIR or /tmp)\n"
+              << "  --shard i/N  keep only classes in shard i of N (0 <= i < N), for\n"
+              << "       splitting one file across N processes\n"
+              << "  -m   concatenate the outputs of all N shards into outfile\n";
+}
+
+int main(int argc, char* argv[]) {
+    int64_t mode = NAUTY_DEDUP_CANONICAL;
+    int64_t hash = NAUTY_HASH_FAST;
+    int64_t keyBits = 0;
+    int64_t threads = 0;
+    int64_t memoryMiB = 0;
+    const char* tempDir = nullptr;
+    int64_t shardIndex = 0, numShards = 1;
+    bool merge = false;
+    std::vector<const char*> files;
+
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "-k") == 0) {
+            mode = NAUTY_DEDUP_INPUT;
+        } else if (std::strcmp(argv[i], "-H") == 0) {
+            mode = NAUTY_DEDUP_HASH;
+        } else if (std::strcmp(argv[i], "-u") == 0) {
+            mode = NAUTY_DEDUP_COUNT;
+        } else if (std::strcmp(argv[i], "-S") == 0) {
+            hash = NAUTY_HASH_SHA256;
+        } else if (std::strncmp(argv[i], "-b", 2) == 0 && argv[i][2]) {
+            keyBits = std::atoll(argv[i] + 2);
+        } else if (std::strncmp(argv[i], "-T", 2) == 0 && argv[i][2]) {
+            threads = std::atoll(argv[i] + 2);
+        } else if (std::strncmp(argv[i], "-M", 2) == 0 && argv[i][2]) {
+            memoryMiB = std::atoll(argv[i] + 2);
+        } else if (std::strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+            tempDir = argv[++i];
+        } else if (std::strcmp(argv[i], "--shard") == 0 && i + 1 < argc) {
+            const char* slash = std::strchr(argv[++i], '/');
+            if (!slash) {
+                usage();
+                return 1;
+            }
+            shardIndex = std::atoll(argv[i]);
+            numShards = std::atoll(slash + 1);
+        } else if (std::strcmp(argv[i], "-m") == 0) {
+            merge = true;
+        } else if (argv[i][0] == '-' && argv[i][1]) {
+            usage();
+            return 1;
+        } else {
+            files.push_back(argv[i]);
+        }
+    }
+
+    if (merge) {
+        if (files.size() < 2 || mode == NAUTY_DEDUP_COUNT) {
+            usage();
+            return 1;
+        }
+        int64_t ret = nautyDedupMerge(files.data() + 1, files.size() - 1, files[0], mode);
+        if (ret != 0) {
+            std::cerr << "Error: nauty_dedup merge failed with code " << ret << std::endl;
+            return 1;
+        }
+        return 0;
+    }
+
+    if (files.size() > 2 || (memoryMiB > 0 && numShards > 1)) {
+        usage();
+        return 1;
+    }
+    const char* in = files.size() > 0 ? files[0] : "-";
+    const char* out = files.size() > 1 ? files[1] : "-";
+    if (keyBits == 0) keyBits = hash == NAUTY_HASH_SHA256 ? 256 : 128;
+
+    int64_t read = 0, unique = 0;
+    int64_t ret = memoryMiB > 0
+        ? nautyDedupExternal(in, out, mode, hash, keyBits, memoryMiB << 20, tempDir, threads,
+                             &read, &unique)
+        : nautyDedupShard(in, out, mode, hash, keyBits, shardIndex, numShards, threads, &read,
+                          &unique);
+    std::cerr << ">Z " << read << " graphs read, " << unique << " classes";
+    if (numShards > 1) std::cerr << " in shard " << shardIndex << "/" << numShards;
+    std::cerr << std::endl;
+    if (ret != 0) {
+        std::cerr << "Error: nauty_dedup failed with code " << ret << std::endl;
+        return 1;
+    }
+    return 0;
+}
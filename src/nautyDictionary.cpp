@@ -0,0 +1,304 @@
+#include "nautyDictionary.h"
+#include "nautyCore.h"
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <memory>
+#include <mutex>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+const char MAGIC[8] = {'N', 'A', 'U', 'T', 'Y', 'C', 'D', '\0'};
+const uint32_t VERSION = 1;
+const size_t HEADER_BYTES = 64;
+
+struct Entry {
+    uint64_t key;
+    uint64_t size;
+};
+
+bool validClass(uint64_t size, uint64_t key) {
+    if (size < 2 || size > MAX_PACKED_SIZE) return false;
+    return size * size == 64 || key >> (size * size) == 0;
+}
+
+// Holds the exclusive or shared flock on a file for a scope.
+class FileLock {
+public:
+    FileLock(int fd, int op) : fd(fd) {
+        while (::flock(fd, op) != 0 && errno == EINTR) {
+        }
+    }
+    ~FileLock() { ::flock(fd, LOCK_UN); }
+
+private:
+    int fd;
+};
+
+// One process's view of a dictionary file. Known classes are found without
+// locks: slots are published with a release store of their meta word
+// (motif size and id + 1), and a full table is replaced rather than
+// rehashed in place, the old one staying alive for readers still in it.
+// Everything that adds classes holds mutex and then the file lock.
+class ClassDictionary {
+public:
+    ClassDictionary(int fd) : fd(fd) {
+        for (auto& chunk : chunks) chunk.store(nullptr, std::memory_order_relaxed);
+        rebuild(1024);
+    }
+
+    ~ClassDictionary() {
+        ::fdatasync(fd);
+        ::close(fd);
+        for (auto& chunk : chunks) delete[] chunk.load(std::memory_order_relaxed);
+    }
+
+    // Id of a class, or -1 if this process has not seen it.
+    int64_t find(uint64_t size, uint64_t key) const {
+        const Table* t = table.load(std::memory_order_acquire);
+        for (size_t i = slotFor(size, key, t->mask);; i = (i + 1) & t->mask) {
+            uint64_t meta = t->slots[i].meta.load(std::memory_order_acquire);
+            if (meta == 0) return -1;
+            if (meta >> 56 == size && t->slots[i].key.load(std::memory_order_relaxed) == key) {
+                return (int64_t)(meta & ID_MASK) - 1;
+            }
+        }
+    }
+
+    // Id of a class, reading entries other processes appended if it is not
+    // known yet, and appending it if add is set; added says whether this
+    // call did. -1 if absent, -2 if the file cannot be written.
+    int64_t lookup(uint64_t size, uint64_t key, bool add, bool& added) {
+        added = false;
+        int64_t id = find(size, key);
+        if (id >= 0) return id;
+        std::lock_guard<std::mutex> lock(mutex);
+        FileLock fileLock(fd, add ? LOCK_EX : LOCK_SH);
+        if (!sync()) return -2;
+        id = find(size, key);
+        if (id >= 0 || !add) return id;
+
+        Entry e = {key, size};
+        off_t offset = HEADER_BYTES + (off_t)count() * sizeof(Entry);
+        if (::pwrite(fd, &e, sizeof(e), offset) != (ssize_t)sizeof(e)) return -2;
+        added = true;
+        return insert(e);
+    }
+
+    bool entry(int64_t id, Entry& e) {
+        if (id < 0) return false;
+        if ((uint64_t)id >= count()) {
+            std::lock_guard<std::mutex> lock(mutex);
+            FileLock fileLock(fd, LOCK_SH);
+            if (!sync() || (uint64_t)id >= count()) return false;
+        }
+        e = chunks[id / CHUNK_ENTRIES].load(std::memory_order_acquire)[id % CHUNK_ENTRIES];
+        return true;
+    }
+
+    uint64_t count() const { return published.load(std::memory_order_acquire); }
+
+    // Read entries appended to the file since the last sync. Called with
+    // mutex and the file lock held.
+    bool sync() {
+        struct stat st;
+        if (::fstat(fd, &st) != 0) return false;
+        uint64_t total = ((uint64_t)st.st_size - HEADER_BYTES) / sizeof(Entry);
+        uint64_t known = count();
+        if (total <= known) return true;
+
+        size_t bytes = (total - known) * sizeof(Entry);
+        off_t start = HEADER_BYTES + known * sizeof(Entry);
+        off_t page = start & ~(off_t)(::sysconf(_SC_PAGESIZE) - 1);
+        void* map = ::mmap(nullptr, bytes + (start - page), PROT_READ, MAP_SHARED, fd, page);
+        if (map == MAP_FAILED) return false;
+        const Entry* entries = (const Entry*)((const char*)map + (start - page));
+        bool ok = true;
+        for (uint64_t i = 0; i < total - known && ok; i++) {
+            ok = validClass(entries[i].size, entries[i].key);
+            if (ok) insert(entries[i]);
+        }
+        ::munmap(map, bytes + (start - page));
+        return ok;
+    }
+
+private:
+    static const uint64_t ID_MASK = (1ULL << 56) - 1;
+    static const size_t CHUNK_ENTRIES = 1 << 16;
+    static const size_t MAX_CHUNKS = 1 << 16;
+
+    struct Slot {
+        std::atomic<uint64_t> key{0};
+        std::atomic<uint64_t> meta{0};
+    };
+
+    struct Table {
+        explicit Table(size_t capacity) : mask(capacity - 1), slots(new Slot[capacity]) {}
+        size_t mask;
+        std::unique_ptr<Slot[]> slots;
+    };
+
+    static size_t slotFor(uint64_t size, uint64_t key, size_t mask) {
+        return mix64(key ^ size * 0x9e3779b97f4a7c15ULL) & mask;
+    }
+
+    // Place class id in t; the slot becomes visible with its meta word.
+    static void place(Table& t, const Entry& e, uint64_t id) {
+        size_t i = slotFor(e.size, e.key, t.mask);
+        while (t.slots[i].meta.load(std::memory_order_relaxed) != 0) i = (i + 1) & t.mask;
+        t.slots[i].key.store(e.key, std::memory_order_relaxed);
+        t.slots[i].meta.store(e.size << 56 | (id + 1), std::memory_order_release);
+    }
+
+    // Give the next id to e. Called with mutex held.
+    int64_t insert(const Entry& e) {
+        uint64_t id = count();
+        if (id >= CHUNK_ENTRIES * MAX_CHUNKS) return -2;
+        std::atomic<Entry*>& chunk = chunks[id / CHUNK_ENTRIES];
+        if (!chunk.load(std::memory_order_relaxed)) {
+            chunk.store(new Entry[CHUNK_ENTRIES], std::memory_order_release);
+        }
+        chunk.load(std::memory_order_relaxed)[id % CHUNK_ENTRIES] = e;
+        if ((id + 1) * 2 > tables.back()->mask + 1) rebuild(2 * (tables.back()->mask + 1));
+        place(*tables.back(), e, id);
+        published.store(id + 1, std::memory_order_release);
+        return (int64_t)id;
+    }
+
+    // Switch to a fresh table of the given capacity holding every class.
+    void rebuild(size_t capacity) {
+        tables.emplace_back(new Table(capacity));
+        Table& t = *tables.back();
+        uint64_t known = count();
+        for (uint64_t id = 0; id < known; id++) {
+            place(t, chunks[id / CHUNK_ENTRIES].load(std::memory_order_relaxed)[id % CHUNK_ENTRIES],
+                  id);
+        }
+        table.store(&t, std::memory_order_release);
+    }
+
+    int fd;
+    std::mutex mutex;
+    std::atomic<const Table*> table{nullptr};
+    std::vector<std::unique_ptr<Table>> tables;
+    std::atomic<Entry*> chunks[MAX_CHUNKS];
+    std::atomic<uint64_t> published{0};
+};
+
+std::mutex dictionaries_mutex;
+std::unordered_map<int64_t, std::shared_ptr<ClassDictionary>> dictionaries;
+int64_t next_dictionary_id = 0;
+
+std::shared_ptr<ClassDictionary> lookupDictionary(int64_t dictId) {
+    std::lock_guard<std::mutex> lock(dictionaries_mutex);
+    auto it = dictionaries.find(dictId);
+    return it == dictionaries.end() ? nullptr : it->second;
+}
+
+} // namespace
+
+extern "C" {
+
+int64_t nautyDictionaryOpen(const char* path) {
+    int fd = ::open(path, O_RDWR | O_CREAT, 0644);
+    if (fd < 0) return -1;
+
+    // The first process to lock an empty file writes the header.
+    {
+        FileLock lock(fd, LOCK_EX);
+        struct stat st;
+        char header[HEADER_BYTES];
+        bool ok = ::fstat(fd, &st) == 0;
+        if (ok && st.st_size == 0) {
+            std::memset(header, 0, sizeof(header));
+            std::memcpy(header, MAGIC, sizeof(MAGIC));
+            std::memcpy(header + 8, &VERSION, sizeof(VERSION));
+            ok = ::pwrite(fd, header, sizeof(header), 0) == (ssize_t)sizeof(header);
+        } else if (ok) {
+            uint32_t version;
+            ok = ::pread(fd, header, sizeof(header), 0) == (ssize_t)sizeof(header);
+            std::memcpy(&version, header + 8, sizeof(version));
+            ok = ok && std::memcmp(header, MAGIC, sizeof(MAGIC)) == 0 && version == VERSION;
+        }
+        if (!ok) {
+            ::close(fd);
+            return -2;
+        }
+    }
+
+    auto dict = std::make_shared<ClassDictionary>(fd);
+    {
+        FileLock lock(fd, LOCK_SH);
+        if (!dict->sync()) return -2;
+    }
+    std::lock_guard<std::mutex> lock(dictionaries_mutex);
+    int64_t id = next_dictionary_id++;
+    dictionaries[id] = dict;
+    return id;
+}
+
+int64_t nautyDictionaryClose(int64_t dictId) {
+    std::lock_guard<std::mutex> lock(dictionaries_mutex);
+    return dictionaries.erase(dictId) ? 0 : -1;
+}
+
+int64_t nautyDictionarySize(int64_t dictId) {
+    std::shared_ptr<ClassDictionary> dict = lookupDictionary(dictId);
+    return dict ? (int64_t)dict->count() : -1;
+}
+
+int64_t nautyDictionaryIds(
+    int64_t dictId,
+    int64_t motifSize,
+    const int64_t classKeys[],
+    int64_t count,
+    int64_t classIds[]
+) {
+    std::shared_ptr<ClassDictionary> dict = lookupDictionary(dictId);
+    if (!dict) return -1;
+    for (int64_t i = 0; i < count; i++) {
+        if (!validClass(motifSize, classKeys[i])) return -2;
+    }
+    int64_t added = 0;
+    for (int64_t i = 0; i < count; i++) {
+        bool appended;
+        int64_t id = dict->lookup(motifSize, classKeys[i], true, appended);
+        if (id < 0) return -3;
+        added += appended;
+        classIds[i] = id;
+    }
+    return added;
+}
+
+int64_t nautyDictionaryFind(int64_t dictId, int64_t motifSize, int64_t classKey) {
+    std::shared_ptr<ClassDictionary> dict = lookupDictionary(dictId);
+    if (!dict) return -1;
+    if (!validClass(motifSize, classKey)) return -2;
+    bool appended;
+    int64_t id = dict->lookup(motifSize, classKey, false, appended);
+    return id >= 0 ? id : -3;
+}
+
+int64_t nautyDictionaryClass(
+    int64_t dictId,
+    int64_t classId,
+    int64_t* motifSize,
+    int64_t* classKey
+) {
+    std::shared_ptr<ClassDictionary> dict = lookupDictionary(dictId);
+    if (!dict) return -1;
+    Entry e;
+    if (!dict->entry(classId, e)) return -2;
+    *motifSize = (int64_t)e.size;
+    *classKey = (int64_t)e.key;
+    return 0;
+}
+
+} // extern "C"
@@ -0,0 +1,310 @@
+#include "nautyExternalSort.h"
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+const size_t MAX_WORDS = 5;
+const size_t MAX_READ_BLOCK = 1 << 20;
+const size_t MIN_READ_BLOCK = 64 << 10;
+// Descriptors left for the rest of the process when sizing the fan-in.
+const size_t RESERVED_FDS = 64;
+
+template <size_t W>
+void sortFixed(uint64_t* data, size_t count) {
+    auto* records = reinterpret_cast<std::array<uint64_t, W>*>(data);
+    std::sort(records, records + count);
+}
+
+void sortRecords(uint64_t* data, size_t count, int words) {
+    switch (words) {
+    case 1: sortFixed<1>(data, count); break;
+    case 2: sortFixed<2>(data, count); break;
+    case 3: sortFixed<3>(data, count); break;
+    case 4: sortFixed<4>(data, count); break;
+    case 5: sortFixed<5>(data, count); break;
+    }
+}
+
+bool lessRecord(const uint64_t* a, const uint64_t* b, int words) {
+    for (int i = 0; i < words; i++) {
+        if (a[i] != b[i]) return a[i] < b[i];
+    }
+    return false;
+}
+
+bool sameKey(const uint64_t* a, const uint64_t* b, int keyWords) {
+    return std::memcmp(a, b, keyWords * sizeof(uint64_t)) == 0;
+}
+
+bool writeAll(int fd, const void* data, size_t size) {
+    const char* p = (const char*)data;
+    while (size > 0) {
+        ssize_t put = ::write(fd, p, size);
+        if (put < 0 && errno == EINTR) continue;
+        if (put <= 0) return false;
+        p += put;
+        size -= put;
+    }
+    return true;
+}
+
+} // namespace
+
+// Sequential reader over one run, a block at a time. After each block is
+// read the kernel is asked to fetch the next one, so the disk works ahead
+// of the merge.
+class RunReader {
+public:
+    RunReader(int fd, int words, size_t blockBytes) : fd(fd), words(words) {
+        struct stat st;
+        size = ::fstat(fd, &st) == 0 ? (size_t)st.st_size : 0;
+        size_t recordBytes = words * sizeof(uint64_t);
+        block.resize(std::max<size_t>(1, blockBytes / recordBytes) * words);
+        ::posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    }
+
+    // Load the first block; false if the run is empty or unreadable.
+    bool start() { return refill(); }
+
+    const uint64_t* current() const { return block.data() + pos; }
+
+    // Step to the next record; false at the end of the run or on error.
+    bool advance() {
+        pos += words;
+        return pos < filled || refill();
+    }
+
+    bool error = false;
+
+private:
+    bool refill() {
+        if (offset >= size) return false;
+        size_t want = std::min(block.size() * sizeof(uint64_t), size - offset);
+        size_t got = 0;
+        while (got < want) {
+            ssize_t r = ::pread(fd, (char*)block.data() + got, want - got, offset + got);
+            if (r < 0 && errno == EINTR) continue;
+            if (r <= 0) {
+                error = true;
+                return false;
+            }
+            got += r;
+        }
+        offset += got;
+        filled = got / sizeof(uint64_t);
+        pos = 0;
+        if (offset < size) ::posix_fadvise(fd, offset, want, POSIX_FADV_WILLNEED);
+        return filled > 0;
+    }
+
+    int fd;
+    int words;
+    size_t size = 0;
+    size_t offset = 0;
+    std::vector<uint64_t> block;
+    size_t filled = 0;
+    size_t pos = 0;
+};
+
+// Merges runs into one sorted stream, yielding the smallest record of each
+// key (the first keyWords words).
+class RunMerger {
+public:
+    RunMerger(int words, int keyWords) : words(words), keyWords(keyWords), last(words) {}
+
+    // Start reading the runs, each through a block of blockBytes.
+    bool open(const std::vector<int>& fds, size_t blockBytes) {
+        for (int fd : fds) {
+            readers.emplace_back(new RunReader(fd, words, blockBytes));
+            if (readers.back()->start()) heap.push_back(readers.back().get());
+            if (readers.back()->error) error = true;
+        }
+        std::make_heap(heap.begin(), heap.end(), Greater{words});
+        return !error;
+    }
+
+    bool next(const uint64_t*& record) {
+        Greater greater{words};
+        while (!heap.empty() && !error) {
+            std::pop_heap(heap.begin(), heap.end(), greater);
+            RunReader* top = heap.back();
+            bool fresh = !haveLast || !sameKey(top->current(), last.data(), keyWords);
+            if (fresh) std::memcpy(last.data(), top->current(), words * sizeof(uint64_t));
+            if (top->advance()) {
+                std::push_heap(heap.begin(), heap.end(), greater);
+            } else {
+                heap.pop_back();
+                if (top->error) error = true;
+            }
+            if (fresh) {
+                haveLast = true;
+                record = last.data();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool error = false;
+
+private:
+    struct Greater {
+        int words;
+        bool operator()(RunReader* a, RunReader* b) const {
+            return lessRecord(b->current(), a->current(), words);
+        }
+    };
+
+    int words;
+    int keyWords;
+    // A min-heap of run readers and the last key emitted.
+    std::vector<std::unique_ptr<RunReader>> readers;
+    std::vector<RunReader*> heap;
+    std::vector<uint64_t> last;
+    bool haveLast = false;
+};
+
+ExternalSorter::ExternalSorter(int words, int keyWords, size_t memoryBytes,
+                               const std::string& tempDir)
+    : words(words), keyWords(keyWords), budgetBytes(memoryBytes), dir(tempDir) {
+    capacity = std::max<size_t>(1, memoryBytes / (words * sizeof(uint64_t)));
+    if (words < 1 || (size_t)words > MAX_WORDS) error = true;
+
+    // One read block per merged run, plus one to write through when the
+    // merge produces a run; half the free descriptors, as a dedup keeps two
+    // sorters open at once.
+    size_t blocks = memoryBytes / MIN_READ_BLOCK;
+    maxFanIn = blocks > 1 ? blocks - 1 : 2;
+    struct rlimit lim;
+    if (::getrlimit(RLIMIT_NOFILE, &lim) == 0 && lim.rlim_cur != RLIM_INFINITY) {
+        size_t fds = lim.rlim_cur > RESERVED_FDS ? (lim.rlim_cur - RESERVED_FDS) / 2 : 0;
+        maxFanIn = std::min(maxFanIn, fds);
+    }
+    maxFanIn = std::max<size_t>(2, maxFanIn);
+}
+
+ExternalSorter::~ExternalSorter() {
+    for (const Run& run : runs) ::close(run.fd);
+}
+
+bool ExternalSorter::add(const uint64_t* record) {
+    if (error) return false;
+    if (buffer.size() / words >= capacity && !spill()) return false;
+    buffer.insert(buffer.end(), record, record + words);
+    return true;
+}
+
+// Open an unlinked temporary file and add it to the runs.
+bool ExternalSorter::newRun(int generation, int& fd) {
+    std::string path = dir + "/nautyRunXXXXXX";
+    fd = ::mkstemp(&path[0]);
+    if (fd < 0) {
+        error = true;
+        return false;
+    }
+    ::unlink(path.c_str());
+    runs.push_back({fd, generation});
+    return true;
+}
+
+// Sort the buffer, keep the smallest record of each key and write it out.
+bool ExternalSorter::spill() {
+    if (buffer.empty()) return true;
+    size_t count = buffer.size() / words;
+    sortRecords(buffer.data(), count, words);
+
+    size_t kept = 0;
+    for (size_t i = 0; i < count; i++) {
+        const uint64_t* r = buffer.data() + i * words;
+        if (kept > 0 && sameKey(r, buffer.data() + (kept - 1) * words, keyWords)) continue;
+        if (kept != i) std::memmove(buffer.data() + kept * words, r, words * sizeof(uint64_t));
+        kept++;
+    }
+
+    int fd;
+    if (!newRun(0, fd) || !writeAll(fd, buffer.data(), kept * words * sizeof(uint64_t))) {
+        error = true;
+        return false;
+    }
+    buffer.clear();
+    spilled++;
+
+    // Runs are kept in non-increasing generation, so the last fanIn share
+    // one if the first and last of them do.
+    while (runs.size() >= maxFanIn &&
+           runs[runs.size() - maxFanIn].generation == runs.back().generation) {
+        // The buffer is empty; give its memory to the merge.
+        std::vector<uint64_t>().swap(buffer);
+        if (!mergeTail(maxFanIn)) return false;
+    }
+    return true;
+}
+
+// Merge the last count runs into one run of the next generation.
+bool ExternalSorter::mergeTail(size_t count) {
+    std::vector<int> fds;
+    int generation = 0;
+    for (size_t i = runs.size() - count; i < runs.size(); i++) {
+        fds.push_back(runs[i].fd);
+        generation = std::max(generation, runs[i].generation + 1);
+    }
+    size_t blockBytes = budgetBytes / (count + 1);
+    blockBytes = std::max(MIN_READ_BLOCK, std::min(MAX_READ_BLOCK, blockBytes));
+
+    RunMerger merge(words, keyWords);
+    int fd;
+    bool ok = merge.open(fds, blockBytes) && newRun(generation, fd);
+    std::vector<uint64_t> out;
+    out.reserve(blockBytes / sizeof(uint64_t) + words);
+    const uint64_t* record;
+    while (ok && merge.next(record)) {
+        out.insert(out.end(), record, record + words);
+        if (out.size() * sizeof(uint64_t) >= blockBytes) {
+            ok = writeAll(fd, out.data(), out.size() * sizeof(uint64_t));
+            out.clear();
+        }
+    }
+    ok = ok && !merge.error && writeAll(fd, out.data(), out.size() * sizeof(uint64_t));
+    if (!ok) {
+        error = true;
+        return false;
+    }
+
+    // Drop the merged runs; the new one is last.
+    Run merged = runs.back();
+    for (int old : fds) ::close(old);
+    runs.resize(runs.size() - count - 1);
+    runs.push_back(merged);
+    return true;
+}
+
+bool ExternalSorter::finish() {
+    if (error || !spill()) return false;
+    std::vector<uint64_t>().swap(buffer);
+    while (runs.size() > maxFanIn) {
+        if (!mergeTail(std::min(maxFanIn, runs.size() - maxFanIn + 1))) return false;
+    }
+
+    size_t blockBytes = budgetBytes / std::max<size_t>(1, runs.size());
+    blockBytes = std::max(MIN_READ_BLOCK, std::min(MAX_READ_BLOCK, blockBytes));
+    std::vector<int> fds;
+    for (const Run& run : runs) fds.push_back(run.fd);
+    merger.reset(new RunMerger(words, keyWords));
+    if (!merger->open(fds, blockBytes)) error = true;
+    return !error;
+}
+
+bool ExternalSorter::next(const uint64_t*& record) {
+    if (!merger || error) return false;
+    if (merger->next(record)) return true;
+    if (merger->error) error = true;
+    return false;
+}
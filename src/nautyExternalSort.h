@@ -0,0 +1,72 @@
+#ifndef NAUTY_EXTERNAL_SORT_H
+#define NAUTY_EXTERNAL_SORT_H
+
+// Internal external-memory sort of fixed-width records, for deduplication
+// beyond RAM. Not part of the C API.
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+class RunMerger;
+
+// Collects records of `words` 64-bit words, compared lexicographically,
+// within a memory budget. When the buffer is full it is sorted, reduced to
+// the smallest record per key (the first keyWords words) and spilled as a
+// run to an unlinked temporary file, so nothing is left behind.
+//
+// At most fanIn() runs are merged at once, so the merge's read blocks fit
+// the budget and its open runs fit the descriptor limit. Whenever fanIn()
+// runs of the same generation are on disk they are merged into one run of
+// the next, and finish() merges the smallest runs until fanIn() are left.
+class ExternalSorter {
+public:
+    ExternalSorter(int words, int keyWords, size_t memoryBytes, const std::string& tempDir);
+    ~ExternalSorter();
+    ExternalSorter(const ExternalSorter&) = delete;
+    ExternalSorter& operator=(const ExternalSorter&) = delete;
+
+    // Returns false if a run cannot be written.
+    bool add(const uint64_t* record);
+
+    // Spill what is buffered and prepare to merge. After this, next()
+    // yields the smallest record of each distinct key in sorted order.
+    bool finish();
+    // Returns false when the records are exhausted or on a read error.
+    bool next(const uint64_t*& record);
+
+    bool failed() const { return error; }
+    // Runs spilled from the buffer, and runs on disk after merging.
+    size_t runCount() const { return spilled; }
+    size_t liveRunCount() const { return runs.size(); }
+    size_t fanIn() const { return maxFanIn; }
+
+private:
+    // A run's file and how many merges produced it (0 for a spilled run).
+    struct Run {
+        int fd;
+        int generation;
+    };
+
+    bool spill();
+    bool newRun(int generation, int& fd);
+    bool mergeTail(size_t count);
+
+    int words;
+    int keyWords;
+    size_t budgetBytes;
+    std::string dir;
+    std::vector<uint64_t> buffer;
+    size_t capacity;
+    size_t maxFanIn;
+    std::vector<Run> runs;
+    size_t spilled = 0;
+    bool error = false;
+
+    // The final merge, set up by finish().
+    std::unique_ptr<RunMerger> merger;
+};
+
+#endif // NAUTY_EXTERNAL_SORT_H
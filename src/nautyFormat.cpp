@@ -0,0 +1,136 @@
+#include "nautyFormat.h"
+#include "nautyCore.h"
+#include <gtools.h>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define NAUTY_FORMAT_X86 1
+#endif
+
+static_assert(WORDSIZE <= 64, "row extraction reads at most 64 bits at a time");
+
+void findLineEnds(const char* data, size_t size, std::vector<size_t>& ends) {
+    ends.clear();
+    size_t i = 0;
+#ifdef __SSE2__
+    const __m128i newline = _mm_set1_epi8('\n');
+    for (; i + 16 <= size; i += 16) {
+        __m128i chunk = _mm_loadu_si128((const __m128i*)(data + i));
+        unsigned mask = _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, newline));
+        while (mask) {
+            ends.push_back(i + __builtin_ctz(mask) + 1);
+            mask &= mask - 1;
+        }
+    }
+#endif
+    for (; i < size; i++) {
+        if (data[i] == '\n') ends.push_back(i + 1);
+    }
+    if (ends.empty() ? size > 0 : ends.back() != size) ends.push_back(size);
+}
+
+size_t unpackedSize(size_t len) {
+    return (len + 3) / 4 * 3 + 32;
+}
+
+// Four characters, four 6-bit values a b c d, become the bytes of
+// a<<18 | b<<12 | c<<6 | d, most significant first.
+static size_t unpackScalar(const char* s, size_t len, uint8_t* out) {
+    size_t i = 0;
+    for (; i + 4 <= len; i += 4, out += 3) {
+        uint32_t v = (uint32_t)(s[i] - BIAS6) << 18 | (uint32_t)(s[i + 1] - BIAS6) << 12 |
+                     (uint32_t)(s[i + 2] - BIAS6) << 6 | (uint32_t)(s[i + 3] - BIAS6);
+        out[0] = v >> 16;
+        out[1] = v >> 8;
+        out[2] = v;
+    }
+    return i;
+}
+
+#ifdef NAUTY_FORMAT_X86
+// Sixteen characters at a time: multiply-add pairs of 6-bit values into 12
+// bits, then pairs of those into 24 bits, and shuffle the three low bytes of
+// each lane into big-endian order.
+__attribute__((target("ssse3")))
+static size_t unpackSsse3(const char* s, size_t len, uint8_t* out) {
+    const __m128i bias = _mm_set1_epi8(BIAS6);
+    const __m128i pairs = _mm_set1_epi32(0x01400140);
+    const __m128i quads = _mm_set1_epi32(0x00011000);
+    const __m128i order = _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12,
+                                        -1, -1, -1, -1);
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16, out += 12) {
+        __m128i v = _mm_sub_epi8(_mm_loadu_si128((const __m128i*)(s + i)), bias);
+        v = _mm_madd_epi16(_mm_maddubs_epi16(v, pairs), quads);
+        _mm_storeu_si128((__m128i*)out, _mm_shuffle_epi8(v, order));
+    }
+    return i;
+}
+
+static bool detectSsse3() {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("ssse3");
+}
+
+static const bool haveSsse3 = detectSsse3();
+#endif
+
+void unpackSixBit(const char* s, size_t len, uint8_t* out) {
+    size_t done = 0;
+#ifdef NAUTY_FORMAT_X86
+    if (haveSsse3) done = unpackSsse3(s, len, out);
+#endif
+    done += unpackScalar(s + done, len - done, out + done / 4 * 3);
+
+    // Pad the last partial group with zero bits.
+    char tail[4] = {BIAS6, BIAS6, BIAS6, BIAS6};
+    std::memcpy(tail, s + done, len - done);
+    unpackScalar(tail, 4, out + done / 4 * 3);
+    std::memset(out + done / 4 * 3 + 3, 0, 16);
+}
+
+// 64 bits of the stream starting at bit pos, first bit most significant.
+static inline uint64_t readBits(const uint8_t* bits, size_t pos) {
+    const uint8_t* p = bits + (pos >> 3);
+    uint64_t w;
+    std::memcpy(&w, p, 8);
+    w = __builtin_bswap64(w);
+    unsigned shift = pos & 7;
+    if (shift) w = (w << shift) | (p[8] >> (8 - shift));
+    return w;
+}
+
+// Copy count stream bits from pos into the first count elements of row.
+static inline void copyBits(const uint8_t* bits, size_t pos, int count, set* row) {
+    for (int w = 0; w * WORDSIZE < count; w++) {
+        setword v = (setword)(readBits(bits, pos + (size_t)w * WORDSIZE) >> (64 - WORDSIZE));
+        int left = count - w * WORDSIZE;
+        if (left < WORDSIZE) v &= ALLMASK(left);
+        row[w] = v;
+    }
+}
+
+void graph6Rows(const uint8_t* bits, int m, int n, graph* g) {
+    std::memset(g, 0, sizeof(graph) * m * (size_t)n);
+
+    // Column j of the upper triangle is the lower part of row j; mirror each
+    // of its bits into the rows above. Row j has no other bits set yet.
+    for (int j = 1; j < n; j++) {
+        set* gj = GRAPHROW(g, j, m);
+        copyBits(bits, (size_t)j * (j - 1) / 2, j, gj);
+        for (int w = 0; w <= SETWD(j - 1); w++) {
+            setword x = gj[w];
+            while (x) {
+                int b;
+                TAKEBIT(b, x);
+                ADDELEMENT(GRAPHROW(g, w * WORDSIZE + b, m), j);
+            }
+        }
+    }
+}
+
+void digraph6Rows(const uint8_t* bits, int m, int n, graph* g) {
+    std::memset(g, 0, sizeof(graph) * m * (size_t)n);
+    for (int i = 0; i < n; i++) copyBits(bits, (size_t)i * n, n, GRAPHROW(g, i, m));
+}
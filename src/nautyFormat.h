@@ -0,0 +1,27 @@
+#ifndef NAUTY_FORMAT_H
+#define NAUTY_FORMAT_H
+
+// Internal decoders for graph6/digraph6 text, used in place of gtools'
+// stringtograph on hot paths. Not part of the C API.
+
+#include <nauty.h>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Offsets one past each '\n' in [data, data + size), found 16 bytes at a
+// time. A final line without a newline ends at size.
+void findLineEnds(const char* data, size_t size, std::vector<size_t>& ends);
+
+// Unpack len 6-bit characters (BIAS6-offset) into a big-endian bit stream,
+// 3 bytes per 4 characters. out needs unpackedSize(len) bytes, which
+// includes slack for whole-vector stores and unaligned reads past the end.
+size_t unpackedSize(size_t len);
+void unpackSixBit(const char* s, size_t len, uint8_t* out);
+
+// Fill g (n rows of m setwords) from the unpacked body of a graph6 or
+// digraph6 string. The result is identical to stringtograph.
+void graph6Rows(const uint8_t* bits, int m, int n, graph* g);
+void digraph6Rows(const uint8_t* bits, int m, int n, graph* g);
+
+#endif // NAUTY_FORMAT_H
@@ -0,0 +1,174 @@
+#include "nautyHashSet.h"
+#include <algorithm>
+#include <cstring>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+const uint8_t FlatHashSet::EMPTY;
+
+FlatHashSet::FlatHashSet(int keyWords) : words(keyWords) {}
+
+const uint64_t* FlatHashSet::key(size_t i) const {
+    return arena[i / CHUNK_KEYS].get() + (i % CHUNK_KEYS) * words;
+}
+
+size_t FlatHashSet::find(const uint64_t* key, bool& found) const {
+    // Keys are hashes: the low bits pick the group, the top 7 bits are the tag.
+    uint8_t tag = key[0] >> 57;
+    size_t group = key[0] & groupMask;
+
+    // Triangular probing visits every group of a power-of-two table.
+    for (size_t step = 1;; step++) {
+        const uint8_t* ctrl = control.data() + group * GROUP;
+        uint32_t match = 0, empty = 0;
+#ifdef __SSE2__
+        __m128i c = _mm_loadu_si128((const __m128i*)ctrl);
+        match = _mm_movemask_epi8(_mm_cmpeq_epi8(c, _mm_set1_epi8((char)tag)));
+        empty = _mm_movemask_epi8(_mm_cmpeq_epi8(c, _mm_set1_epi8((char)EMPTY)));
+#else
+        for (int i = 0; i < GROUP; i++) {
+            match |= (uint32_t)(ctrl[i] == tag) << i;
+            empty |= (uint32_t)(ctrl[i] == EMPTY) << i;
+        }
+#endif
+        while (match) {
+            size_t slot = group * GROUP + __builtin_ctz(match);
+            if (std::memcmp(this->key(slots[slot]), key, words * sizeof(uint64_t)) == 0) {
+                found = true;
+                return slot;
+            }
+            match &= match - 1;
+        }
+        if (empty) {
+            found = false;
+            return group * GROUP + __builtin_ctz(empty);
+        }
+        group = (group + step) & groupMask;
+    }
+}
+
+bool FlatHashSet::insert(const uint64_t* key) {
+    if ((count + 1) * 8 > slots.size() * 7) grow();
+
+    bool found;
+    size_t slot = find(key, found);
+    if (found) return false;
+
+    if (count == arena.size() * CHUNK_KEYS) {
+        arena.emplace_back(new uint64_t[CHUNK_KEYS * words]);
+    }
+    std::memcpy(arena.back().get() + (count % CHUNK_KEYS) * words, key,
+                words * sizeof(uint64_t));
+    control[slot] = key[0] >> 57;
+    slots[slot] = (uint32_t)count;
+    count++;
+    return true;
+}
+
+bool FlatHashSet::contains(const uint64_t* key) const {
+    if (count == 0) return false;
+    bool found;
+    find(key, found);
+    return found;
+}
+
+// Double the table and re-place every key from the arena; keys are their
+// own hashes, so nothing is recomputed.
+void FlatHashSet::grow() {
+    size_t capacity = slots.empty() ? 1024 : 2 * slots.size();
+    control.assign(capacity, EMPTY);
+    slots.assign(capacity, 0);
+    groupMask = capacity / GROUP - 1;
+
+    for (size_t i = 0; i < count; i++) {
+        const uint64_t* k = key(i);
+        bool found;
+        size_t slot = find(k, found);
+        control[slot] = k[0] >> 57;
+        slots[slot] = (uint32_t)i;
+    }
+}
+
+size_t FlatHashSet::memoryBytes() const {
+    return control.capacity() + slots.capacity() * sizeof(uint32_t) +
+           arena.size() * CHUNK_KEYS * words * sizeof(uint64_t);
+}
+
+void FlatHashSet::clear() {
+    count = 0;
+    groupMask = 0;
+    std::vector<uint8_t>().swap(control);
+    std::vector<uint32_t>().swap(slots);
+    arena.clear();
+}
+
+ShardedHashSet::ShardedHashSet(int keyWords, int numShards) : words(keyWords) {
+    while ((2 << shardBits) <= numShards) shardBits++;
+    for (int i = 0; i < (1 << shardBits); i++) {
+        shards.emplace_back(new Shard(keyWords));
+    }
+    if (shards.size() > 1) {
+        for (auto& shard : shards) {
+            Shard* s = shard.get();
+            s->thread = std::thread([this, s] { runShard(*s); });
+        }
+    }
+}
+
+ShardedHashSet::~ShardedHashSet() {
+    for (auto& shard : shards) {
+        shard->queue.close();
+        if (shard->thread.joinable()) shard->thread.join();
+    }
+}
+
+void ShardedHashSet::runShard(Shard& shard) {
+    Chunk chunk;
+    while (shard.queue.pop(chunk)) {
+        for (uint32_t i = 0; i < chunk.count; i++) {
+            uint32_t k = chunk.index[i];
+            chunk.isNew[k] = shard.set.insert(chunk.keys + (size_t)k * words);
+        }
+        if (outstanding.fetch_sub(1, std::memory_order_release) == 1) batchDone.wake();
+    }
+}
+
+void ShardedHashSet::insertBatch(const uint64_t* keys, size_t count, uint8_t* isNew) {
+    if (shards.size() == 1) {
+        for (size_t i = 0; i < count; i++) isNew[i] = shards[0]->set.insert(keys + i * words);
+        return;
+    }
+
+    // Route in input order, so each shard sees its keys in input order.
+    for (auto& shard : shards) shard->routed.clear();
+    for (size_t i = 0; i < count; i++) {
+        uint64_t top = keys[i * words + 1] >> (64 - shardBits);
+        shards[top]->routed.push_back((uint32_t)i);
+    }
+
+    const uint32_t CHUNK = 4096;
+    for (auto& shard : shards) {
+        const std::vector<uint32_t>& routed = shard->routed;
+        for (size_t start = 0; start < routed.size(); start += CHUNK) {
+            uint32_t n = (uint32_t)std::min<size_t>(CHUNK, routed.size() - start);
+            outstanding.fetch_add(1, std::memory_order_relaxed);
+            shard->queue.push(Chunk{keys, routed.data() + start, n, isNew});
+        }
+    }
+
+    batchDone.wait([&] { return outstanding.load(std::memory_order_acquire) == 0; });
+}
+
+size_t ShardedHashSet::size() const {
+    size_t total = 0;
+    for (const auto& shard : shards) total += shard->set.size();
+    return total;
+}
+
+size_t ShardedHashSet::memoryBytes() const {
+    size_t total = 0;
+    for (const auto& shard : shards) total += shard->set.memoryBytes();
+    return total;
+}
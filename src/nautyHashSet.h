@@ -0,0 +1,100 @@
+#ifndef NAUTY_HASH_SET_H
+#define NAUTY_HASH_SET_H
+
+// Internal set of fixed-width graph hashes for deduplication. Not part of
+// the C API.
+
+#include "nautyCore.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+// Open-addressing set of 2- or 4-word keys that are already uniformly
+// distributed hashes. Slots are probed in groups of 16 through one control
+// byte each (empty, or 7 bits of the key), compared with one SSE2
+// instruction. Keys live in a chunked arena in insertion order and slots
+// hold 32-bit arena indices, so a 128-bit key costs about 22 bytes at full
+// load. Not thread-safe; holds at most 2^32 - 1 keys.
+class FlatHashSet {
+public:
+    explicit FlatHashSet(int keyWords);
+
+    // Insert key (keyWords words). Returns true if it was not present.
+    bool insert(const uint64_t* key);
+    bool contains(const uint64_t* key) const;
+
+    int keyWords() const { return words; }
+    size_t size() const { return count; }
+    // The i-th key inserted.
+    const uint64_t* key(size_t i) const;
+    // Bytes held by the table and the arena.
+    size_t memoryBytes() const;
+    void clear();
+
+private:
+    static const int GROUP = 16;
+    static const uint8_t EMPTY = 0x80;
+    static const size_t CHUNK_KEYS = 1 << 16;
+
+    // Slot holding key, or of the first empty slot on its probe sequence.
+    size_t find(const uint64_t* key, bool& found) const;
+    void grow();
+
+    int words;
+    size_t count = 0;
+    size_t groupMask = 0;
+    std::vector<uint8_t> control;
+    std::vector<uint32_t> slots;
+    std::vector<std::unique_ptr<uint64_t[]>> arena;
+};
+
+// FlatHashSets split by the top bits of each key's second word, each owned
+// by one thread. Keys reach their shard over a bounded single-producer
+// single-consumer queue, so no table is ever locked; idle shard threads
+// block on their queue rather than polling it. Only one thread may
+// call insertBatch; size() and memoryBytes() are valid between batches.
+class ShardedHashSet {
+public:
+    // numShards is rounded down to a power of two. With one shard, keys
+    // are inserted on the calling thread.
+    ShardedHashSet(int keyWords, int numShards);
+    ~ShardedHashSet();
+    ShardedHashSet(const ShardedHashSet&) = delete;
+    ShardedHashSet& operator=(const ShardedHashSet&) = delete;
+
+    // Insert count consecutive keys and set isNew[i] for each. Of equal
+    // keys in one batch, only the first is new. Returns when all are done.
+    void insertBatch(const uint64_t* keys, size_t count, uint8_t* isNew);
+
+    size_t size() const;
+    size_t memoryBytes() const;
+
+private:
+    // A run of one batch's keys for one shard.
+    struct Chunk {
+        const uint64_t* keys;
+        const uint32_t* index;
+        uint32_t count;
+        uint8_t* isNew;
+    };
+
+    struct Shard {
+        explicit Shard(int keyWords) : set(keyWords), queue(256) {}
+        FlatHashSet set;
+        SpscQueue<Chunk> queue;
+        std::vector<uint32_t> routed;
+        std::thread thread;
+    };
+
+    void runShard(Shard& shard);
+
+    int words;
+    int shardBits = 0;
+    std::vector<std::unique_ptr<Shard>> shards;
+    std::atomic<size_t> outstanding{0};
+    WaitPoint batchDone;
+};
+
+#endif // NAUTY_HASH_SET_H
@@ -0,0 +1,178 @@
+#include "nautyMemory.h"
+#include <algorithm>
+#include <nausparse.h>
+#include <nautinv.h>
+#include <schreier.h>
+
+namespace {
+
+// Filled during static initialisation, read-only afterwards.
+std::vector<ScratchHooks>& registry() {
+    static std::vector<ScratchHooks> hooks;
+    return hooks;
+}
+
+// nauty keeps its buffers between calls only below this many vertices
+// (nauty() frees them itself from here).
+const int NAUTY_FREES_FROM = 320;
+
+// One thread's entry in the memory report.
+struct ThreadEntry {
+    std::atomic<int64_t> bytes{0};
+};
+
+std::mutex& entriesLock() {
+    static std::mutex lock;
+    return lock;
+}
+
+std::vector<ThreadEntry*>& entries() {
+    static std::vector<ThreadEntry*> list;
+    return list;
+}
+
+// The freedyn functions of the modules the wrapper runs.
+void freeNautyModules() {
+    nauty_freedyn();
+    nautil_freedyn();
+    naugraph_freedyn();
+    nausparse_freedyn();
+    schreier_freedyn();
+    nautinv_freedyn();
+}
+
+std::atomic<size_t> memoryBudget{0};
+std::atomic<uint64_t> trimGeneration{0};
+
+// The calling thread's account: its report entry, the largest graph below
+// NAUTY_FREES_FROM that nauty has run on since its buffers were last freed,
+// and the trim requests it has seen. Leaving the thread frees nauty's
+// buffers; C++ thread-local destructors run before the thread's TLS block
+// is released, so nauty's per-thread pointers are still readable. Other
+// thread-locals may be gone by then, so nothing else is touched.
+struct ThreadMemory;
+
+// Set once the thread's ThreadMemory exists. A plain pointer needs no
+// construction, so reading it does not create the entry.
+thread_local ThreadMemory* ownMemory = nullptr;
+
+struct ThreadMemory {
+    ThreadEntry entry;
+    int nautyN = 0;
+    uint64_t trimSeen;
+
+    ThreadMemory() : trimSeen(trimGeneration.load(std::memory_order_acquire)) {
+        std::lock_guard<std::mutex> hold(entriesLock());
+        entries().push_back(&entry);
+        ownMemory = this;
+    }
+
+    ~ThreadMemory() {
+#if HAVE_TLS
+        freeNautyModules();
+#endif
+        ownMemory = nullptr;
+        std::lock_guard<std::mutex> hold(entriesLock());
+        std::vector<ThreadEntry*>& list = entries();
+        list.erase(std::find(list.begin(), list.end(), &entry));
+    }
+};
+
+thread_local ThreadMemory threadMemory;
+
+} // namespace
+
+bool registerScratch(ScratchHooks hooks) {
+    registry().push_back(hooks);
+    return true;
+}
+
+void reserveThreadMemory(int n) {
+    int m = SETWORDSNEEDED(n);
+    for (const ScratchHooks& hooks : registry()) hooks.reserve(m, n);
+    if (n < NAUTY_FREES_FROM) {
+        // A cycle: regular, so nauty searches, in dense and sparse form.
+        std::vector<graph> g((size_t)m * n, 0), canong((size_t)m * n);
+        std::vector<int> lab(n);
+        for (int i = 0; i < n && n > 2; i++) {
+            ADDELEMENT(GRAPHROW(g.data(), i, m), (i + 1) % n);
+            ADDELEMENT(GRAPHROW(g.data(), (i + 1) % n, m), i);
+        }
+        SearchSettings sparse;
+        sparse.sparse = true;
+        canonicalLabel(g.data(), m, n, false, lab.data(), canong.data(), nullptr);
+        canonicalLabel(g.data(), m, n, false, lab.data(), canong.data(), nullptr, &sparse);
+    }
+    publishThreadMemory();
+}
+
+void releaseThreadMemory() {
+    for (const ScratchHooks& hooks : registry()) hooks.release();
+    freeNautyBuffers();
+    publishThreadMemory();
+}
+
+size_t threadScratchBytes() {
+    size_t bytes = 0;
+    for (const ScratchHooks& hooks : registry()) bytes += hooks.bytes();
+    return bytes;
+}
+
+size_t nautyBufferBytes(int n) {
+    if (n <= 0) return 0;
+    size_t m = SETWORDSNEEDED(n);
+    // 21 int and 4 short arrays of n + 2 entries; 24 sets and nautinv's
+    // clique stack of 9 sets; a target cell per level; refinvar's n words.
+    return 21 * (size_t)(n + 2) * sizeof(int) + 4 * (size_t)(n + 2) * sizeof(short) +
+           ((24 + 9) * m + n * m + n) * sizeof(setword);
+}
+
+size_t threadRetainedBytes() {
+    return threadScratchBytes() + nautyBufferBytes(threadMemory.nautyN);
+}
+
+void freeNautyBuffers() {
+    NautyGuard guard;
+    freeNautyModules();
+    threadMemory.nautyN = 0;
+}
+
+void noteNautyThread(int n) {
+    ThreadMemory& tm = threadMemory;
+    if (n < NAUTY_FREES_FROM && n > tm.nautyN) tm.nautyN = n;
+}
+
+void publishThreadMemory() {
+    threadMemory.entry.bytes.store((int64_t)threadRetainedBytes(), std::memory_order_relaxed);
+}
+
+void settleThreadMemory() {
+    ThreadMemory& tm = threadMemory;
+    size_t budget = memoryBudget.load(std::memory_order_relaxed);
+    uint64_t generation = trimGeneration.load(std::memory_order_acquire);
+    if ((budget > 0 && threadRetainedBytes() > budget) || generation != tm.trimSeen) {
+        tm.trimSeen = generation;
+        releaseThreadMemory();
+    } else {
+        publishThreadMemory();
+    }
+}
+
+void setMemoryBudget(size_t bytes) {
+    memoryBudget.store(bytes, std::memory_order_relaxed);
+}
+
+void requestTrimAll() {
+    trimGeneration.fetch_add(1, std::memory_order_acq_rel);
+}
+
+int threadMemoryReport(int64_t* out, int max) {
+    // Refresh the caller's own entry, but do not give it one.
+    if (ownMemory) publishThreadMemory();
+    std::lock_guard<std::mutex> hold(entriesLock());
+    const std::vector<ThreadEntry*>& list = entries();
+    for (int i = 0; i < max && i < (int)list.size(); i++) {
+        out[i] = list[i]->bytes.load(std::memory_order_relaxed);
+    }
+    return (int)list.size();
+}
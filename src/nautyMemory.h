@@ -0,0 +1,88 @@
+#ifndef NAUTY_MEMORY_H
+#define NAUTY_MEMORY_H
+
+// Internal per-thread memory of the labelling paths: the wrapper modules'
+// thread-local scratch and nauty's own module buffers. Not part of the C API.
+
+#include "nautyCore.h"
+#include <vector>
+
+// One module's thread-local scratch, acting on the calling thread's copy.
+// reserve grows it for graphs of up to n vertices (m setwords per row),
+// release frees it, and bytes is the capacity it holds.
+struct ScratchHooks {
+    void (*reserve)(int m, int n);
+    void (*release)();
+    size_t (*bytes)();
+};
+
+// Add a module's hooks. Called at static initialisation; returns true so a
+// module can write `const bool registered = registerScratch({...});`.
+bool registerScratch(ScratchHooks hooks);
+
+// Size every registered scratch and nauty's module buffers for graphs of
+// up to n vertices, so labelling graphs that size or smaller on this
+// thread allocates nothing: each graph reuses the buffers as they are.
+// Below 320 vertices nauty keeps its buffers between calls and is sized
+// here by labelling one graph of n vertices; from 320 nauty frees them
+// itself after each graph.
+void reserveThreadMemory(int n);
+
+// Free every registered scratch and nauty's module buffers on this thread.
+// Must not run while the thread is inside a labelling call.
+void releaseThreadMemory();
+
+// Bytes held by the registered scratch on this thread.
+size_t threadScratchBytes();
+
+// Upper bound on the bytes nauty's modules hold for a thread whose largest
+// graph since they were last freed had n vertices: their work arrays of n
+// ints and m-word sets, a target cell per level, and nautinv's n-set array.
+// Schreier's permutation free lists are not counted. From 320 vertices nauty
+// frees its arrays after each graph, so n is the largest below that.
+size_t nautyBufferBytes(int n);
+
+// threadScratchBytes plus nautyBufferBytes for this thread.
+size_t threadRetainedBytes();
+
+// nauty_freedyn and the other modules' freedyn on this thread: nauty,
+// nautil, naugraph, nausparse, schreier (with its free lists) and nautinv.
+void freeNautyBuffers();
+
+// Called by NautyGuard before each nauty call on a graph of n vertices.
+// Enters the thread in the memory report, and has nauty's buffers freed
+// when it exits: in a TLS build they are per-thread globals that would
+// otherwise be lost with the thread.
+void noteNautyThread(int n);
+
+// Called by ~NautyGuard: update this thread's entry in the report.
+void publishThreadMemory();
+
+// Publish this thread's retained bytes, then free all its buffers if they
+// exceed the budget or a trim of all threads was requested since its last
+// settle. Call only where no scratch is in use: at the end of an API call.
+void settleThreadMemory();
+
+// Per-thread cap on threadRetainedBytes, checked by settleThreadMemory;
+// 0 means none.
+void setMemoryBudget(size_t bytes);
+
+// Have every thread free its buffers at its next settleThreadMemory.
+void requestTrimAll();
+
+// Retained bytes of each live thread that has run nauty, as last
+// published, into out[0..max-1]; returns the number of such threads.
+int threadMemoryReport(int64_t* out, int max);
+
+template <typename T>
+size_t capacityBytes(const std::vector<T>& v) {
+    return v.capacity() * sizeof(T);
+}
+
+// Clear v and give its storage back.
+template <typename T>
+void freeVector(std::vector<T>& v) {
+    std::vector<T>().swap(v);
+}
+
+#endif // NAUTY_MEMORY_H
@@ -0,0 +1,267 @@
+#include "nautyParallel.h"
+#include "nautySchreier.h"
+#include "nautySetOps.h"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <mutex>
+#include <vector>
+
+namespace {
+
+// The group the current thread's search publishes to.
+thread_local SchreierGroup* publishTo = nullptr;
+
+// userautomproc for the child searches: publish every generator as soon as
+// it is found, so other threads skip the children it makes equivalent.
+// Publishing never blocks the search.
+void publishAutomorphism(int, int* perm, int*, int, int, int) {
+    publishTo->addGenerator(perm);
+}
+
+// The root of nauty's search: the refined unit partition, its target cell,
+// and the settings nauty would search under.
+struct SearchRoot {
+    graph* g;
+    int m, n;
+    bool digraph;
+    dispatchvec* dispatch;
+    InvariantProc invariant;
+    int minInvarLevel, maxInvarLevel, invarArg;
+    int tcLevel;
+    bool schreier;
+    std::vector<int> lab, ptn;
+    int numcells;
+    int tc;
+};
+
+// The search below one child of the root.
+struct ChildSearch {
+    int vertex;
+    bool searched = false;
+    std::vector<int> lab;       // Best leaf below the child
+    std::vector<graph> canong;  // g relabelled by lab
+    std::vector<short> codes;   // Refinement codes on the path to lab, from level 2
+    statsblk stats;
+};
+
+// Per-thread arrays for the child searches.
+struct ChildScratch {
+    std::vector<int> lab, ptn, orbits, count;
+    std::vector<set> active, tcell;
+    std::vector<setword> workspace;
+
+    ChildScratch(int m, int n)
+        : lab(n), ptn(n), orbits(n), count(n), active(m), tcell(m), workspace(100 * m) {}
+};
+
+// doref as nauty's search calls it at level; returns the refinement code.
+short refineAt(const SearchRoot& root, int* lab, int* ptn, int level, int& numcells,
+               int* count, set* active) {
+    int qinvar, code;
+    doref(root.g, lab, ptn, level, &numcells, &qinvar, count, active, &code,
+          root.dispatch->refine, root.invariant, root.minInvarLevel, root.maxInvarLevel,
+          root.invarArg, root.digraph ? TRUE : FALSE, root.m, root.n);
+    return (short)code;
+}
+
+// Search the subtree below the root's child for child.vertex with nauty. The
+// child's partition is passed as nauty's initial one, so nauty's levels run
+// one behind the whole tree's and tc_level and the invariant levels shift
+// with them.
+void searchChild(const SearchRoot& root, ChildSearch& child, SchreierGroup& group,
+                 ChildScratch& cs) {
+    int m = root.m, n = root.n;
+    int* lab = cs.lab.data();
+    int* ptn = cs.ptn.data();
+    std::copy(root.lab.begin(), root.lab.end(), lab);
+    std::copy(root.ptn.begin(), root.ptn.end(), ptn);
+    breakout(lab, ptn, 2, root.tc, child.vertex, cs.active.data(), m);
+    for (int i = 0; i < n; i++) ptn[i] = ptn[i] <= 2 ? 0 : NAUTY_INFINITY;
+
+    DEFAULTOPTIONS_GRAPH(options);
+    options.getcanon = TRUE;
+    options.defaultptn = FALSE;
+    options.digraph = root.digraph ? TRUE : FALSE;
+    options.dispatch = root.dispatch;
+    options.tc_level = root.tcLevel - 1;
+    options.schreier = root.schreier ? TRUE : FALSE;
+    if (root.invariant && root.maxInvarLevel > 1) {
+        options.invarproc = root.invariant;
+        options.mininvarlevel = std::max(root.minInvarLevel - 1, 0);
+        options.maxinvarlevel = root.maxInvarLevel - 1;
+        options.invararg = root.invarArg;
+    }
+    options.userautomproc = publishAutomorphism;
+    publishTo = &group;
+
+    child.lab.resize(n);
+    child.canong.resize((size_t)m * n);
+    nauty(root.g, lab, ptn, cs.active.data(), cs.orbits.data(), &options, &child.stats,
+          cs.workspace.data(), (int)cs.workspace.size(), m, n, child.canong.data());
+    std::copy(lab, lab + n, child.lab.begin());
+
+    // Walk down to the leaf again for its codes. The vertex fixed at each
+    // level sits at the start of that level's target cell in the leaf.
+    std::copy(root.lab.begin(), root.lab.end(), lab);
+    std::copy(root.ptn.begin(), root.ptn.end(), ptn);
+    int numcells = root.numcells + 1;
+    breakout(lab, ptn, 2, root.tc, child.vertex, cs.active.data(), m);
+    child.codes.clear();
+    for (int level = 2;; level++) {
+        child.codes.push_back(refineAt(root, lab, ptn, level, numcells, cs.count.data(),
+                                       cs.active.data()));
+        if (numcells == n) break;
+        int tc, tcellSize;
+        maketargetcell(root.g, lab, ptn, level, cs.tcell.data(), &tcellSize, &tc, root.tcLevel,
+                       root.digraph ? TRUE : FALSE, -1, root.dispatch->targetcell, m, n);
+        breakout(lab, ptn, level + 1, tc, child.lab[tc], cs.active.data(), m);
+        numcells++;
+    }
+}
+
+// nauty's order on leaves: the refinement codes level by level, a leaf
+// being better than any longer path it is a prefix of (nauty compares
+// with 077777 past a leaf), then the relabelled graph row by row.
+int compareLeaves(const ChildSearch& a, const ChildSearch& b) {
+    size_t levels = std::max(a.codes.size(), b.codes.size());
+    for (size_t i = 0; i < levels; i++) {
+        short ca = i < a.codes.size() ? a.codes[i] : 077777;
+        short cb = i < b.codes.size() ? b.codes[i] : 077777;
+        if (ca != cb) return ca < cb ? -1 : 1;
+    }
+    if (a.codes.size() != b.codes.size()) return a.codes.size() < b.codes.size() ? 1 : -1;
+    for (size_t i = 0; i < a.canong.size(); i++) {
+        if (a.canong[i] != b.canong[i]) return a.canong[i] < b.canong[i] ? -1 : 1;
+    }
+    return 0;
+}
+
+} // namespace
+
+void parallelCanonicalLabel(graph* g, int m, int n, bool digraph,
+                            int* lab, graph* canong, statsblk* stats,
+                            const SearchSettings* settings, int threads,
+                            SchreierGroup* published) {
+    if ((threads <= 1 && !published) || (settings && settings->sparse)) {
+        canonicalLabel(g, m, n, digraph, lab, canong, stats, settings);
+        return;
+    }
+    SearchSettings defaults;
+    const SearchSettings& s = settings ? *settings : defaults;
+
+    SearchRoot root;
+    root.g = g;
+    root.m = m;
+    root.n = n;
+    root.digraph = digraph;
+    root.dispatch = s.dispatch ? s.dispatch : graphDispatch();
+    root.invariant = s.invariant.invariant > 0 ? invariantProc(s.invariant.invariant) : nullptr;
+    root.minInvarLevel = std::abs(s.invariant.minInvarLevel);
+    root.maxInvarLevel = std::abs(s.invariant.maxInvarLevel);
+    root.invarArg = s.invariant.invarArg;
+    root.tcLevel = digraph ? 0 : s.tcLevel;
+    root.schreier = s.schreier;
+    root.lab.resize(n);
+    root.ptn.assign(n, NAUTY_INFINITY);
+    for (int i = 0; i < n; i++) root.lab[i] = i;
+    root.ptn[n - 1] = 0;
+    root.numcells = 1;
+
+    std::vector<set> active(m), tcell(m);
+    std::vector<int> count(n);
+    EMPTYSET(active.data(), m);
+    ADDELEMENT(active.data(), 0);
+    int tcellSize;
+    {
+        NautyGuard guard(n);
+        refineAt(root, root.lab.data(), root.ptn.data(), 1, root.numcells, count.data(),
+                 active.data());
+        if (root.numcells < n) {
+            maketargetcell(g, root.lab.data(), root.ptn.data(), 1, tcell.data(), &tcellSize,
+                           &root.tc, root.tcLevel, digraph ? TRUE : FALSE, -1,
+                           root.dispatch->targetcell, m, n);
+        }
+    }
+    SchreierGroup local;
+    SchreierGroup& group = published ? *published : local;
+    group.reset(n);
+    if (root.numcells == n) {
+        // The first leaf is the root, as in nauty.
+        std::copy(root.lab.begin(), root.lab.end(), lab);
+        root.dispatch->updatecan(g, canong, lab, 0, m, n);
+        if (stats) {
+            std::memset(stats, 0, sizeof(statsblk));
+            stats->grpsize1 = 1;
+            stats->numorbits = n;
+            stats->numnodes = 1;
+            stats->maxlevel = 1;
+            stats->canupdates = 1;
+        }
+        return;
+    }
+
+    std::vector<ChildSearch> children;
+    for (int v = -1; (v = nextElement(tcell.data(), m, v)) >= 0;) {
+        children.emplace_back();
+        children.back().vertex = v;
+    }
+
+    // Children are claimed in vertex order. One equivalent to a smaller
+    // child has the same best leaf value, so nauty never takes its leaf,
+    // and it is skipped.
+    std::mutex searchedLock;
+    std::atomic<size_t> next{0};
+    runThreads(std::min<int>(threads, (int)children.size()), [&](int) {
+        ChildScratch cs(m, n);
+        for (size_t i; (i = next.fetch_add(1, std::memory_order_relaxed)) < children.size();) {
+            ChildSearch& child = children[i];
+            if (group.orbitRepresentative(child.vertex) < child.vertex) continue;
+            {
+                NautyGuard guard(n);
+                searchChild(root, child, group, cs);
+            }
+
+            // Two children with equal best leaves give the automorphism
+            // mapping one leaf to the other, which joins the children.
+            std::lock_guard<std::mutex> hold(searchedLock);
+            for (const ChildSearch& other : children) {
+                if (!other.searched || compareLeaves(other, child) != 0) continue;
+                for (int v = 0; v < n; v++) cs.orbits[other.lab[v]] = child.lab[v];
+                group.addGenerator(cs.orbits.data());
+                break;
+            }
+            child.searched = true;
+        }
+    });
+
+    // Ties go to the smallest vertex, whose subtree nauty reaches first.
+    const ChildSearch* best = nullptr;
+    for (const ChildSearch& child : children) {
+        if (child.searched && (!best || compareLeaves(child, *best) > 0)) best = &child;
+    }
+    std::copy(best->lab.begin(), best->lab.end(), lab);
+    std::copy(best->canong.begin(), best->canong.end(), canong);
+
+    if (stats) {
+        // The children's generators and the maps between equal children
+        // generate the whole group, so the smallest child's orbit times its
+        // stabiliser order is the group order. That product is nauty's own
+        // floating value, where the chain's group.order() may differ in
+        // the last bits.
+        const ChildSearch& first = children[0];
+        *stats = first.stats;
+        std::vector<int> orbits(n);
+        int numorbits = group.orbits(orbits.data()), orbitSize = 0;
+        unsigned long nodes = 1;
+        for (int v = 0; v < n; v++) {
+            if (orbits[v] == first.vertex) orbitSize++;
+        }
+        for (const ChildSearch& child : children) {
+            if (child.searched) nodes += child.stats.numnodes;
+        }
+        MULTIPLY(stats->grpsize1, stats->grpsize2, orbitSize);
+        stats->numorbits = numorbits;
+        stats->numnodes = nodes;
+    }
+}
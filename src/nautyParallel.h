@@ -0,0 +1,32 @@
+#ifndef NAUTY_PARALLEL_H
+#define NAUTY_PARALLEL_H
+
+// Internal parallel canonical labelling of single large graphs. Not part of
+// the C API.
+
+#include "nautyCore.h"
+
+class SchreierGroup;
+
+// canonicalLabel with the subtrees below the root of nauty's search tree
+// spread over threads. Each child of the root (one per vertex of the root's
+// target cell) is searched by its own nauty call, and every automorphism
+// found is published to a group shared by all threads, so a child equivalent
+// to a smaller one is never started. lab and canong are exactly those of
+// canonicalLabel under the same settings: nauty's labelling is the first
+// best leaf of its tree, and the best child, ties to the smallest vertex,
+// holds it. stats (may be null) receives the group size, the number of
+// orbits and the nodes searched over all threads; the other fields are
+// those of the smallest child's search.
+// Sparse settings and threads <= 1 run canonicalLabel itself.
+//
+// group (may be null) is the context the threads publish to; it is reset
+// first and left holding generators of the whole automorphism group, for
+// order() and the other queries. With a group, threads <= 1 still runs the
+// split search, on one thread. Not for sparse settings.
+void parallelCanonicalLabel(graph* g, int m, int n, bool digraph,
+                            int* lab, graph* canong, statsblk* stats,
+                            const SearchSettings* settings, int threads,
+                            SchreierGroup* group = nullptr);
+
+#endif // NAUTY_PARALLEL_H
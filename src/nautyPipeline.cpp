@@ -0,0 +1,532 @@
+#include "nautyPipeline.h"
+#include "nautyDecompress.h"
+#include "nautyFormat.h"
+#include <gtools.h>
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <condition_variable>
+#include <cstring>
+#include <fcntl.h>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <set>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+
+namespace {
+
+const size_t BLOCK_SIZE = 1 << 20;
+
+// Cuts the input into batches of about BLOCK_SIZE bytes at line boundaries.
+// Regular files are mapped and batches point into the mapping; pipes and
+// gzip input are read in blocks, with a partial last line carried into the
+// next batch.
+class BatchReader {
+public:
+    BatchReader(int fd, int threads) : fd(fd), threads(threads) {
+        struct stat st;
+        if (::fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size == 0) return;
+        void* map = ::mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map == MAP_FAILED) return;
+        ::madvise(map, st.st_size, MADV_SEQUENTIAL);
+        mapped = (const char*)map;
+        mappedSize = st.st_size;
+        if (isGzip(mapped, mappedSize)) gzip = openGzip(mapped, mappedSize, -1, threads);
+    }
+
+    ~BatchReader() {
+        if (mapped) ::munmap((void*)mapped, mappedSize);
+    }
+
+    // Returns false at end of input. Sets error on a read failure.
+    bool next(LineBatch& batch) {
+        batch.seq = seq;
+        batch.afterHandOn = handOn;
+        if (!(mapped && !gzip ? nextMapped(batch) : nextRead(batch))) return false;
+        handOn = batch.handOn;
+        return true;
+    }
+
+    bool error = false;
+
+private:
+    bool nextMapped(LineBatch& batch) {
+        if (offset == mappedSize) return false;
+        const char* start = mapped + offset;
+        size_t left = mappedSize - offset;
+        size_t size = left;
+        if (left > BLOCK_SIZE) {
+            const char* cut = (const char*)::memrchr(start, '\n', BLOCK_SIZE);
+            if (!cut) cut = (const char*)std::memchr(start + BLOCK_SIZE, '\n', left - BLOCK_SIZE);
+            if (cut) size = cut + 1 - start;
+        }
+        batch.data = start;
+        batch.size = size;
+        // Start reading the batch from disk now; a worker will only touch it
+        // once the batches queued ahead of it are taken.
+        uintptr_t page = (uintptr_t)start & ~(uintptr_t)(::sysconf(_SC_PAGESIZE) - 1);
+        ::madvise((void*)page, (uintptr_t)start + size - page, MADV_WILLNEED);
+        offset += size;
+        size_t next = offset;
+        while (next < mappedSize && (mapped[next] == '\n' || mapped[next] == '\r')) next++;
+        batch.handOn = next < mappedSize && mapped[next] == ';';
+        seq++;
+        return true;
+    }
+
+    bool nextRead(LineBatch& batch) {
+        batch.text.swap(carry);
+        carry.clear();
+
+        for (;;) {
+            size_t scanned = batch.text.size();
+            if (!eof) {
+                batch.text.resize(scanned + BLOCK_SIZE);
+                ssize_t got = fill(batch.text.data() + scanned, BLOCK_SIZE);
+                if (got < 0) error = true;
+                if (got <= 0) eof = true;
+                batch.text.resize(scanned + std::max<ssize_t>(got, 0));
+            }
+
+            if (eof) {
+                if (batch.text.empty()) return false;
+                break;
+            }
+
+            auto lastNewline = std::find(batch.text.rbegin(),
+                                         batch.text.rend() - scanned, '\n');
+            if (lastNewline != batch.text.rend() - scanned) {
+                auto cut = lastNewline.base();
+                carry.assign(cut, batch.text.end());
+                batch.text.erase(cut, batch.text.end());
+                break;
+            }
+        }
+        batch.data = batch.text.data();
+        batch.size = batch.text.size();
+        // Without the next block in hand, assume it may continue this one.
+        batch.handOn = !eof && (carry.empty() || carry[0] == ';' || carry[0] == '\r');
+        seq++;
+        return true;
+    }
+
+    // Read raw or decompressed input; a pipe turns out to be gzip from its
+    // first bytes.
+    ssize_t fill(char* dst, size_t max) {
+        if (gzip) return gzip->read(dst, max);
+        ssize_t got;
+        do {
+            got = ::read(fd, dst, max);
+        } while (got < 0 && errno == EINTR);
+        if (firstRead && got > 0 && isGzip(dst, got)) {
+            gzip = openGzip(dst, got, fd, threads);
+            got = gzip->read(dst, max);
+        }
+        firstRead = false;
+        return got;
+    }
+
+    int fd;
+    int threads;
+    bool firstRead = true;
+    std::unique_ptr<GzipReader> gzip;
+    bool eof = false;
+    bool handOn = false;
+    int64_t seq = 0;
+    std::vector<char> carry;
+    const char* mapped = nullptr;
+    size_t mappedSize = 0;
+    size_t offset = 0;
+};
+
+thread_local PipelineStats pipelineStats;
+
+bool writeAll(int fd, const char* data, size_t size) {
+    while (size > 0) {
+        ssize_t put = ::write(fd, data, size);
+        if (put < 0 && errno == EINTR) continue;
+        if (put <= 0) return false;
+        data += put;
+        size -= put;
+    }
+    return true;
+}
+
+// Decode the size header at p. Returns the number of characters used, or 0
+// if the header is truncated.
+size_t decodeSize(const char* p, size_t len, int64_t& n) {
+    if (len < 1) return 0;
+    if (p[0] - BIAS6 <= SMALLN) {
+        n = p[0] - BIAS6;
+        return 1;
+    }
+    size_t digits = (len >= 2 && p[1] - BIAS6 > SMALLN) ? 6 : 3;
+    size_t start = digits == 6 ? 2 : 1;
+    if (len < start + digits) return 0;
+    n = 0;
+    for (size_t i = start; i < start + digits; i++) n = (n << 6) | (p[i] - BIAS6);
+    return start + digits;
+}
+
+// The last graph of each batch followed by incremental sparse6 lines,
+// handed from the worker decoding that batch to the one decoding the next.
+class GraphChain {
+public:
+    struct State {
+        bool valid = false;
+        int n = -1;
+        int m = 0;
+        bool directed = false;
+        std::vector<graph> rows;
+    };
+
+    void publish(int64_t seq, std::shared_ptr<const State> state) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (discarded.erase(seq)) return;
+        states[seq] = std::move(state);
+        ready.notify_all();
+    }
+
+    // The state batch seq published, waiting for it.
+    std::shared_ptr<const State> take(int64_t seq) {
+        std::unique_lock<std::mutex> lock(mutex);
+        ready.wait(lock, [&] { return states.count(seq) > 0; });
+        std::shared_ptr<const State> state = std::move(states[seq]);
+        states.erase(seq);
+        return state;
+    }
+
+    // Batch seq guessed that it would be continued, but was not.
+    void discard(int64_t seq) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!states.erase(seq)) discarded.insert(seq);
+    }
+
+private:
+    std::mutex mutex;
+    std::condition_variable ready;
+    std::map<int64_t, std::shared_ptr<const State>> states;
+    std::set<int64_t> discarded;
+};
+
+// Restore a handed-on graph into scratch, as if it had just been decoded.
+void loadState(const GraphChain::State* state, LabelScratch& scratch) {
+    if (!state || !state->valid) {
+        scratch.lastN = -1;
+        return;
+    }
+    scratch.reserve(state->m, state->n);
+    std::copy(state->rows.begin(), state->rows.end(), scratch.g.begin());
+    scratch.lastN = state->n;
+    scratch.lastM = state->m;
+    scratch.lastDirected = state->directed;
+}
+
+void runLines(LineBatch& batch, const LineHandler& handleLine, LabelScratch& scratch,
+              GraphChain& chain) {
+    findLineEnds(batch.data, batch.size, scratch.ends);
+    std::vector<std::pair<size_t, size_t>> lines;
+    size_t start = 0;
+    for (size_t end : scratch.ends) {
+        size_t len = end - start;
+        while (len > 0 && (batch.data[start + len - 1] == '\n' ||
+                           batch.data[start + len - 1] == '\r')) {
+            len--;
+        }
+        if (len > 0) lines.emplace_back(start, len);
+        start = end;
+    }
+
+    // is6 lines only make sense after the graph before them, so a batch
+    // starting with one waits for its predecessor's last graph, and a batch
+    // followed by one decodes its tail first and hands that graph on.
+    bool continues = !lines.empty() && batch.data[lines[0].first] == ';';
+    std::shared_ptr<const GraphChain::State> before;
+    bool taken = false;
+    if (batch.handOn) {
+        size_t from = lines.size();
+        while (from > 0 && batch.data[lines[from - 1].first] == ';') from--;
+        if (from > 0) {
+            from--;
+            scratch.lastN = -1;
+        } else {
+            if (batch.afterHandOn) before = chain.take(batch.seq - 1);
+            taken = true;
+            loadState(before.get(), scratch);
+        }
+        auto after = std::make_shared<GraphChain::State>();
+        ParsedGraph parsed;
+        bool ok = true;
+        for (size_t i = from; i < lines.size() && ok; i++) {
+            ok = parseGraphLine(batch.data + lines[i].first, lines[i].second, scratch, parsed);
+        }
+        if (ok && scratch.lastN >= 0) {
+            after->valid = true;
+            after->n = scratch.lastN;
+            after->m = scratch.lastM;
+            after->directed = scratch.lastDirected;
+            after->rows.assign(scratch.g.begin(),
+                               scratch.g.begin() + (size_t)scratch.lastM * scratch.lastN);
+        }
+        chain.publish(batch.seq, after);
+    }
+    if (!taken && batch.afterHandOn) {
+        if (continues) {
+            before = chain.take(batch.seq - 1);
+        } else {
+            chain.discard(batch.seq - 1);
+        }
+    }
+    loadState(before.get(), scratch);
+
+    for (auto& line : lines) {
+        if (!handleLine(batch.data + line.first, line.second, scratch, batch)) {
+            batch.malformed = true;
+            return;
+        }
+        batch.graphs++;
+    }
+}
+
+} // namespace
+
+void LabelScratch::reserve(int m, int n) {
+    size_t words = (size_t)m * (size_t)n;
+    if (g.size() < words) {
+        g.resize(words);
+        canong.resize(words);
+    }
+    if (lab.size() < (size_t)n) lab.resize(n);
+}
+
+namespace {
+
+// Largest graph decoded densely: scratch.g and scratch.canong each take
+// n * SETWORDSNEEDED(n) setwords, 512 MiB apiece at this size.
+const int64_t MAX_DENSE_VERTICES = 1 << 16;
+
+// parseGraphLine, given the vertex count of the graph in scratch.g (-1 if
+// none) for an incremental line to apply to.
+bool decodeGraphLine(const char* line, size_t len, int lastN, LabelScratch& scratch,
+                     ParsedGraph& parsed) {
+    parsed = ParsedGraph();
+
+    // A file header such as ">>graph6<<" is followed directly by a graph.
+    if (len >= 2 && line[0] == '>' && line[1] == '>') {
+        const char marker[] = "<<";
+        const char* end = std::search(line, line + len, marker, marker + 2);
+        if (end == line + len) return false;
+        parsed.header = line;
+        parsed.headerLen = end + 2 - line;
+        len -= parsed.headerLen;
+        line = end + 2;
+    }
+    parsed.text = line;
+    parsed.textLen = len;
+
+    bool incremental = len > 0 && line[0] == ';';
+    bool sparse = len > 0 && (line[0] == ':' || incremental);
+    bool directed = len > 0 && line[0] == '&';
+    size_t prefix = (sparse || directed) ? 1 : 0;
+    bool invalid = false;
+    for (size_t i = prefix; i < len; i++) {
+        unsigned char c = line[i];
+        invalid |= (c < BIAS6) | (c > MAXBYTE);
+    }
+    if (invalid) return false;
+
+    if (incremental) {
+        // Toggle edges of the previous graph, in place; it must be undirected.
+        if (lastN < 0 || scratch.lastDirected) return false;
+        parsed.n = lastN;
+        parsed.sparse = true;
+        if (lastN == 0) return true;
+        int m = scratch.lastM;
+        parsed.m = m;
+        graph* g = scratch.g.data();
+        scratch.line.assign(line, line + len);
+        scratch.line.push_back('\n');
+        scratch.line.push_back('\0');
+        stringtograph_inc(scratch.line.data(), g, m, g, lastN);
+        for (int i = 0; !parsed.digraph && i < lastN; i++) {
+            parsed.digraph = ISELEMENT(GRAPHROW(g, i, m), i);
+        }
+        return true;
+    }
+
+    int64_t n;
+    size_t header = decodeSize(line + prefix, len - prefix, n);
+    if (header == 0 || n > MAX_DENSE_VERTICES) return false;
+    size_t body = len - prefix - header;
+    if (!sparse && !directed && body != (size_t)((n * (n - 1) / 2 + 5) / 6)) return false;
+    if (directed && body != (size_t)((n * n + 5) / 6)) return false;
+
+    parsed.n = (int)n;
+    parsed.directed = parsed.digraph = directed;
+    parsed.sparse = sparse;
+    if (n == 0) return true;
+
+    int m = SETWORDSNEEDED(n);
+    parsed.m = m;
+    try {
+        scratch.reserve(m, (int)n);
+    } catch (const std::bad_alloc&) {
+        return false;
+    }
+    graph* g = scratch.g.data();
+    if (sparse) {
+        // stringtograph needs a writable, terminated copy.
+        scratch.line.assign(line, line + len);
+        scratch.line.push_back('\n');
+        scratch.line.push_back('\0');
+        stringtograph(scratch.line.data(), g, m);
+    } else {
+        scratch.bits.resize(unpackedSize(body));
+        unpackSixBit(line + prefix + header, body, scratch.bits.data());
+        if (directed) {
+            digraph6Rows(scratch.bits.data(), m, (int)n, g);
+        } else {
+            graph6Rows(scratch.bits.data(), m, (int)n, g);
+        }
+    }
+
+    // sparse6 may contain loops, which nauty only handles in digraph mode.
+    for (int i = 0; sparse && !parsed.digraph && i < n; i++) {
+        parsed.digraph = ISELEMENT(GRAPHROW(g, i, m), i);
+    }
+    return true;
+}
+
+} // namespace
+
+bool parseGraphLine(const char* line, size_t len, LabelScratch& scratch, ParsedGraph& parsed) {
+    int lastN = scratch.lastN;
+    scratch.lastN = -1;
+    if (!decodeGraphLine(line, len, lastN, scratch, parsed)) return false;
+    scratch.lastN = parsed.n;
+    scratch.lastM = parsed.m;
+    scratch.lastDirected = parsed.directed;
+    return true;
+}
+
+void appendGraph(const ParsedGraph& parsed, graph* canong, std::string& out) {
+    if (parsed.n == 0) {
+        out.append(parsed.text, parsed.textLen);
+        out.push_back('\n');
+    } else if (parsed.directed) {
+        out += ntod6(canong, parsed.m, parsed.n);
+    } else if (parsed.sparse) {
+        out += ntos6(canong, parsed.m, parsed.n);
+    } else {
+        out += ntog6(canong, parsed.m, parsed.n);
+    }
+}
+
+int64_t runLinePipeline(const char* inputPath, const char* outputPath, bool ordered,
+                        int64_t numThreads, const LineHandler& handleLine,
+                        const BatchFilter& filter, int64_t* graphsProcessed) {
+    if (graphsProcessed) *graphsProcessed = 0;
+    bool fromStdin = std::strcmp(inputPath, "-") == 0;
+    bool toStdout = std::strcmp(outputPath, "-") == 0;
+    int in = fromStdin ? 0 : ::open(inputPath, O_RDONLY);
+    if (in < 0) return -1;
+    int out = toStdout ? 1 : ::open(outputPath, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (out < 0) {
+        if (!fromStdin) ::close(in);
+        return -2;
+    }
+
+    int threads = resolveThreadCount(numThreads);
+    BoundedQueue<LineBatch> pending(2 * threads), done(2 * threads);
+    std::atomic<bool> malformed(false);
+    std::atomic<int> activeWorkers(threads);
+    BatchReader reader(in, threads);
+    GraphChain chain;
+
+    std::thread readerThread([&] {
+        LineBatch batch;
+        while (!malformed && reader.next(batch)) {
+            if (!pending.push(std::move(batch))) break;
+            batch = LineBatch();
+        }
+        pending.close();
+    });
+
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; t++) {
+        workers.emplace_back([&] {
+            LabelScratch scratch;
+            LineBatch batch;
+            while (pending.pop(batch)) {
+                runLines(batch, handleLine, scratch, chain);
+                if (batch.malformed) malformed = true;
+                std::vector<char>().swap(batch.text);
+                batch.data = nullptr;
+                batch.size = 0;
+                done.push(std::move(batch));
+            }
+            if (--activeWorkers == 0) done.close();
+        });
+    }
+
+    // Write on this thread, reordering by batch number if asked to. Output
+    // stops after the first malformed line written or the first write error.
+    bool writeFailed = false;
+    bool stopped = false;
+    int64_t written = 0;
+    int64_t nextSeq = 0;
+    std::map<int64_t, LineBatch> reorder;
+    auto emit = [&](LineBatch& batch) {
+        if (stopped) return;
+        if (filter) filter(batch);
+        if (!writeAll(out, batch.output.data(), batch.output.size())) {
+            writeFailed = stopped = true;
+        } else {
+            written += batch.graphs;
+            stopped = batch.malformed;
+        }
+        if (stopped) pending.close();
+    };
+
+    LineBatch batch;
+    while (done.pop(batch)) {
+        if (!ordered) {
+            emit(batch);
+            continue;
+        }
+        reorder.emplace(batch.seq, std::move(batch));
+        for (auto it = reorder.begin(); it != reorder.end() && it->first == nextSeq;
+             it = reorder.erase(it), nextSeq++) {
+            emit(it->second);
+        }
+    }
+
+    readerThread.join();
+    for (auto& w : workers) w.join();
+    if (!fromStdin) ::close(in);
+    if (!toStdout && ::close(out) != 0) writeFailed = true;
+
+    BoundedQueue<LineBatch>::Counters work = pending.counters(), results = done.counters();
+    pipelineStats.batches = work.pops;
+    pipelineStats.readerWaits = work.fullWaits;
+    pipelineStats.workerWaits = work.emptyWaits;
+    pipelineStats.depthSum = work.depthSum;
+    pipelineStats.queueCapacity = pending.limit();
+    pipelineStats.writerWaits = results.emptyWaits;
+
+    if (graphsProcessed) *graphsProcessed = written;
+    if (writeFailed) return -2;
+    // A line cut short by a read error is not the input's fault.
+    if (reader.error) return -1;
+    if (malformed) return -3;
+    return 0;
+}
+
+const PipelineStats& lastPipelineStats() {
+    return pipelineStats;
+}
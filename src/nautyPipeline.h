@@ -0,0 +1,104 @@
+#ifndef NAUTY_PIPELINE_H
+#define NAUTY_PIPELINE_H
+
+// Internal reader -> workers -> writer pipeline over files of graph6,
+// sparse6 or digraph6 lines, shared by the streaming APIs. Not part of the
+// C API.
+
+#include "nautyCore.h"
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+// A run of whole input lines and what the workers produced for them. The
+// lines are a view into the mapped input file or into text.
+struct LineBatch {
+    int64_t seq = 0;
+    const char* data = nullptr;
+    size_t size = 0;
+    std::vector<char> text;
+    std::string output;
+    // Per-graph results for writers that filter the output: keyWords words
+    // per graph, and where each graph's text ends in output.
+    std::vector<uint64_t> keys;
+    std::vector<size_t> outputEnds;
+    int64_t graphs = 0;
+    bool malformed = false;
+    // The next batch may start with an incremental sparse6 line, so this
+    // one hands on its last graph; afterHandOn says the previous one did.
+    bool handOn = false;
+    bool afterHandOn = false;
+};
+
+// Per-thread buffers for decoding and labelling.
+struct LabelScratch {
+    std::vector<graph> g, canong;
+    std::vector<int> lab;
+    std::vector<uint8_t> bits;
+    std::vector<char> line;
+    std::vector<size_t> ends;
+    // The graph last decoded into g, to which an incremental sparse6 line
+    // applies; lastN is -1 if there is none.
+    int lastN = -1;
+    int lastM = 0;
+    bool lastDirected = false;
+
+    void reserve(int m, int n);
+};
+
+// One decoded input line; the graph itself is left in scratch.g. An
+// incremental sparse6 (is6) line, ";" and the edges to toggle, is applied
+// in place to the previous graph and reported as sparse6.
+struct ParsedGraph {
+    int n = 0;
+    int m = 0;
+    bool directed = false;     // digraph6
+    bool sparse = false;       // sparse6
+    bool digraph = false;      // needs nauty's digraph mode (directed or loops)
+    const char* header = nullptr;   // ">>graph6<<" etc. if the line starts with one
+    size_t headerLen = 0;
+    const char* text = nullptr;     // the graph's own text, without the header
+    size_t textLen = 0;
+};
+
+// Decode a line (without its line ending) into scratch.g. Returns false if
+// the line is malformed or its graph has more than 65536 vertices.
+bool parseGraphLine(const char* line, size_t len, LabelScratch& scratch, ParsedGraph& parsed);
+
+// Append canong in the input's format, followed by a newline.
+void appendGraph(const ParsedGraph& parsed, graph* canong, std::string& out);
+
+// Handles one non-empty line, appending its results to batch. Returns false
+// if the line is malformed. Runs on the worker threads.
+typedef std::function<bool(const char* line, size_t len, LabelScratch& scratch,
+                           LineBatch& batch)> LineHandler;
+
+// Runs on the writer thread before a batch's output is written, in batch
+// order when the pipeline is ordered. May rewrite batch.output.
+typedef std::function<void(LineBatch& batch)> BatchFilter;
+
+// Read inputPath in batches on one thread, run handleLine over the lines on
+// numThreads workers, and write each batch's output on the calling thread.
+// "-" selects stdin/stdout. graphsProcessed counts the graphs of the batches
+// written. Returns 0, or -1 (input), -2 (output) or -3 (malformed line;
+// output stops at the batch containing it).
+int64_t runLinePipeline(const char* inputPath, const char* outputPath, bool ordered,
+                        int64_t numThreads, const LineHandler& handleLine,
+                        const BatchFilter& filter, int64_t* graphsProcessed);
+
+// How the stages of the last runLinePipeline on this thread kept up with
+// each other. A reader that often finds the work queue full is waiting on
+// labelling; workers that often find it empty are waiting on input.
+struct PipelineStats {
+    int64_t batches = 0;
+    int64_t readerWaits = 0;      // work queue full
+    int64_t workerWaits = 0;      // work queue empty
+    int64_t depthSum = 0;         // work queue depth seen by each batch taken
+    int64_t queueCapacity = 0;
+    int64_t writerWaits = 0;      // result queue empty
+};
+
+const PipelineStats& lastPipelineStats();
+
+#endif // NAUTY_PIPELINE_H
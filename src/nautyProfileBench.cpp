@@ -0,0 +1,132 @@
+#include "nautyClassify.h"
+#include "nautyCore.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+// Times nautyClassifyProfile with each profile on graph families that stand
+// for the workloads the profiles are meant for.
+static void usage() {
+    std::cerr << "Usage: nauty_profile_bench [-r#]\n"
+              << "  Time each classify profile on representative graph families.\n"
+              << "  -r#  repetitions of each family's batch (default 3)\n";
+}
+
+struct Family {
+    const char* name;
+    int n;
+    int graphs;
+    std::vector<int64_t> batch;
+};
+
+static void addEdge(std::vector<int64_t>& matrix, int n, int i, int j) {
+    matrix[(size_t)i * n + j] = 1;
+    matrix[(size_t)j * n + i] = 1;
+}
+
+// Random vertex order, so no family hands nauty a convenient labelling.
+static void appendShuffled(Family& f, const std::vector<int64_t>& matrix, FastRng& rng) {
+    int n = f.n;
+    std::vector<int> perm(n);
+    for (int i = 0; i < n; i++) perm[i] = i;
+    for (int i = n - 1; i > 0; i--) std::swap(perm[i], perm[rng.below(i + 1)]);
+    size_t base = f.batch.size();
+    f.batch.resize(base + (size_t)n * n);
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j < n; j++) {
+            f.batch[base + (size_t)perm[i] * n + perm[j]] = matrix[(size_t)i * n + j];
+        }
+    }
+    f.graphs++;
+}
+
+// Connected 6-vertex graphs, as a motif census of an undirected network
+// meets them; few are asymmetric at this size.
+static Family tinyMotifs(FastRng& rng) {
+    Family f{"tiny motifs (k=6)", 6, 0, {}};
+    for (int t = 0; t < 20000; t++) {
+        std::vector<int64_t> matrix(36, 0);
+        for (int i = 1; i < 6; i++) {
+            addEdge(matrix, 6, i, (int)rng.below(i));
+            for (int j = 0; j < i; j++) {
+                if (rng.below(3) == 0) addEdge(matrix, 6, i, j);
+            }
+        }
+        appendShuffled(f, matrix, rng);
+    }
+    return f;
+}
+
+// Random trees with leaves hung off them: few edges, large groups.
+static Family sparseLarge(FastRng& rng) {
+    Family f{"sparse large (n=300 trees)", 300, 0, {}};
+    int n = f.n;
+    for (int t = 0; t < 20; t++) {
+        std::vector<int64_t> matrix((size_t)n * n, 0);
+        int spine = n / 3;
+        for (int v = 1; v < spine; v++) addEdge(matrix, n, v, (int)rng.below(v));
+        for (int v = spine; v < n; v++) addEdge(matrix, n, v, (int)rng.below(spine));
+        appendShuffled(f, matrix, rng);
+    }
+    return f;
+}
+
+// Random cubic graphs: regular, so refinement splits nothing, but almost
+// always asymmetric.
+static Family regularHard(FastRng& rng) {
+    Family f{"regular (n=60 cubic)", 60, 0, {}};
+    int n = f.n;
+    while (f.graphs < 40) {
+        std::vector<int64_t> matrix((size_t)n * n, 0);
+        std::vector<int> points(3 * n);
+        for (int i = 0; i < 3 * n; i++) points[i] = i / 3;
+        for (int i = 3 * n - 1; i > 0; i--) std::swap(points[i], points[rng.below(i + 1)]);
+        bool simple = true;
+        for (int i = 0; i < 3 * n && simple; i += 2) {
+            int a = points[i], b = points[i + 1];
+            simple = a != b && !matrix[(size_t)a * n + b];
+            if (simple) addEdge(matrix, n, a, b);
+        }
+        if (simple) appendShuffled(f, matrix, rng);
+    }
+    return f;
+}
+
+int main(int argc, char* argv[]) {
+    int reps = 3;
+    for (int i = 1; i < argc; i++) {
+        if (std::strncmp(argv[i], "-r", 2) == 0 && argv[i][2]) {
+            reps = std::atoi(argv[i] + 2);
+        } else {
+            usage();
+            return 1;
+        }
+    }
+
+    const char* profiles[] = {"default", "tiny-motif", "sparse-large", "regular-hard"};
+    std::cout << "family";
+    for (const char* profile : profiles) std::cout << "\t" << profile;
+    std::cout << "\t(microseconds per graph)\n";
+
+    FastRng rng(1);
+    Family families[] = {tinyMotifs(rng), sparseLarge(rng), regularHard(rng)};
+    for (Family& f : families) {
+        std::vector<int64_t> results((size_t)f.graphs * f.n);
+        std::cout << f.name;
+        for (const char* profile : profiles) {
+            auto start = std::chrono::steady_clock::now();
+            for (int r = 0; r < reps; r++) {
+                nautyClassifyProfile(f.batch.data(), f.n, results.data(), f.graphs, profile);
+            }
+            double us = std::chrono::duration<double, std::micro>(
+                            std::chrono::steady_clock::now() - start).count() /
+                        ((double)reps * f.graphs);
+            std::cout << "\t" << us;
+        }
+        std::cout << "\n";
+    }
+    return 0;
+}
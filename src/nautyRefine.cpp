@@ -0,0 +1,359 @@
+#include "nautyRefine.h"
+#include "nautyMemory.h"
+#include "nautySetOps.h"
+#include <algorithm>
+#include <cstring>
+
+#if defined(__x86_64__) && WORDSIZE == 64
+#include <immintrin.h>
+#define NAUTY_REFINE_X86 1
+#endif
+
+// As in naugraph.c, so codes match refine's.
+#define MASH(l, i) ((((l) ^ 065435) + (i)) & 077777)
+#define CLEANUP(l) ((int)((l) % 077777))
+
+namespace {
+
+typedef int (*IntersectFn)(const set*, const set*, int);
+typedef void (*RefineFn)(graph*, int*, int*, int, int*, int*, set*, int*, int, int);
+
+inline int intersectScalar(const set* a, const set* b, int m) {
+    int count = 0;
+    for (int i = 0; i < m; i++) {
+        setword x = a[i] & b[i];
+        if (x) count += POPCOUNT(x);
+    }
+    return count;
+}
+
+#ifdef NAUTY_REFINE_X86
+__attribute__((target("popcnt")))
+inline int intersectPopcnt(const set* a, const set* b, int m) {
+    int count = 0;
+    for (int i = 0; i < m; i++) count += __builtin_popcountll(a[i] & b[i]);
+    return count;
+}
+
+// Four words at a time: look up the popcount of each nibble with a byte
+// shuffle and sum the bytes of each word with SAD.
+__attribute__((target("avx2,popcnt")))
+inline int intersectAvx2(const set* a, const set* b, int m) {
+    const __m256i table = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                           0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m256i nibble = _mm256_set1_epi8(0x0f);
+    __m256i sums = _mm256_setzero_si256();
+    int i = 0;
+    for (; i + 4 <= m; i += 4) {
+        __m256i x = _mm256_and_si256(_mm256_loadu_si256((const __m256i*)(a + i)),
+                                     _mm256_loadu_si256((const __m256i*)(b + i)));
+        __m256i lo = _mm256_shuffle_epi8(table, _mm256_and_si256(x, nibble));
+        __m256i hi = _mm256_shuffle_epi8(table, _mm256_and_si256(_mm256_srli_epi16(x, 4), nibble));
+        sums = _mm256_add_epi64(sums, _mm256_sad_epu8(_mm256_add_epi8(lo, hi),
+                                                      _mm256_setzero_si256()));
+    }
+    uint64_t lanes[4];
+    _mm256_storeu_si256((__m256i*)lanes, sums);
+    int count = (int)(lanes[0] + lanes[1] + lanes[2] + lanes[3]);
+    for (; i < m; i++) count += __builtin_popcountll(a[i] & b[i]);
+    return count;
+}
+
+// Eight words at a time with VPOPCNTQ; the tail is a masked load.
+__attribute__((target("avx512f,avx512vpopcntdq")))
+inline int intersectAvx512(const set* a, const set* b, int m) {
+    __m512i sums = _mm512_setzero_si512();
+    int i = 0;
+    for (; i + 8 <= m; i += 8) {
+        __m512i x = _mm512_and_si512(_mm512_loadu_si512(a + i), _mm512_loadu_si512(b + i));
+        sums = _mm512_add_epi64(sums, _mm512_popcnt_epi64(x));
+    }
+    if (i < m) {
+        __mmask8 tail = (__mmask8)((1u << (m - i)) - 1);
+        __m512i x = _mm512_and_si512(_mm512_maskz_loadu_epi64(tail, a + i),
+                                     _mm512_maskz_loadu_epi64(tail, b + i));
+        sums = _mm512_add_epi64(sums, _mm512_popcnt_epi64(x));
+    }
+    return (int)_mm512_reduce_add_epi64(sums);
+}
+#endif
+
+struct RefineScratch {
+    std::vector<int> workperm, bucket, nextCell;
+    std::vector<setword> workset;
+
+    void reserve(int m, int n) {
+        if (workperm.size() < (size_t)n) {
+            workperm.resize(n);
+            bucket.resize(n + 2);
+            nextCell.resize(n);
+        }
+        if (workset.size() < (size_t)m) workset.resize(m);
+    }
+
+    void release() {
+        freeVector(workperm);
+        freeVector(bucket);
+        freeVector(nextCell);
+        freeVector(workset);
+    }
+
+    size_t bytes() const {
+        return capacityBytes(workperm) + capacityBytes(bucket) + capacityBytes(nextCell) +
+               capacityBytes(workset);
+    }
+};
+
+thread_local RefineScratch refineScratch;
+
+const bool scratchRegistered = registerScratch({
+    [](int m, int n) { refineScratch.reserve(m, n); },
+    [] { refineScratch.release(); },
+    [] { return refineScratch.bytes(); },
+});
+
+// A port of refine() in naugraph.c. Two things are faster and nothing else
+// differs: cells of one vertex, which never split again, are skipped via a
+// list of the others instead of being stepped over for every splitting
+// cell; and neighbour counts only look at the words of the splitting cell
+// that have any of its vertices, through the kernel.
+// countIn is inlined into one copy per kernel, compiled for its target.
+template <int (*countIn)(const set*, const set*, int)>
+__attribute__((always_inline)) inline void refineCells(graph* g, int* lab, int* ptn, int level,
+                                                       int* numcells, int* count, set* active,
+                                                       int* code, int m, int n) {
+    RefineScratch& rs = refineScratch;
+    rs.reserve(m, n);
+    int* workperm = rs.workperm.data();
+    int* bucket = rs.bucket.data();
+    int* nextCell = rs.nextCell.data();
+    set* workset = rs.workset.data();
+
+    // nextCell links the starts of cells of two or more vertices, in order.
+    int firstCell = n;
+    int* link = &firstCell;
+    for (int cell1 = 0, cell2; cell1 < n; cell1 = cell2 + 1) {
+        for (cell2 = cell1; ptn[cell2] > level; ++cell2) {}
+        if (cell2 > cell1) {
+            *link = cell1;
+            link = &nextCell[cell1];
+        }
+    }
+    *link = n;
+    // Replace cell1..cell2 in the list, at `at`, by its larger fragments.
+    auto relink = [&](int*& at, int cell1, int cell2, int next) {
+        for (int f = cell1, e; f <= cell2; f = e + 1) {
+            for (e = f; ptn[e] > level; ++e) {}
+            if (e > f) {
+                *at = f;
+                at = &nextCell[f];
+            }
+        }
+        *at = next;
+    };
+
+    long longcode = *numcells;
+    int split1 = -1, split2;
+    int hint = 0;
+    while (*numcells < n && ((split1 = hint, ISELEMENT(active, split1)) ||
+                             (split1 = nextElement(active, m, split1)) >= 0 ||
+                             (split1 = nextElement(active, m, -1)) >= 0)) {
+        DELELEMENT(active, split1);
+        for (split2 = split1; ptn[split2] > level; ++split2) {}
+        longcode = MASH(longcode, split1 + split2);
+        int* at = &firstCell;
+        if (split1 == split2) {
+            // Trivial splitting cell: move each cell's neighbours first.
+            set* gptr = GRAPHROW(g, lab[split1], m);
+            for (int cell1 = firstCell, next; cell1 < n; cell1 = next) {
+                next = nextCell[cell1];
+                int cell2;
+                for (cell2 = cell1; ptn[cell2] > level; ++cell2) {}
+                int c1 = cell1, c2 = cell2;
+                while (c1 <= c2) {
+                    int labc1 = lab[c1];
+                    if (ISELEMENT(gptr, labc1)) {
+                        ++c1;
+                    } else {
+                        lab[c1] = lab[c2];
+                        lab[c2] = labc1;
+                        --c2;
+                    }
+                }
+                if (c2 >= cell1 && c1 <= cell2) {
+                    ptn[c2] = level;
+                    longcode = MASH(longcode, c2);
+                    ++*numcells;
+                    if (ISELEMENT(active, cell1) || c2 - cell1 >= cell2 - c1) {
+                        ADDELEMENT(active, c1);
+                        if (c1 == cell2) hint = c1;
+                    } else {
+                        ADDELEMENT(active, cell1);
+                        if (c2 == cell1) hint = cell1;
+                    }
+                }
+                relink(at, cell1, cell2, next);
+            }
+        } else {
+            // Nontrivial splitting cell: sort each cell by neighbour count.
+            EMPTYSET(workset, m);
+            int lo = m, hi = -1;
+            for (int i = split1; i <= split2; ++i) {
+                ADDELEMENT(workset, lab[i]);
+                lo = std::min(lo, SETWD(lab[i]));
+                hi = std::max(hi, SETWD(lab[i]));
+            }
+            set* words = workset + lo;
+            int width = hi - lo + 1;
+            longcode = MASH(longcode, split2 - split1 + 1);
+
+            for (int cell1 = firstCell, next; cell1 < n; cell1 = next) {
+                next = nextCell[cell1];
+                int cell2;
+                for (cell2 = cell1; ptn[cell2] > level; ++cell2) {}
+                int i = cell1;
+                int cnt = countIn(words, GRAPHROW(g, lab[i], m) + lo, width);
+                int bmin, bmax;
+                count[i] = bmin = bmax = cnt;
+                bucket[cnt] = 1;
+                while (++i <= cell2) {
+                    cnt = countIn(words, GRAPHROW(g, lab[i], m) + lo, width);
+                    while (bmin > cnt) bucket[--bmin] = 0;
+                    while (bmax < cnt) bucket[++bmax] = 0;
+                    ++bucket[cnt];
+                    count[i] = cnt;
+                }
+                if (bmin == bmax) {
+                    longcode = MASH(longcode, bmin + cell1);
+                    at = &nextCell[cell1];
+                    continue;
+                }
+                int c1 = cell1;
+                int maxcell = -1, maxpos = 0;
+                for (i = bmin; i <= bmax; ++i) {
+                    if (bucket[i]) {
+                        int c2 = c1 + bucket[i];
+                        bucket[i] = c1;
+                        longcode = MASH(longcode, i + c1);
+                        if (c2 - c1 > maxcell) {
+                            maxcell = c2 - c1;
+                            maxpos = c1;
+                        }
+                        if (c1 != cell1) {
+                            ADDELEMENT(active, c1);
+                            if (c2 - c1 == 1) hint = c1;
+                            ++*numcells;
+                        }
+                        if (c2 <= cell2) ptn[c2 - 1] = level;
+                        c1 = c2;
+                    }
+                }
+                for (i = cell1; i <= cell2; ++i) workperm[bucket[count[i]]++] = lab[i];
+                for (i = cell1; i <= cell2; ++i) lab[i] = workperm[i];
+                if (!ISELEMENT(active, cell1)) {
+                    ADDELEMENT(active, cell1);
+                    DELELEMENT(active, maxpos);
+                }
+                relink(at, cell1, cell2, next);
+            }
+        }
+    }
+
+    longcode = MASH(longcode, *numcells);
+    *code = CLEANUP(longcode);
+}
+
+void refineScalar(graph* g, int* lab, int* ptn, int level, int* numcells, int* count,
+                  set* active, int* code, int m, int n) {
+    refineCells<intersectScalar>(g, lab, ptn, level, numcells, count, active, code, m, n);
+}
+
+#ifdef NAUTY_REFINE_X86
+__attribute__((target("popcnt")))
+void refinePopcnt(graph* g, int* lab, int* ptn, int level, int* numcells, int* count,
+                  set* active, int* code, int m, int n) {
+    refineCells<intersectPopcnt>(g, lab, ptn, level, numcells, count, active, code, m, n);
+}
+
+__attribute__((target("avx2,popcnt")))
+void refineAvx2(graph* g, int* lab, int* ptn, int level, int* numcells, int* count,
+                set* active, int* code, int m, int n) {
+    refineCells<intersectAvx2>(g, lab, ptn, level, numcells, count, active, code, m, n);
+}
+
+__attribute__((target("avx512f,avx512vpopcntdq")))
+void refineAvx512(graph* g, int* lab, int* ptn, int level, int* numcells, int* count,
+                  set* active, int* code, int m, int n) {
+    refineCells<intersectAvx512>(g, lab, ptn, level, numcells, count, active, code, m, n);
+}
+#endif
+
+struct Kernel {
+    const char* name;
+    IntersectFn count;
+    RefineFn refine;
+    bool (*supported)();
+};
+
+bool always() { return true; }
+
+#ifdef NAUTY_REFINE_X86
+bool havePopcnt() {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("popcnt");
+}
+
+bool haveAvx2() {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt");
+}
+
+bool haveAvx512() {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512vpopcntdq");
+}
+#endif
+
+const Kernel kernels[] = {
+    {"scalar", intersectScalar, refineScalar, always},
+#ifdef NAUTY_REFINE_X86
+    {"popcnt", intersectPopcnt, refinePopcnt, havePopcnt},
+    {"avx2", intersectAvx2, refineAvx2, haveAvx2},
+    {"avx512", intersectAvx512, refineAvx512, haveAvx512},
+#endif
+};
+const int NUM_KERNELS = sizeof(kernels) / sizeof(kernels[0]);
+
+const Kernel* bestKernel() {
+    for (int k = NUM_KERNELS - 1; k > 0; k--) {
+        if (kernels[k].supported()) return &kernels[k];
+    }
+    return &kernels[0];
+}
+
+const Kernel* kernel = bestKernel();
+
+} // namespace
+
+int intersectCount(const set* a, const set* b, int m) {
+    return kernel->count(a, b, m);
+}
+
+const char* intersectKernelName() {
+    return kernel->name;
+}
+
+bool selectIntersectKernel(const char* name) {
+    for (const Kernel& k : kernels) {
+        if (std::strcmp(k.name, name) == 0 && k.supported()) {
+            kernel = &k;
+            return true;
+        }
+    }
+    return false;
+}
+
+void refineWide(graph* g, int* lab, int* ptn, int level, int* numcells, int* count,
+                set* active, int* code, int m, int n) {
+    kernel->refine(g, lab, ptn, level, numcells, count, active, code, m, n);
+}
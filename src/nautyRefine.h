@@ -0,0 +1,27 @@
+#ifndef NAUTY_REFINE_H
+#define NAUTY_REFINE_H
+
+// Internal vectorised partition refinement for dense graphs with more than
+// one setword per row. Not part of the C API.
+
+#include "nautyCore.h"
+
+// nauty's refine() for m > 1, with identical partitions, active sets and
+// codes, counting each vertex's neighbours in the splitting cell with the
+// widest intersection popcount kernel the CPU supports. Thread-safe; its
+// work arrays are per thread. Usable as options.userrefproc.
+void refineWide(graph* g, int* lab, int* ptn, int level, int* numcells, int* count,
+                set* active, int* code, int m, int n);
+
+// Number of elements in a & b over m setwords, with the selected kernel.
+int intersectCount(const set* a, const set* b, int m);
+
+// Kernels, best last: "scalar" (nauty's POPCOUNT as built), "popcnt",
+// "avx2" and "avx512" (VPOPCNTDQ). The best one the CPU supports is chosen
+// at load time; selectIntersectKernel switches for benchmarks and tests
+// and returns false if the CPU lacks it. Not thread-safe against running
+// refinements.
+const char* intersectKernelName();
+bool selectIntersectKernel(const char* name);
+
+#endif // NAUTY_REFINE_H
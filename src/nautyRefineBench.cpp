@@ -0,0 +1,83 @@
+#include "nautyRefine.h"
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+// Times a full refinement of the unit partition of random graphs at each
+// size, with nauty's own refine and with refineWide on each kernel.
+static void usage() {
+    std::cerr << "Usage: nauty_refine_bench [-p#] [-r#]\n"
+              << "  Time partition refinement of random graphs, n = 64..2048.\n"
+              << "  -p#  edge probability in percent (default 5)\n"
+              << "  -r#  refinements per size and kernel (default 200)\n";
+}
+
+int main(int argc, char* argv[]) {
+    double p = 0.05;
+    int reps = 200;
+    for (int i = 1; i < argc; i++) {
+        if (std::strncmp(argv[i], "-p", 2) == 0 && argv[i][2]) {
+            p = std::atof(argv[i] + 2) / 100;
+        } else if (std::strncmp(argv[i], "-r", 2) == 0 && argv[i][2]) {
+            reps = std::atoi(argv[i] + 2);
+        } else {
+            usage();
+            return 1;
+        }
+    }
+
+    const char* names[] = {"nauty", "scalar", "popcnt", "avx2", "avx512"};
+    std::cout << "selected kernel: " << intersectKernelName() << "\n";
+    std::cout << "n";
+    for (const char* name : names) std::cout << "\t" << name;
+    std::cout << "\t(microseconds per refinement)\n";
+
+    FastRng rng(1);
+    for (int n = 64; n <= 2048; n *= 2) {
+        int m = SETWORDSNEEDED(n);
+        std::vector<graph> g((size_t)m * n, 0);
+        for (int i = 0; i < n; i++) {
+            for (int j = i + 1; j < n; j++) {
+                if (rng.uniform() >= p) continue;
+                ADDELEMENT(GRAPHROW(g.data(), i, m), j);
+                ADDELEMENT(GRAPHROW(g.data(), j, m), i);
+            }
+        }
+        std::vector<int> lab(n), ptn(n), count(n);
+        std::vector<setword> active(m);
+
+        std::cout << n;
+        for (const char* name : names) {
+            bool own = std::strcmp(name, "nauty") == 0;
+            if (!own && !selectIntersectKernel(name)) {
+                std::cout << "\t-";
+                continue;
+            }
+            auto start = std::chrono::steady_clock::now();
+            for (int r = 0; r < reps; r++) {
+                for (int i = 0; i < n; i++) {
+                    lab[i] = i;
+                    ptn[i] = 1;
+                }
+                ptn[n - 1] = 0;
+                EMPTYSET(active.data(), m);
+                ADDELEMENT(active.data(), 0);
+                int cells = 1, code;
+                if (own) {
+                    refine(g.data(), lab.data(), ptn.data(), 0, &cells, count.data(),
+                           active.data(), &code, m, n);
+                } else {
+                    refineWide(g.data(), lab.data(), ptn.data(), 0, &cells, count.data(),
+                               active.data(), &code, m, n);
+                }
+            }
+            double us = std::chrono::duration<double, std::micro>(
+                            std::chrono::steady_clock::now() - start).count() / reps;
+            std::cout << "\t" << us;
+        }
+        std::cout << "\n";
+    }
+    return 0;
+}
@@ -0,0 +1,301 @@
+#include "nautySchreier.h"
+#include <algorithm>
+
+int* PermPool::allocate() {
+    if (!freeList.empty()) {
+        int* perm = freeList.back();
+        freeList.pop_back();
+        return perm;
+    }
+    if (nextInChunk == PERMS_PER_CHUNK) {
+        if (chunkInUse == chunks.size()) {
+            chunks.emplace_back(new int[(size_t)PERMS_PER_CHUNK * n]);
+        }
+        chunkInUse++;
+        nextInChunk = 0;
+    }
+    return chunks[chunkInUse - 1].get() + (size_t)n * nextInChunk++;
+}
+
+void PermPool::release(int* perm) {
+    freeList.push_back(perm);
+}
+
+void PermPool::reset(int degree) {
+    if (degree != n) {
+        chunks.clear();
+        n = degree;
+    }
+    chunkInUse = 0;
+    nextInChunk = PERMS_PER_CHUNK;
+    freeList.clear();
+}
+
+size_t PermPool::retainedBytes() const {
+    return chunks.size() * PERMS_PER_CHUNK * n * sizeof(int) + freeList.capacity() * sizeof(int*);
+}
+
+SchreierGroup::SchreierGroup(int n) : n(0) {
+    for (int i = 0; i < MAX_SEGMENTS; i++) segments[i].store(nullptr, std::memory_order_relaxed);
+    reset(n);
+}
+
+SchreierGroup::~SchreierGroup() {
+    for (int i = 0; i < MAX_SEGMENTS; i++) delete segments[i].load(std::memory_order_relaxed);
+}
+
+int SchreierGroup::segmentOf(size_t i, size_t& offset) {
+    // Segments 0..s-1 hold FIRST_SEGMENT * (2^s - 1) generators.
+    size_t q = i / FIRST_SEGMENT + 1;
+    int s = 63 - __builtin_clzll(q);
+    offset = i - (size_t)FIRST_SEGMENT * (((size_t)1 << s) - 1);
+    return s;
+}
+
+void SchreierGroup::reset(int degree) {
+    size_t used = appended.load(std::memory_order_relaxed), offset;
+    int lastUsed = used ? segmentOf(used - 1, offset) : -1;
+    for (int s = 0; s < MAX_SEGMENTS; s++) {
+        Segment* seg = segments[s].load(std::memory_order_relaxed);
+        if (!seg) break;
+        if (degree > stride) {
+            // Too narrow for the new degree, including segments left over
+            // from earlier rounds past those used last time.
+            delete seg;
+            segments[s].store(nullptr, std::memory_order_relaxed);
+        } else if (s <= lastUsed) {
+            for (size_t i = 0; i < segmentSize(s); i++) {
+                seg->ready[i].store(false, std::memory_order_relaxed);
+            }
+        }
+    }
+    if (degree > stride) stride = degree;
+    n = degree;
+    appended.store(0, std::memory_order_relaxed);
+    unionConsumed = chainConsumed = 0;
+    parent.resize(n);
+    for (int i = 0; i < n; i++) parent[i] = i;
+    chain.clear();
+    pool.reset(n);
+    work1.resize(n);
+    work2.resize(n);
+}
+
+void SchreierGroup::addGenerator(const int* perm) {
+    size_t slot = appended.fetch_add(1, std::memory_order_relaxed), offset;
+    int s = segmentOf(slot, offset);
+    Segment* seg = segments[s].load(std::memory_order_acquire);
+    if (!seg) {
+        Segment* fresh = new Segment(segmentSize(s), stride);
+        if (segments[s].compare_exchange_strong(seg, fresh, std::memory_order_acq_rel)) {
+            seg = fresh;
+        } else {
+            delete fresh;
+        }
+    }
+    std::copy(perm, perm + n, seg->perms.get() + offset * stride);
+    seg->ready[offset].store(true, std::memory_order_release);
+}
+
+size_t SchreierGroup::numGenerators() const {
+    return appended.load(std::memory_order_acquire);
+}
+
+// Generator i, or null if its slot is claimed but not yet written.
+const int* SchreierGroup::generator(size_t i) const {
+    if (i >= numGenerators()) return nullptr;
+    size_t offset;
+    Segment* seg = segments[segmentOf(i, offset)].load(std::memory_order_acquire);
+    if (!seg || !seg->ready[offset].load(std::memory_order_acquire)) return nullptr;
+    return seg->perms.get() + offset * stride;
+}
+
+int SchreierGroup::find(int v) {
+    while (parent[v] != v) v = parent[v] = parent[parent[v]];
+    return v;
+}
+
+void SchreierGroup::joinOrbits(const int* perm) {
+    for (int i = 0; i < n; i++) {
+        int a = find(i), b = find(perm[i]);
+        if (a < b) {
+            parent[b] = a;
+        } else if (b < a) {
+            parent[a] = b;
+        }
+    }
+}
+
+// Fold every generator published in order so far into the orbits.
+void SchreierGroup::absorb() {
+    for (const int* g; (g = generator(unionConsumed)); unionConsumed++) joinOrbits(g);
+}
+
+int SchreierGroup::orbitRepresentative(int v) {
+    std::lock_guard<std::mutex> hold(lock);
+    absorb();
+    return find(v);
+}
+
+int SchreierGroup::orbits(int* out) {
+    std::lock_guard<std::mutex> hold(lock);
+    absorb();
+    int count = 0;
+    for (int i = 0; i < n; i++) {
+        out[i] = find(i);
+        if (out[i] == i) count++;
+    }
+    return count;
+}
+
+bool SchreierGroup::isIdentity(const int* p) const {
+    for (int i = 0; i < n; i++) {
+        if (p[i] != i) return false;
+    }
+    return true;
+}
+
+// out = the transversal element of lv taking its base point to x, a
+// product of the generators along x's path in the Schreier vector.
+void SchreierGroup::transversal(const Level& lv, int x, int* out) {
+    for (int i = 0; i < n; i++) out[i] = i;
+    std::vector<int>& path = work2;
+    int steps = 0;
+    while (x != lv.base) {
+        int k = lv.label[x];
+        path[steps++] = k;
+        x = lv.inverses[k][x];
+    }
+    while (steps > 0) {
+        const int* g = lv.gens[path[--steps]];
+        for (int i = 0; i < n; i++) out[i] = g[out[i]];
+    }
+}
+
+// Sift h through the chain from level `from`, dividing by the transversal
+// element at each level. Returns the level whose orbit does not hold the
+// image of its base point, or chain.size() if h got through; h is left as
+// the residue.
+int SchreierGroup::strip(int* h, size_t from) {
+    for (size_t l = from; l < chain.size(); l++) {
+        const Level& lv = chain[l];
+        int x = h[lv.base];
+        if (lv.label[x] == -2) return (int)l;
+        while (x != lv.base) {
+            const int* inv = lv.inverses[lv.label[x]];
+            for (int i = 0; i < n; i++) h[i] = inv[h[i]];
+            x = inv[x];
+        }
+    }
+    return (int)chain.size();
+}
+
+// Grow lv's orbit from orbit position `from` under all its generators,
+// queueing the Schreier generators of each new point.
+void SchreierGroup::extendOrbit(Level& lv, size_t from) {
+    for (size_t i = from; i < lv.orbit.size(); i++) {
+        int x = lv.orbit[i];
+        for (size_t k = 0; k < lv.gens.size(); k++) {
+            int y = lv.gens[k][x];
+            if (lv.label[y] == -2) {
+                lv.label[y] = (int)k;
+                lv.orbit.push_back(y);
+            }
+            lv.pending.emplace_back((int)i, (int)k);
+        }
+    }
+}
+
+// Add perm, which fixes the base points of levels below `level`, as a strong
+// generator of that level, opening it if it is new.
+void SchreierGroup::addStrong(size_t level, const int* perm) {
+    if (level == chain.size()) {
+        int moved = 0;
+        while (perm[moved] == moved) moved++;
+        chain.emplace_back();
+        Level& lv = chain.back();
+        lv.base = moved;
+        lv.label.assign(n, -2);
+        lv.label[moved] = -1;
+        lv.orbit.push_back(moved);
+    }
+    Level& lv = chain[level];
+    int* inverse = pool.allocate();
+    for (int i = 0; i < n; i++) inverse[perm[i]] = i;
+    int k = (int)lv.gens.size();
+    lv.gens.push_back(perm);
+    lv.inverses.push_back(inverse);
+
+    size_t before = lv.orbit.size();
+    for (size_t i = 0; i < before; i++) {
+        int y = perm[lv.orbit[i]];
+        if (lv.label[y] == -2) {
+            lv.label[y] = k;
+            lv.orbit.push_back(y);
+        }
+        lv.pending.emplace_back((int)i, k);
+    }
+    extendOrbit(lv, before);
+}
+
+// Deterministic Schreier-Sims. New generators are sifted in from the top;
+// then, deepest level first, every Schreier generator u_{s x}^-1 s u_x is
+// sifted below its level and any residue becomes a strong generator of the
+// levels it fixes. When no level has any left, the chain is complete.
+void SchreierGroup::buildChain() {
+    for (const int* g; (g = generator(chainConsumed)); chainConsumed++) {
+        int* h = pool.allocate();
+        std::copy(g, g + n, h);
+        int j = strip(h, 0);
+        if (isIdentity(h)) {
+            pool.release(h);
+            continue;
+        }
+        for (int l = 0; l <= j; l++) addStrong(l, h);
+    }
+
+    for (;;) {
+        size_t l = chain.size();
+        while (l > 0 && chain[l - 1].pending.empty()) l--;
+        if (l == 0) break;
+        Level& lv = chain[--l];
+        std::pair<int, int> pair = lv.pending.back();
+        lv.pending.pop_back();
+
+        int* h = pool.allocate();
+        transversal(lv, lv.orbit[pair.first], work1.data());
+        const int* s = lv.gens[pair.second];
+        for (int i = 0; i < n; i++) h[i] = s[work1[i]];
+        int j = strip(h, l);
+        if (isIdentity(h)) {
+            pool.release(h);
+            continue;
+        }
+        for (int k = (int)l + 1; k <= j; k++) addStrong(k, h);
+    }
+}
+
+void SchreierGroup::order(double* mantissa, int* exponent) {
+    std::lock_guard<std::mutex> hold(lock);
+    buildChain();
+    double m = 1;
+    int e = 0;
+    for (const Level& lv : chain) MULTIPLY(m, e, (double)lv.orbit.size());
+    *mantissa = m;
+    *exponent = e;
+}
+
+size_t SchreierGroup::retainedBytes() {
+    std::lock_guard<std::mutex> hold(lock);
+    size_t bytes = pool.retainedBytes() + parent.capacity() * sizeof(int);
+    for (int s = 0; s < MAX_SEGMENTS; s++) {
+        if (!segments[s].load(std::memory_order_acquire)) break;
+        bytes += sizeof(Segment) + segmentSize(s) * (stride * sizeof(int) + sizeof(bool));
+    }
+    for (const Level& lv : chain) {
+        bytes += (lv.gens.capacity() + lv.inverses.capacity()) * sizeof(int*) +
+                 (lv.orbit.capacity() + lv.label.capacity()) * sizeof(int) +
+                 lv.pending.capacity() * sizeof(std::pair<int, int>);
+    }
+    return bytes;
+}
@@ -0,0 +1,127 @@
+#ifndef NAUTY_SCHREIER_H
+#define NAUTY_SCHREIER_H
+
+// Internal re-entrant permutation group store for automorphism pruning and
+// group orders. Not part of the C API.
+
+#include "nautyCore.h"
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Permutations of one degree, carved from chunks that are kept for reuse:
+// release() puts one on a free list and reset() recycles every chunk at
+// once, so a context serving graph after graph stops allocating.
+// Not thread-safe; each SchreierGroup uses its own under its lock.
+class PermPool {
+public:
+    explicit PermPool(int n = 0) : n(n) {}
+
+    int* allocate();
+    void release(int* perm);
+    void reset(int degree);
+    size_t retainedBytes() const;
+
+private:
+    static const int PERMS_PER_CHUNK = 64;
+    int n;
+    std::vector<std::unique_ptr<int[]>> chunks;
+    size_t chunkInUse = 0;
+    int nextInChunk = PERMS_PER_CHUNK;
+    std::vector<int*> freeList;
+};
+
+// The group generated by automorphisms of one graph, as a context object in
+// place of schreier.c's per-thread globals. addGenerator may be called by
+// any number of threads at once and never blocks: generators land in
+// pooled segments claimed with one atomic increment. Each segment is twice
+// the size of the one before, so the table never fills. The queries take the
+// context's lock and first absorb every generator published since the last
+// one, so searches on several threads can share one group while other
+// threads query independent groups.
+class SchreierGroup {
+public:
+    explicit SchreierGroup(int n = 0);
+    ~SchreierGroup();
+    SchreierGroup(const SchreierGroup&) = delete;
+    SchreierGroup& operator=(const SchreierGroup&) = delete;
+
+    // Start again with the trivial group on n points. Segments and
+    // permutations are kept for reuse. Not concurrent with anything else.
+    void reset(int n);
+    int degree() const { return n; }
+
+    // Add perm (a permutation of 0..n-1, copied). Lock-free.
+    void addGenerator(const int* perm);
+    size_t numGenerators() const;
+
+    // Smallest point in v's orbit, and orbits as nauty's orbits array
+    // (each entry the smallest point of its orbit); returns the count.
+    int orbitRepresentative(int v);
+    int orbits(int* out);
+
+    // Order of the group as mantissa * 10^exponent, like nauty's grpsize1
+    // and grpsize2, from a stabiliser chain built by deterministic
+    // Schreier-Sims, so exact rather than schreier.c's random estimate.
+    void order(double* mantissa, int* exponent);
+
+    // Bytes held by segments, the chain and the pool, including reusable
+    // free space.
+    size_t retainedBytes();
+
+private:
+    // Segment s holds FIRST_SEGMENT << s generators; 40 of them hold more
+    // than memory could.
+    static const int FIRST_SEGMENT = 64;
+    static const int MAX_SEGMENTS = 40;
+
+    struct Segment {
+        explicit Segment(size_t size, int stride)
+            : ready(new std::atomic<bool>[size]), perms(new int[size * stride]) {
+            for (size_t i = 0; i < size; i++) ready[i].store(false, std::memory_order_relaxed);
+        }
+        std::unique_ptr<std::atomic<bool>[]> ready;
+        std::unique_ptr<int[]> perms;
+    };
+
+    // Segment and position within it of generator slot i.
+    static int segmentOf(size_t i, size_t& offset);
+    static size_t segmentSize(int s) { return (size_t)FIRST_SEGMENT << s; }
+
+    // One level of the stabiliser chain: the stabiliser of base points
+    // 0..i-1, with its base point's orbit as a Schreier vector.
+    struct Level {
+        int base;
+        std::vector<const int*> gens, inverses;
+        std::vector<int> orbit;
+        std::vector<int> label;    // Generator reaching each orbit point; -1 base, -2 none
+        std::vector<std::pair<int, int>> pending;  // (orbit index, generator) left to sift
+    };
+
+    const int* generator(size_t i) const;
+    void absorb();
+    int find(int v);
+    void joinOrbits(const int* perm);
+
+    void buildChain();
+    void addStrong(size_t level, const int* perm);
+    void extendOrbit(Level& lv, size_t from);
+    void transversal(const Level& lv, int x, int* out);
+    int strip(int* h, size_t from);
+    bool isIdentity(const int* p) const;
+
+    int n;
+    int stride = 0;  // Ints per generator in a segment: the largest degree so far
+    std::atomic<Segment*> segments[MAX_SEGMENTS];
+    std::atomic<size_t> appended{0};
+
+    std::mutex lock;
+    size_t unionConsumed = 0, chainConsumed = 0;
+    std::vector<int> parent;
+    std::vector<Level> chain;
+    PermPool pool;
+    std::vector<int> work1, work2;
+};
+
+#endif // NAUTY_SCHREIER_H
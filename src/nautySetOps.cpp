@@ -0,0 +1,395 @@
+#include "nautySetOps.h"
+#include "nautyMemory.h"
+#include "nautyRefine.h"
+#include <algorithm>
+#include <cstring>
+
+#if defined(__x86_64__)
+#define NAUTY_SET_OPS_X86 1
+#endif
+
+// As in naugraph.c, so codes match refine1's.
+#define MASH(l, i) ((((l) ^ 065435) + (i)) & 077777)
+#define CLEANUP(l) ((int)((l) % 077777))
+
+namespace {
+
+struct SetOpsScratch {
+    std::vector<int> workperm, bucket;
+    std::vector<setword> workset;
+
+    void reserve(int m, int n) {
+        if (workperm.size() < (size_t)n) {
+            workperm.resize(n);
+            bucket.resize(n + 2);
+        }
+        if (workset.size() < (size_t)m) workset.resize(m);
+    }
+
+    void release() {
+        freeVector(workperm);
+        freeVector(bucket);
+        freeVector(workset);
+    }
+
+    size_t bytes() const {
+        return capacityBytes(workperm) + capacityBytes(bucket) + capacityBytes(workset);
+    }
+};
+
+thread_local SetOpsScratch setOpsScratch;
+
+const bool scratchRegistered = registerScratch({
+    [](int m, int n) { setOpsScratch.reserve(m, n); },
+    [] { setOpsScratch.release(); },
+    [] { return setOpsScratch.bytes(); },
+});
+
+#define SET_OPS_INLINE __attribute__((always_inline)) inline
+
+// set2 = set1 permuted by perm, as permset() in nautil.c.
+SET_OPS_INLINE void permuteSet(const set* set1, set* set2, int m, const int* perm) {
+    EMPTYSET(set2, m);
+    for (int w = 0; w < m; ++w) {
+        setword word = set1[w];
+        while (word != 0) {
+            int b = setwordFirstBit(word);
+            word ^= BITT[b];
+            int pos = perm[TIMESWORDSIZE(w) + b];
+            ADDELEMENT(set2, pos);
+        }
+    }
+}
+
+// The bodies below are naugraph.c's, with nauty's set macros swapped for
+// the builtin primitives. Each is inlined into one copy per level.
+
+SET_OPS_INLINE boolean isautomBody(graph* g, int* perm, boolean digraph, int m, int n) {
+    set* pg = g;
+    for (int i = 0; i < n; pg += m, ++i) {
+        set* pgp = GRAPHROW(g, perm[i], m);
+        int pos = digraph ? -1 : i;
+        while ((pos = nextElement(pg, m, pos)) >= 0) {
+            if (!ISELEMENT(pgp, perm[pos])) return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+SET_OPS_INLINE int testcanlabBody(graph* g, graph* canong, int* lab, int* samerows, int m,
+                                  int n) {
+    SetOpsScratch& ss = setOpsScratch;
+    ss.reserve(m, n);
+    int* workperm = ss.workperm.data();
+    set* workset = ss.workset.data();
+
+    for (int i = 0; i < n; ++i) workperm[lab[i]] = i;
+    set* ph = canong;
+    for (int i = 0; i < n; ++i, ph += m) {
+        permuteSet(GRAPHROW(g, lab[i], m), workset, m, workperm);
+        for (int j = 0; j < m; ++j) {
+            if (workset[j] < ph[j]) {
+                *samerows = i;
+                return -1;
+            } else if (workset[j] > ph[j]) {
+                *samerows = i;
+                return 1;
+            }
+        }
+    }
+    *samerows = n;
+    return 0;
+}
+
+SET_OPS_INLINE void updatecanBody(graph* g, graph* canong, int* lab, int samerows, int m,
+                                  int n) {
+    SetOpsScratch& ss = setOpsScratch;
+    ss.reserve(m, n);
+    int* workperm = ss.workperm.data();
+
+    for (int i = 0; i < n; ++i) workperm[lab[i]] = i;
+    set* ph = GRAPHROW(canong, samerows, m);
+    for (int i = samerows; i < n; ++i, ph += m) {
+        permuteSet(GRAPHROW(g, lab[i], m), ph, m, workperm);
+    }
+}
+
+// As refine1, but the scans of ptn for the end of a cell are bit searches
+// in a mask of cell ends, only cells of two or more vertices are visited,
+// and a cell is split by a trivial splitting cell without branching on
+// adjacency. Graphs this small spend most of refine1's time mispredicting
+// those branches.
+SET_OPS_INLINE void refine1Body(graph* g, int* lab, int* ptn, int level, int* numcells,
+                                int* count, set* active, int* code, int m, int n) {
+    SetOpsScratch& ss = setOpsScratch;
+    ss.reserve(1, n);
+    int* workperm = ss.workperm.data();
+    int* bucket = ss.bucket.data();
+
+    // Bit i of ends is set when a cell ends at i; n <= WORDSIZE.
+    uint64_t ends = 0;
+    for (int i = 0; i < n; ++i) ends |= (uint64_t)(ptn[i] <= level) << i;
+    auto cellEnd = [&](int i) { return i + __builtin_ctzll(ends >> i); };
+    // Start of the first cell of two or more vertices at or after i, or n.
+    auto nextCell = [&](int i) {
+        uint64_t starts = (ends << 1 | 1) & ~ends;
+        starts = i < 64 ? starts & (~0ULL << i) : 0;
+        return starts ? std::min(n, __builtin_ctzll(starts)) : n;
+    };
+
+    long longcode = *numcells;
+    int split1 = -1, split2;
+    int hint = 0;
+    while (*numcells < n && ((split1 = hint, ISELEMENT1(active, split1)) ||
+                             (split1 = nextElement(active, 1, split1)) >= 0 ||
+                             (split1 = nextElement(active, 1, -1)) >= 0)) {
+        DELELEMENT1(active, split1);
+        split2 = cellEnd(split1);
+        longcode = MASH(longcode, split1 + split2);
+        if (split1 == split2) {
+            set* gptr = GRAPHROW(g, lab[split1], 1);
+            for (int cell1 = nextCell(0), cell2; cell1 < n; cell1 = nextCell(cell2 + 1)) {
+                cell2 = cellEnd(cell1);
+                int c1 = cell1, c2 = cell2;
+                while (c1 <= c2) {
+                    int labc1 = lab[c1], labc2 = lab[c2];
+                    bool adjacent = ISELEMENT1(gptr, labc1);
+                    lab[c1] = adjacent ? labc1 : labc2;
+                    lab[c2] = adjacent ? labc2 : labc1;
+                    c1 += adjacent;
+                    c2 -= !adjacent;
+                }
+                if (c2 >= cell1 && c1 <= cell2) {
+                    ptn[c2] = level;
+                    ends |= 1ULL << c2;
+                    longcode = MASH(longcode, c2);
+                    ++*numcells;
+                    if (ISELEMENT1(active, cell1) || c2 - cell1 >= cell2 - c1) {
+                        ADDELEMENT1(active, c1);
+                        if (c1 == cell2) hint = c1;
+                    } else {
+                        ADDELEMENT1(active, cell1);
+                        if (c2 == cell1) hint = cell1;
+                    }
+                }
+            }
+        } else {
+            setword workset0 = 0;
+            for (int i = split1; i <= split2; ++i) ADDELEMENT1(&workset0, lab[i]);
+            longcode = MASH(longcode, split2 - split1 + 1);
+
+            for (int cell1 = nextCell(0), cell2; cell1 < n; cell1 = nextCell(cell2 + 1)) {
+                cell2 = cellEnd(cell1);
+                int i = cell1;
+                int cnt = setwordPopcount(workset0 & g[lab[i]]);
+                int bmin, bmax;
+                count[i] = bmin = bmax = cnt;
+                bucket[cnt] = 1;
+                while (++i <= cell2) {
+                    cnt = setwordPopcount(workset0 & g[lab[i]]);
+                    while (bmin > cnt) bucket[--bmin] = 0;
+                    while (bmax < cnt) bucket[++bmax] = 0;
+                    ++bucket[cnt];
+                    count[i] = cnt;
+                }
+                if (bmin == bmax) {
+                    longcode = MASH(longcode, bmin + cell1);
+                    continue;
+                }
+                int c1 = cell1;
+                int maxcell = -1, maxpos = 0;
+                for (i = bmin; i <= bmax; ++i) {
+                    if (bucket[i]) {
+                        int c2 = c1 + bucket[i];
+                        bucket[i] = c1;
+                        longcode = MASH(longcode, i + c1);
+                        if (c2 - c1 > maxcell) {
+                            maxcell = c2 - c1;
+                            maxpos = c1;
+                        }
+                        if (c1 != cell1) {
+                            ADDELEMENT1(active, c1);
+                            if (c2 - c1 == 1) hint = c1;
+                            ++*numcells;
+                        }
+                        if (c2 <= cell2) {
+                            ptn[c2 - 1] = level;
+                            ends |= 1ULL << (c2 - 1);
+                        }
+                        c1 = c2;
+                    }
+                }
+                for (i = cell1; i <= cell2; ++i) workperm[bucket[count[i]]++] = lab[i];
+                for (i = cell1; i <= cell2; ++i) lab[i] = workperm[i];
+                if (!ISELEMENT1(active, cell1)) {
+                    ADDELEMENT1(active, cell1);
+                    DELELEMENT1(active, maxpos);
+                }
+            }
+        }
+    }
+
+    longcode = MASH(longcode, *numcells);
+    *code = CLEANUP(longcode);
+}
+
+// The first non-singleton cell joined non-trivially to the most others.
+SET_OPS_INLINE int bestcellBody(graph* g, int* lab, int* ptn, int level, int m, int n) {
+    SetOpsScratch& ss = setOpsScratch;
+    ss.reserve(m, n);
+    int* workperm = ss.workperm.data();
+    int* bucket = ss.bucket.data();
+    set* workset = ss.workset.data();
+
+    int nnt = 0;
+    for (int i = 0; i < n; ++i) {
+        if (ptn[i] > level) {
+            workperm[nnt++] = i;
+            while (ptn[i] > level) ++i;
+        }
+    }
+    if (nnt == 0) return n;
+
+    for (int i = nnt; --i >= 0;) bucket[i] = 0;
+    for (int v2 = 1; v2 < nnt; ++v2) {
+        EMPTYSET(workset, m);
+        int i = workperm[v2] - 1;
+        do {
+            ++i;
+            ADDELEMENT(workset, lab[i]);
+        } while (ptn[i] > level);
+        for (int v1 = 0; v1 < v2; ++v1) {
+            set* gp = GRAPHROW(g, lab[workperm[v1]], m);
+            setword in = 0, out = 0;
+            for (int w = 0; w < m; ++w) {
+                in |= workset[w] & gp[w];
+                out |= workset[w] & ~gp[w];
+            }
+            if (in != 0 && out != 0) {
+                ++bucket[v1];
+                ++bucket[v2];
+            }
+        }
+    }
+
+    int best = 0;
+    for (int i = 1; i < nnt; ++i) {
+        if (bucket[i] > bucket[best]) best = i;
+    }
+    return workperm[best];
+}
+
+SET_OPS_INLINE int targetcellBody(graph* g, int* lab, int* ptn, int level, int tc_level,
+                                  boolean digraph, int hint, int m, int n) {
+    if (hint >= 0 && ptn[hint] > level && (hint == 0 || ptn[hint - 1] <= level)) return hint;
+    if (level <= tc_level) return bestcellBody(g, lab, ptn, level, m, n);
+    int i;
+    for (i = 0; i < n && ptn[i] <= level; ++i) {}
+    return i == n ? 0 : i;
+}
+
+// One copy of every primitive compiled with the given target attribute,
+// and the dispatch vector over them.
+#define SET_OPS_LEVEL(suffix, target)                                                        \
+    target boolean isautom##suffix(graph* g, int* perm, boolean digraph, int m, int n) {    \
+        return isautomBody(g, perm, digraph, m, n);                                         \
+    }                                                                                       \
+    target int testcanlab##suffix(graph* g, graph* canong, int* lab, int* samerows, int m, \
+                                  int n) {                                                  \
+        return testcanlabBody(g, canong, lab, samerows, m, n);                              \
+    }                                                                                       \
+    target void updatecan##suffix(graph* g, graph* canong, int* lab, int samerows, int m,  \
+                                  int n) {                                                  \
+        updatecanBody(g, canong, lab, samerows, m, n);                                      \
+    }                                                                                       \
+    target void refine1##suffix(graph* g, int* lab, int* ptn, int level, int* numcells,    \
+                                int* count, set* active, int* code, int m, int n) {         \
+        refine1Body(g, lab, ptn, level, numcells, count, active, code, m, n);               \
+    }                                                                                       \
+    target int targetcell##suffix(graph* g, int* lab, int* ptn, int level, int tc_level,   \
+                                  boolean digraph, int hint, int m, int n) {                \
+        return targetcellBody(g, lab, ptn, level, tc_level, digraph, hint, m, n);           \
+    }                                                                                       \
+    target int targetFirst##suffix(graph* g, int* lab, int* ptn, int level, int tc_level,  \
+                                   boolean digraph, int hint, int m, int n) {               \
+        return targetcellBody(g, lab, ptn, level, -1, digraph, hint, m, n);                 \
+    }                                                                                       \
+    target int targetBest##suffix(graph* g, int* lab, int* ptn, int level, int tc_level,   \
+                                  boolean digraph, int hint, int m, int n) {                \
+        int bestLevel = digraph ? -1 : level;                                               \
+        return targetcellBody(g, lab, ptn, level, bestLevel, digraph, hint, m, n);          \
+    }                                                                                       \
+    dispatchvec dispatch##suffix[NUM_TARGET_STRATEGIES] = {                                 \
+        {isautom##suffix, testcanlab##suffix, updatecan##suffix, refineWide,                \
+         refine1##suffix, cheapautom,        targetcell##suffix, naugraph_freedyn,          \
+         naugraph_check,  nullptr,           nullptr},                                      \
+        {isautom##suffix, testcanlab##suffix, updatecan##suffix, refineWide,                \
+         refine1##suffix, cheapautom,        targetFirst##suffix, naugraph_freedyn,         \
+         naugraph_check,  nullptr,           nullptr},                                      \
+        {isautom##suffix, testcanlab##suffix, updatecan##suffix, refineWide,                \
+         refine1##suffix, cheapautom,        targetBest##suffix, naugraph_freedyn,          \
+         naugraph_check,  nullptr,           nullptr}};
+
+SET_OPS_LEVEL(Generic, )
+#ifdef NAUTY_SET_OPS_X86
+SET_OPS_LEVEL(Popcnt, __attribute__((target("popcnt,lzcnt"))))
+SET_OPS_LEVEL(Avx2, __attribute__((target("arch=x86-64-v3"))))
+#endif
+
+struct Level {
+    const char* name;
+    dispatchvec* dispatch;  // One per TargetStrategy
+    bool (*supported)();
+};
+
+bool always() { return true; }
+
+#ifdef NAUTY_SET_OPS_X86
+bool havePopcnt() {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("popcnt") && __builtin_cpu_supports("lzcnt");
+}
+
+bool haveAvx2() {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("x86-64-v3");
+}
+#endif
+
+const Level levels[] = {
+    {"generic", dispatchGeneric, always},
+#ifdef NAUTY_SET_OPS_X86
+    {"popcnt", dispatchPopcnt, havePopcnt},
+    {"avx2", dispatchAvx2, haveAvx2},
+#endif
+};
+const int NUM_LEVELS = sizeof(levels) / sizeof(levels[0]);
+
+const Level* bestLevel() {
+    for (int k = NUM_LEVELS - 1; k > 0; k--) {
+        if (levels[k].supported()) return &levels[k];
+    }
+    return &levels[0];
+}
+
+const Level* level = bestLevel();
+
+} // namespace
+
+dispatchvec* graphDispatch(TargetStrategy strategy) {
+    return &level->dispatch[strategy];
+}
+
+const char* setOpsName() {
+    return level->name;
+}
+
+bool selectSetOps(const char* name) {
+    for (const Level& l : levels) {
+        if (std::strcmp(l.name, name) == 0 && l.supported()) {
+            level = &l;
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,77 @@
+#ifndef NAUTY_SET_OPS_H
+#define NAUTY_SET_OPS_H
+
+// Internal set primitives and the dense-graph dispatch vector built on
+// them. Not part of the C API.
+
+#include "nautyCore.h"
+
+#if WORDSIZE > 64
+#error "nautySetOps assumes setwords of at most 64 bits"
+#endif
+
+// nauty's POPCOUNT, FIRSTBITNZ and nextelement written with compiler
+// builtins instead of the instructions configure found on the build host.
+// Inlined into a function compiled for a wider target, each becomes that
+// target's popcnt or lzcnt, so one build runs everywhere and still uses
+// them where the CPU has them.
+__attribute__((always_inline)) inline int setwordPopcount(setword x) {
+    return __builtin_popcountll((unsigned long long)x);
+}
+
+// Position of the first element (nauty's bit 0 is the top bit); x != 0.
+__attribute__((always_inline)) inline int setwordFirstBit(setword x) {
+    return __builtin_clzll((unsigned long long)x) - (64 - WORDSIZE);
+}
+
+// First element of s (m setwords) after pos, or -1; pos < 0 starts at 0.
+__attribute__((always_inline)) inline int nextElement(const set* s, int m, int pos) {
+    int w;
+    setword word;
+    if (pos < 0) {
+        w = 0;
+        word = s[0];
+    } else {
+        w = SETWD(pos);
+        word = s[w] & BITMASK(SETBT(pos));
+    }
+    for (;;) {
+        if (word != 0) return TIMESWORDSIZE(w) + setwordFirstBit(word);
+        if (++w == m) return -1;
+        word = s[w];
+    }
+}
+
+// How the search picks the cell to branch on, through the dispatch
+// vector's targetcell. Except for TARGET_NAUTY the canonical labelling
+// differs from nauty's own.
+enum TargetStrategy {
+    // As naugraph.c: bestcell at levels up to options.tc_level, which nauty
+    // sets to 0 for digraphs, else the first non-singleton cell.
+    TARGET_NAUTY,
+    // Always the first non-singleton cell, never scanning the partition.
+    TARGET_FIRST,
+    // bestcell at every level of an undirected graph. A digraph's refined
+    // partition is not equitable for in-arcs, so bestcell's choice would
+    // depend on the labelling (nauty sets tc_level to 0 for them); digraphs
+    // get the first non-singleton cell.
+    TARGET_BEST,
+};
+const int NUM_TARGET_STRATEGIES = 3;
+
+// nauty's dispatch_graph with isautom, testcanlab, updatecan, refine1 and
+// targetcell replaced by ports compiled once per instruction set level and
+// refine by refineWide. With TARGET_NAUTY the results are identical to
+// naugraph.c's. Pass it as options.dispatch; nauty copies it on entry.
+// Thread-safe; work arrays are per thread.
+dispatchvec* graphDispatch(TargetStrategy strategy = TARGET_NAUTY);
+
+// Levels, best last: "generic" (baseline for the architecture), "popcnt"
+// (popcnt and lzcnt) and "avx2" (x86-64-v3). The best one the CPU supports
+// is chosen at load time; selectSetOps switches for benchmarks and tests
+// and returns false if the CPU lacks it. Later graphDispatch() calls see
+// the switch.
+const char* setOpsName();
+bool selectSetOps(const char* name);
+
+#endif // NAUTY_SET_OPS_H
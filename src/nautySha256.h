@@ -0,0 +1,13 @@
+#ifndef NAUTY_SHA256_H
+#define NAUTY_SHA256_H
+
+// Internal SHA-256 (FIPS 180-4), used for uniqg-compatible graph hashes.
+// Not part of the C API.
+
+#include <cstddef>
+#include <cstdint>
+
+// Digest of len bytes at data.
+void sha256(const void* data, size_t len, uint8_t digest[32]);
+
+#endif // NAUTY_SHA256_H
@@ -0,0 +1,107 @@
+#include "nautyStream.h"
+#include "nautyPipeline.h"
+
+namespace {
+
+// How each graph is labelled and written.
+struct StreamOptions {
+    int outputFormat = NAUTY_OUTPUT_CANONICAL;
+    // Label as labelg does and copy the file header to the output.
+    bool labelg = false;
+    LabelgOptions labelgOptions;
+};
+
+// Canonically label one line and append the result to the batch output.
+bool classifyLine(const char* line, size_t len, const StreamOptions& opts,
+                  LabelScratch& scratch, LineBatch& batch) {
+    ParsedGraph parsed;
+    if (!parseGraphLine(line, len, scratch, parsed)) return false;
+    if (opts.labelg && parsed.header) batch.output.append(parsed.header, parsed.headerLen);
+
+    int m = parsed.m, n = parsed.n;
+    graph* canong = scratch.canong.data();
+    if (n > 0) {
+        if (opts.labelg) {
+            canonicalLabelg(scratch.g.data(), m, n, parsed.digraph, opts.labelgOptions, canong);
+        } else {
+            canonicalLabel(scratch.g.data(), m, n, parsed.digraph, scratch.lab.data(), canong,
+                           nullptr);
+        }
+    }
+
+    if (opts.outputFormat == NAUTY_OUTPUT_CANONICAL) {
+        appendGraph(parsed, canong, batch.output);
+    } else {
+        uint64_t hash[2];
+        hashGraph(canong, m, n, parsed.digraph, hash);
+        batch.output.append((const char*)hash, sizeof(hash));
+    }
+    return true;
+}
+
+int64_t runStream(const char* inputPath, const char* outputPath, const StreamOptions& opts,
+                  bool ordered, int64_t numThreads, int64_t* graphsProcessed) {
+    LineHandler handleLine = [&opts](const char* line, size_t len, LabelScratch& scratch,
+                                     LineBatch& batch) {
+        return classifyLine(line, len, opts, scratch, batch);
+    };
+    return runLinePipeline(inputPath, outputPath, ordered, numThreads, handleLine, nullptr,
+                           graphsProcessed);
+}
+
+} // namespace
+
+extern "C" {
+
+int64_t nautyClassifyStream(
+    const char* inputPath,
+    const char* outputPath,
+    int64_t outputFormat,
+    int64_t ordered,
+    int64_t numThreads,
+    int64_t* graphsProcessed
+) {
+    if (graphsProcessed) *graphsProcessed = 0;
+    if (outputFormat != NAUTY_OUTPUT_CANONICAL && outputFormat != NAUTY_OUTPUT_HASH) return -4;
+
+    StreamOptions opts;
+    opts.outputFormat = (int)outputFormat;
+    return runStream(inputPath, outputPath, opts, ordered != 0, numThreads, graphsProcessed);
+}
+
+int64_t nautyLabelStream(
+    const char* inputPath,
+    const char* outputPath,
+    const char* vertexFormat,
+    int64_t invariant,
+    int64_t minInvarLevel,
+    int64_t maxInvarLevel,
+    int64_t invarArg,
+    int64_t numThreads,
+    int64_t* graphsProcessed
+) {
+    if (graphsProcessed) *graphsProcessed = 0;
+    if (invariant < 0 || invariant >= NUM_INVARIANTS) return -4;
+
+    StreamOptions opts;
+    opts.labelg = true;
+    opts.labelgOptions.vertexFormat = vertexFormat;
+    opts.labelgOptions.invariant = (int)invariant;
+    opts.labelgOptions.minInvarLevel = (int)minInvarLevel;
+    opts.labelgOptions.maxInvarLevel = (int)maxInvarLevel;
+    opts.labelgOptions.invarArg = (int)invarArg;
+    return runStream(inputPath, outputPath, opts, true, numThreads, graphsProcessed);
+}
+
+int64_t nautyStreamStats(int64_t stats[]) {
+    const PipelineStats& last = lastPipelineStats();
+    stats[0] = last.batches;
+    stats[1] = last.readerWaits;
+    stats[2] = last.workerWaits;
+    stats[3] = last.depthSum;
+    stats[4] = last.queueCapacity;
+    stats[5] = last.writerWaits;
+    return 0;
+}
+
+} // extern "C"
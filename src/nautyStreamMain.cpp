@@ -0,0 +1,89 @@
+#include "nautyStream.h"
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+static void usage() {
+    std::cerr << "Usage: nauty_stream [-u] [-x] [-T#] [-v] [infile [outfile]]\n"
+              << "       nauty_stream -l [-i# -I#:# -K#] [-fxxx] [-T#] [-v] [infile [outfile]]\n"
+              << "  Canonically label graph6, sparse6 or digraph6 graphs in parallel.\n"
+              << "  -u   write batches as they finish instead of in input order\n"
+              << "  -x   write 16-byte binary hashes instead of canonical strings\n"
+              << "  -T#  number of worker threads (default: all cores)\n"
+              << "  -v   report how the reader, workers and writer kept up\n"
+              << "  -l   produce exactly labelg's output; -i, -I, -K and -f are\n"
+              << "       labelg's invariant and colouring options and imply -l\n";
+}
+
+int main(int argc, char* argv[]) {
+    int64_t ordered = 1;
+    int64_t format = NAUTY_OUTPUT_CANONICAL;
+    int64_t threads = 0;
+    const char* files[2] = {"-", "-"};
+    int numFiles = 0;
+    bool labelg = false;
+    bool verbose = false;
+    const char* vertexFormat = nullptr;
+    int64_t invariant = 0, minLevel = 1, maxLevel = 1, invarArg = 3;
+
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "-u") == 0) {
+            ordered = 0;
+        } else if (std::strcmp(argv[i], "-x") == 0) {
+            format = NAUTY_OUTPUT_HASH;
+        } else if (std::strncmp(argv[i], "-T", 2) == 0 && argv[i][2]) {
+            threads = std::atoll(argv[i] + 2);
+        } else if (std::strcmp(argv[i], "-v") == 0) {
+            verbose = true;
+        } else if (std::strcmp(argv[i], "-l") == 0) {
+            labelg = true;
+        } else if (std::strncmp(argv[i], "-i", 2) == 0 && argv[i][2]) {
+            labelg = true;
+            invariant = std::atoll(argv[i] + 2);
+        } else if (std::strncmp(argv[i], "-I", 2) == 0 && argv[i][2]) {
+            labelg = true;
+            const char* colon = std::strchr(argv[i], ':');
+            minLevel = std::atoll(argv[i] + 2);
+            maxLevel = colon ? std::atoll(colon + 1) : minLevel;
+        } else if (std::strncmp(argv[i], "-K", 2) == 0 && argv[i][2]) {
+            labelg = true;
+            invarArg = std::atoll(argv[i] + 2);
+        } else if (std::strncmp(argv[i], "-f", 2) == 0) {
+            labelg = true;
+            vertexFormat = argv[i] + 2;
+        } else if (argv[i][0] == '-' && argv[i][1]) {
+            usage();
+            return 1;
+        } else if (numFiles < 2) {
+            files[numFiles++] = argv[i];
+        } else {
+            usage();
+            return 1;
+        }
+    }
+
+    if (labelg && (format != NAUTY_OUTPUT_CANONICAL || !ordered)) {
+        usage();
+        return 1;
+    }
+
+    int64_t graphs = 0;
+    int64_t ret = labelg
+        ? nautyLabelStream(files[0], files[1], vertexFormat, invariant, minLevel, maxLevel,
+                           invarArg, threads, &graphs)
+        : nautyClassifyStream(files[0], files[1], format, ordered, threads, &graphs);
+    std::cerr << ">Z " << graphs << " graphs labelled" << std::endl;
+    if (verbose) {
+        int64_t stats[NAUTY_STREAM_STATS];
+        nautyStreamStats(stats);
+        double depth = stats[0] ? (double)stats[3] / stats[0] : 0;
+        std::cerr << ">Q " << stats[0] << " batches, queue depth " << depth << "/" << stats[4]
+                  << "; reader waited " << stats[1] << ", workers waited " << stats[2]
+                  << ", writer waited " << stats[5] << std::endl;
+    }
+    if (ret != 0) {
+        std::cerr << "Error: nauty_stream failed with code " << ret << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,24 @@
+#ifndef TEST_GRAPHS_H
+#define TEST_GRAPHS_H
+
+// Graph fixtures shared by the tests. Not part of the C API.
+
+#include "nautyCore.h"
+#include <vector>
+
+// A random graph in nauty's dense form, each arc (or edge) present with
+// probability p.
+inline std::vector<graph> randomGraph(FastRng& rng, int n, bool directed, double p) {
+    int m = SETWORDSNEEDED(n);
+    std::vector<graph> g((size_t)m * n, 0);
+    for (int i = 0; i < n; i++) {
+        for (int j = directed ? 0 : i + 1; j < n; j++) {
+            if (i == j || rng.uniform() >= p) continue;
+            ADDELEMENT(GRAPHROW(g.data(), i, m), j);
+            if (!directed) ADDELEMENT(GRAPHROW(g.data(), j, m), i);
+        }
+    }
+    return g;
+}
+
+#endif // TEST_GRAPHS_H
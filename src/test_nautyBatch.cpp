@@ -0,0 +1,151 @@
+#include "nautyBatch.h"
+#include "nautySetOps.h"
+#include <cassert>
+#include <iostream>
+#include <vector>
+
+static const char* KERNELS[] = {"generic", "avx2"};
+
+static uint64_t randomPacked(FastRng& rng, int k, bool directed) {
+    uint64_t packed = 0;
+    for (int i = 0; i < k; i++) {
+        for (int j = directed ? 0 : i + 1; j < k; j++) {
+            if (i == j || (rng.next() & 1) == 0) continue;
+            packed |= 1ULL << (i * k + j);
+            if (!directed) packed |= 1ULL << (j * k + i);
+        }
+    }
+    return packed;
+}
+
+// Number of cells refine1 leaves from the unit partition.
+static int refine1Cells(uint64_t packed, int k) {
+    graph g[MAX_PACKED_SIZE];
+    int lab[MAX_PACKED_SIZE], ptn[MAX_PACKED_SIZE], count[MAX_PACKED_SIZE];
+    unpackGraph(packed, k, g);
+    for (int i = 0; i < k; i++) {
+        lab[i] = i;
+        ptn[i] = 1;
+    }
+    ptn[k - 1] = 0;
+    setword active = bit[0];
+    int cells = 1, code;
+    refine1(g, lab, ptn, 0, &cells, count, &active, &code, 1, k);
+    return cells;
+}
+
+// Test case 1: lane refinement is discrete whenever refine1 is, and for
+// undirected graphs exactly then; every kernel gives the same cells.
+void testLanes() {
+    std::cout << "\nTest 1: Lockstep refinement" << std::endl;
+
+    const char* best = batchKernelName();
+    std::cout << "Selected kernel: " << best << std::endl;
+    FastRng rng(1);
+    for (int k = 1; k <= MAX_PACKED_SIZE; k++) {
+        for (int directed = 0; directed < 2; directed++) {
+            for (int trial = 0; trial < 40; trial++) {
+                int count = 1 + (int)rng.below(BATCH_LANES);
+                std::vector<uint64_t> packed(count);
+                for (uint64_t& p : packed) p = randomPacked(rng, k, directed);
+
+                std::vector<int> expected(count);
+                assert(selectBatchKernel("generic"));
+                refinePackedLanes(packed.data(), count, k, expected.data());
+                for (int l = 0; l < count; l++) {
+                    int cells = refine1Cells(packed[l], k);
+                    assert(expected[l] >= 1 && expected[l] <= k);
+                    if (cells == k) assert(expected[l] == k && "Test 1 discrete refine1");
+                    if (!directed) assert((expected[l] == k) == (cells == k) && "Test 1 filter");
+                }
+                for (const char* name : KERNELS) {
+                    if (!selectBatchKernel(name)) continue;
+                    std::vector<int> cells(count);
+                    refinePackedLanes(packed.data(), count, k, cells.data());
+                    assert(cells == expected && "Test 1 kernels should agree");
+                }
+            }
+        }
+    }
+    selectBatchKernel(best);
+}
+
+// Test case 2: batched canonical forms are nauty's, exhaustively for small
+// k and on random graphs up to k = 8.
+void testCanonical() {
+    std::cout << "\nTest 2: Batched canonical forms" << std::endl;
+
+    const char* best = batchKernelName();
+    FastRng rng(2);
+    for (int k = 2; k <= MAX_PACKED_SIZE; k++) {
+        for (int directed = 0; directed < 2; directed++) {
+            std::vector<uint64_t> packed;
+            if (k <= 4) {
+                for (uint64_t p = 0; p < (1ULL << (k * k)); p++) {
+                    bool keep = true;
+                    for (int i = 0; i < k; i++) {
+                        for (int j = 0; j < k; j++) {
+                            bool arc = (p >> (i * k + j)) & 1;
+                            if (i == j ? arc : !directed && arc != ((p >> (j * k + i)) & 1)) {
+                                keep = false;
+                            }
+                        }
+                    }
+                    if (keep) packed.push_back(p);
+                }
+            } else {
+                for (int i = 0; i < 2000; i++) packed.push_back(randomPacked(rng, k, directed));
+            }
+            std::vector<uint64_t> expected(packed.size());
+            for (size_t i = 0; i < packed.size(); i++) {
+                expected[i] = canonicalPacked(packed[i], k, directed);
+            }
+
+            for (const char* name : KERNELS) {
+                if (!selectBatchKernel(name)) continue;
+                std::vector<uint64_t> out(packed.size());
+                int64_t searched = canonicalPackedBatch(packed.data(), (int64_t)packed.size(), k,
+                                                        directed, out.data());
+                assert(out == expected && "Test 2 canonical forms should be identical");
+                assert(searched >= 0 && searched <= (int64_t)packed.size());
+                if (k == 8 && directed) {
+                    assert(searched < (int64_t)packed.size() / 2 &&
+                           "Test 2 most random digraphs skip the search");
+                }
+            }
+        }
+    }
+    selectBatchKernel(best);
+}
+
+// Test case 3: the cache's batch lookup agrees with single lookups, for
+// hits and misses alike.
+void testCache() {
+    std::cout << "\nTest 3: Batched cache lookups" << std::endl;
+
+    CanonCache cache;
+    FastRng rng(3);
+    int k = 7;
+    std::vector<uint64_t> packed(500);
+    for (uint64_t& p : packed) p = randomPacked(rng, k, false);
+    for (size_t i = 0; i < packed.size(); i += 3) cache.canonical(packed[i], k, false);
+
+    std::vector<uint64_t> out(packed.size());
+    cache.canonicalBatch(packed.data(), (int64_t)packed.size(), k, false, out.data());
+    for (size_t i = 0; i < packed.size(); i++) {
+        assert(out[i] == canonicalPacked(packed[i], k, false) && "Test 3 batch lookup");
+    }
+    assert(cache.size() <= packed.size());
+    cache.canonicalBatch(packed.data(), 0, k, false, out.data());
+}
+
+int main() {
+    std::cout << "Starting Nauty Batch Tests" << std::endl;
+
+    testLanes();
+    testCanonical();
+    testCache();
+
+    std::cout << "\nAll batch tests passed successfully!" << std::endl;
+    return 0;
+}
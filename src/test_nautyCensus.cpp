@@ -0,0 +1,273 @@
+#include "nautyCensus.h"
+#include <cassert>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+static const int MAX_CLASSES = 64;
+
+struct CensusOutput {
+    int64_t numClasses;
+    int64_t samplesUsed;
+    int64_t keys[MAX_CLASSES];
+    double freq[MAX_CLASSES], lo[MAX_CLASSES], hi[MAX_CLASSES], counts[MAX_CLASSES];
+};
+
+static int64_t registerEdges(int64_t n, const std::vector<std::pair<int, int>>& edges,
+                             bool directed) {
+    std::vector<int64_t> offsets(n + 1, 0), neighbors;
+    std::vector<std::vector<int64_t>> adj(n);
+    for (const auto& e : edges) {
+        adj[e.first].push_back(e.second);
+        if (!directed) adj[e.second].push_back(e.first);
+    }
+    for (int64_t v = 0; v < n; v++) {
+        neighbors.insert(neighbors.end(), adj[v].begin(), adj[v].end());
+        offsets[v + 1] = neighbors.size();
+    }
+    return nautyRegisterGraph(n, offsets.data(), neighbors.data(), directed ? 1 : 0);
+}
+
+static CensusOutput runCensus(int64_t id, int64_t k, int64_t budget, double target,
+                              int64_t threads) {
+    CensusOutput out;
+    out.numClasses = nautySampleCensus(id, k, budget, target, 12345, threads, MAX_CLASSES,
+                                       out.keys, out.freq, out.lo, out.hi, out.counts,
+                                       &out.samplesUsed);
+    return out;
+}
+
+// Test case 1: every triple of K5 is a triangle, and all vertex sets are
+// equally likely, so the estimate is exact.
+void testCompleteGraph() {
+    std::cout << "\nTest 1: Triangles in K5" << std::endl;
+
+    std::vector<std::pair<int, int>> edges;
+    for (int i = 0; i < 5; i++)
+        for (int j = i + 1; j < 5; j++) edges.emplace_back(i, j);
+    int64_t id = registerEdges(5, edges, false);
+    assert(id >= 0 && "Test 1 registration should succeed");
+
+    CensusOutput out = runCensus(id, 3, 2000, 0, 1);
+    assert(out.numClasses == 1 && "Test 1 should find one class");
+    assert(std::fabs(out.freq[0] - 1.0) < 1e-12 && "Test 1 frequency should be 1");
+    assert(std::fabs(out.counts[0] - 10.0) < 1e-9 && "Test 1 should estimate 10 triangles");
+    nautyReleaseGraph(id);
+}
+
+// Test case 2: the star K1,4 has 6 paths of length 2, sampled unevenly.
+void testStar() {
+    std::cout << "\nTest 2: Paths in a star" << std::endl;
+
+    int64_t id = registerEdges(5, {{0, 1}, {0, 2}, {0, 3}, {0, 4}}, false);
+    CensusOutput out = runCensus(id, 3, 2000, 0, 2);
+    assert(out.numClasses == 1 && "Test 2 should find one class");
+    assert(std::fabs(out.counts[0] - 6.0) < 1e-9 && "Test 2 should estimate 6 paths");
+    nautyReleaseGraph(id);
+}
+
+// Test case 3: estimates on a random graph agree with a brute-force census.
+void testRandomGraph() {
+    std::cout << "\nTest 3: Random graph against exact census" << std::endl;
+
+    const int n = 40;
+    std::vector<std::pair<int, int>> edges;
+    std::vector<std::vector<bool>> adj(n, std::vector<bool>(n, false));
+    srand(7);
+    for (int i = 0; i < n; i++)
+        for (int j = i + 1; j < n; j++)
+            if (rand() % 100 < 15) {
+                edges.emplace_back(i, j);
+                adj[i][j] = adj[j][i] = true;
+            }
+
+    double triangles = 0, paths = 0;
+    for (int a = 0; a < n; a++)
+        for (int b = a + 1; b < n; b++)
+            for (int c = b + 1; c < n; c++) {
+                int e = adj[a][b] + adj[a][c] + adj[b][c];
+                if (e == 3) triangles++;
+                if (e == 2) paths++;
+            }
+    double exactTriangleFreq = triangles / (triangles + paths);
+
+    int64_t id = registerEdges(n, edges, false);
+    CensusOutput out = runCensus(id, 3, 200000, 0, 2);
+    assert(out.numClasses == 2 && "Test 3 should find two classes");
+
+    for (int c = 0; c < 2; c++) {
+        bool isTriangle = __builtin_popcountll(out.keys[c]) == 6;
+        double exact = isTriangle ? triangles : paths;
+        double exactFreq = isTriangle ? exactTriangleFreq : 1 - exactTriangleFreq;
+        std::cout << (isTriangle ? "triangles" : "paths") << ": exact " << exact
+                  << ", estimate " << out.counts[c] << ", freq " << out.freq[c]
+                  << " [" << out.lo[c] << ", " << out.hi[c] << "]" << std::endl;
+        assert(std::fabs(out.counts[c] - exact) < 0.05 * exact && "Test 3 count estimate");
+        assert(out.lo[c] <= exactFreq && exactFreq <= out.hi[c] && "Test 3 CI should cover");
+    }
+    nautyReleaseGraph(id);
+}
+
+// Test case 4: early stopping uses far less than the budget.
+void testEarlyStop() {
+    std::cout << "\nTest 4: Early stopping" << std::endl;
+
+    std::vector<std::pair<int, int>> edges;
+    for (int i = 0; i < 30; i++) {
+        edges.emplace_back(i, (i + 1) % 30);
+        edges.emplace_back(i, (i + 7) % 30);
+    }
+    int64_t id = registerEdges(30, edges, false);
+    CensusOutput out = runCensus(id, 4, 10000000, 0.02, 2);
+    std::cout << "Samples used: " << out.samplesUsed << std::endl;
+
+    // Chunks are seeded by position and merged in order, so the thread count
+    // changes neither the estimate nor where sampling stops.
+    for (int threads : {1, 3, 4}) {
+        CensusOutput again = runCensus(id, 4, 10000000, 0.02, threads);
+        assert(again.samplesUsed == out.samplesUsed && again.numClasses == out.numClasses);
+        for (int c = 0; c < out.numClasses && c < MAX_CLASSES; c++)
+            assert(again.keys[c] == out.keys[c] && again.freq[c] == out.freq[c] &&
+                   "Test 4 should be deterministic");
+    }
+    assert(out.numClasses > 0 && "Test 4 should find classes");
+    assert(out.samplesUsed < 10000000 && "Test 4 should stop early");
+    for (int c = 0; c < out.numClasses && c < MAX_CLASSES; c++)
+        assert(out.hi[c] - out.lo[c] <= 0.04 + 1e-9 && "Test 4 CI should meet target");
+    nautyReleaseGraph(id);
+}
+
+// Test case 5: a directed 3-cycle is its own single class.
+void testDirectedCycle() {
+    std::cout << "\nTest 5: Directed cycle" << std::endl;
+
+    int64_t id = registerEdges(3, {{0, 1}, {1, 2}, {2, 0}}, true);
+    CensusOutput out = runCensus(id, 3, 500, 0, 1);
+    assert(out.numClasses == 1 && "Test 5 should find one class");
+    assert(__builtin_popcountll(out.keys[0]) == 3 && "Test 5 class should have 3 arcs");
+    assert(std::fabs(out.counts[0] - 1.0) < 1e-9 && "Test 5 should estimate 1 subgraph");
+    nautyReleaseGraph(id);
+}
+
+// Test case 6: the exact census agrees with brute force.
+void testExactCensus() {
+    std::cout << "\nTest 6: Exact census" << std::endl;
+
+    const int n = 25;
+    std::vector<std::pair<int, int>> edges;
+    std::vector<std::vector<bool>> adj(n, std::vector<bool>(n, false));
+    srand(11);
+    for (int i = 0; i < n; i++)
+        for (int j = i + 1; j < n; j++)
+            if (rand() % 100 < 20) {
+                edges.emplace_back(i, j);
+                adj[i][j] = adj[j][i] = true;
+            }
+
+    // Connected 4-sets: the induced graph has 3+ edges and no isolated vertex
+    // (3 edges with no isolated vertex on 4 vertices is always a tree).
+    int64_t connected = 0;
+    for (int a = 0; a < n; a++)
+        for (int b = a + 1; b < n; b++)
+            for (int c = b + 1; c < n; c++)
+                for (int d = c + 1; d < n; d++) {
+                    int v[4] = {a, b, c, d}, e = 0, isolated = 0;
+                    for (int i = 0; i < 4; i++) {
+                        int deg = 0;
+                        for (int j = 0; j < 4; j++) deg += adj[v[i]][v[j]];
+                        e += deg;
+                        isolated += deg == 0;
+                    }
+                    if (e / 2 >= 3 && !isolated) connected++;
+                }
+
+    int64_t id = registerEdges(n, edges, false);
+    int64_t keys[MAX_CLASSES], counts[MAX_CLASSES];
+    int64_t numClasses = nautyExactCensus(id, 4, 2, MAX_CLASSES, keys, counts);
+    assert(numClasses > 0 && numClasses <= 6 && "Test 6 should find at most 6 classes");
+
+    int64_t total = 0;
+    for (int c = 0; c < numClasses; c++) total += counts[c];
+    std::cout << "Connected 4-subgraphs: exact " << connected << ", census " << total
+              << std::endl;
+    assert(total == connected && "Test 6 total should match brute force");
+    nautyReleaseGraph(id);
+}
+
+// Test case 7: triangles are over-represented in a union of triangles
+// compared with degree-preserving randomisations (random 2-regular graphs).
+void testSignificance() {
+    std::cout << "\nTest 7: Motif significance" << std::endl;
+
+    std::vector<std::pair<int, int>> edges;
+    for (int t = 0; t < 20; t++) {
+        edges.emplace_back(3 * t, 3 * t + 1);
+        edges.emplace_back(3 * t + 1, 3 * t + 2);
+        edges.emplace_back(3 * t + 2, 3 * t);
+    }
+    int64_t id = registerEdges(60, edges, false);
+
+    int64_t keys[MAX_CLASSES], keys2[MAX_CLASSES];
+    double observed[MAX_CLASSES], mean[MAX_CLASSES], sd[MAX_CLASSES], z[MAX_CLASSES];
+    double observed2[MAX_CLASSES], mean2[MAX_CLASSES], sd2[MAX_CLASSES], z2[MAX_CLASSES];
+    int64_t numClasses = nautyMotifSignificance(id, 3, 50, 10, 0, 99, 2, MAX_CLASSES,
+                                                keys, observed, mean, sd, z);
+    assert(numClasses == 2 && "Test 7 should find triangles and paths");
+
+    for (int c = 0; c < 2; c++) {
+        bool isTriangle = __builtin_popcountll(keys[c]) == 6;
+        std::cout << (isTriangle ? "triangles" : "paths") << ": observed " << observed[c]
+                  << ", random " << mean[c] << " +- " << sd[c] << ", z " << z[c] << std::endl;
+        if (isTriangle) {
+            assert(observed[c] == 20 && "Test 7 observed triangles");
+            assert(z[c] > 2 && "Test 7 triangles should be significant");
+        } else {
+            assert(observed[c] == 0 && z[c] < 0 && "Test 7 paths should be rare");
+        }
+    }
+
+    // Replicates are seeded by index, so the thread count does not matter.
+    nautyMotifSignificance(id, 3, 50, 10, 0, 99, 1, MAX_CLASSES,
+                           keys2, observed2, mean2, sd2, z2);
+    for (int c = 0; c < 2; c++)
+        assert(keys[c] == keys2[c] && mean[c] == mean2[c] && "Test 7 should be deterministic");
+
+    // So is a sampled census, observed counts included.
+    nautyMotifSignificance(id, 3, 8, 10, 5000, 99, 3, MAX_CLASSES, keys, observed, mean, sd, z);
+    nautyMotifSignificance(id, 3, 8, 10, 5000, 99, 1, MAX_CLASSES,
+                           keys2, observed2, mean2, sd2, z2);
+    for (int c = 0; c < 2; c++)
+        assert(keys[c] == keys2[c] && observed[c] == observed2[c] && z[c] == z2[c] &&
+               "Test 7 sampled significance should be deterministic");
+    nautyReleaseGraph(id);
+}
+
+// Test case 8: invalid arguments
+void testInvalidArguments() {
+    std::cout << "\nTest 8: Invalid arguments" << std::endl;
+
+    int64_t id = registerEdges(2, {{0, 1}}, false);
+    assert(runCensus(id + 1000, 3, 10, 0, 1).numClasses == -1 && "Unknown graph id");
+    assert(runCensus(id, 9, 10, 0, 1).numClasses == -2 && "Motif size too large");
+    assert(runCensus(id, 3, 0, 0, 1).numClasses == -3 && "Empty sample budget");
+    assert(nautyMotifSignificance(id, 3, 0, 1, 0, 1, 1, 0, nullptr, nullptr, nullptr,
+                                  nullptr, nullptr) == -4 && "No replicates");
+    assert(nautyReleaseGraph(id) == 0 && nautyReleaseGraph(id) == -1 && "Release once");
+}
+
+int main() {
+    std::cout << "Starting Nauty Census Tests" << std::endl;
+
+    testCompleteGraph();
+    testStar();
+    testRandomGraph();
+    testEarlyStop();
+    testDirectedCycle();
+    testExactCensus();
+    testSignificance();
+    testInvalidArguments();
+
+    std::cout << "\nAll census tests passed successfully!" << std::endl;
+    return 0;
+}
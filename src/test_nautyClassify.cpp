@@ -1,4 +1,7 @@
 #include "nautyClassify.h"
+#include "nautyCore.h"
+#include <algorithm>
+#include <cassert>
 #include <iostream>
 #include <iomanip>
 #include <vector>
@@ -20,6 +23,178 @@ void printResults(int64_t* results, int size) {
     std::cout << std::endl;
 }
 
+// Labellings taken by the refinement fast path are nauty's, for one- and
+// two-word rows, and the stats count them.
+void testFastPath() {
+    std::cout << "\n===== Testing Discrete Refinement Fast Path =====\n";
+
+    int64_t stats[NAUTY_CLASSIFY_STATS];
+    nautyClassifyStats(stats, 1);
+    FastRng rng(44);
+    int64_t total = 0;
+    for (int n : {3, 5, 8, 20, 64, 65, 90}) {
+        for (int trial = 0; trial < 50; trial++) {
+            std::vector<int64_t> matrix(n * n, 0);
+            for (int i = 0; i < n; i++) {
+                for (int j = 0; j < n; j++) {
+                    if (i != j && rng.below(trial % 2 ? 2 : 8) == 0) matrix[i * n + j] = 1;
+                }
+            }
+            std::vector<int64_t> results(n);
+            assert(nautyClassify(matrix.data(), n, results.data(), 0, 0, 1) == 0);
+            total++;
+
+            int m = SETWORDSNEEDED(n);
+            std::vector<graph> g(m * n, 0), canong(m * n);
+            std::vector<int> lab(n);
+            for (int i = 0; i < n; i++) {
+                for (int j = 0; j < n; j++) {
+                    if (matrix[i * n + j]) ADDELEMENT(GRAPHROW(g.data(), i, m), j);
+                }
+            }
+            canonicalLabel(g.data(), m, n, true, lab.data(), canong.data(), nullptr);
+            for (int i = 0; i < n; i++) {
+                assert(results[i] == lab[i] && "fast path labelling should be nauty's");
+            }
+        }
+    }
+
+    nautyClassifyStats(stats, 1);
+    std::cout << "Labelled by refinement alone: " << stats[1] << " of " << stats[0] << std::endl;
+    assert(stats[0] == total);
+    assert(stats[1] > 0 && stats[1] < stats[0]);
+    nautyClassifyStats(stats, 0);
+    assert(stats[0] == 0 && stats[1] == 0);
+}
+
+// The matrix relabelled by a labelling from results.
+static std::vector<int64_t> relabel(const int64_t* matrix, const int64_t* lab, int n) {
+    std::vector<int64_t> out(n * n);
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j < n; j++) out[i * n + j] = matrix[lab[i] * n + lab[j]];
+    }
+    return out;
+}
+
+// Append matrix and a randomly relabelled copy of it to batch.
+static void appendPair(std::vector<int64_t>& batch, const std::vector<int64_t>& matrix, int n,
+                       FastRng& rng) {
+    std::vector<int> perm(n);
+    for (int i = 0; i < n; i++) perm[i] = i;
+    for (int i = n - 1; i > 0; i--) std::swap(perm[i], perm[rng.below(i + 1)]);
+    std::vector<int64_t> shuffled(n * n);
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j < n; j++) shuffled[perm[i] * n + perm[j]] = matrix[i * n + j];
+    }
+    batch.insert(batch.end(), matrix.begin(), matrix.end());
+    batch.insert(batch.end(), shuffled.begin(), shuffled.end());
+}
+
+// Whether each pair from appendPair got the same canonical form.
+static bool pairsAgree(const std::vector<int64_t>& batch, const std::vector<int64_t>& results,
+                       int n) {
+    int graphs = (int)(batch.size() / (n * n));
+    for (int g = 0; g < graphs; g += 2) {
+        if (relabel(&batch[g * n * n], &results[g * n], n) !=
+            relabel(&batch[(g + 1) * n * n], &results[(g + 1) * n], n)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Every invariant gives isomorphic graphs the same canonical form, and auto
+// mode labels the batch as its reported choice does.
+void testInvariants() {
+    std::cout << "\n===== Testing Vertex Invariants =====\n";
+
+    // Circulants (regular, so refinement alone gets nowhere), random
+    // digraphs, and a shuffled copy of each.
+    const int n = 12;
+    FastRng rng(45);
+    std::vector<int64_t> batch;
+    int graphs = 0;
+    for (int round = 0; round < 6; round++) {
+        std::vector<int64_t> matrix(n * n, 0);
+        for (int i = 0; i < n; i++) {
+            for (int j = 0; j < n; j++) {
+                int d = (j - i + n) % n;
+                bool arc = round < 3 ? (d == 1 || d == n - 1 || d == round + 2 || d == n - round - 2)
+                                     : i != j && rng.below(3) == 0;
+                matrix[i * n + j] = arc;
+            }
+        }
+        appendPair(batch, matrix, n, rng);
+        graphs += 2;
+    }
+
+    std::vector<int64_t> results(graphs * n), plain(n);
+    for (int invariant = 0; invariant < 17; invariant++) {
+        assert(nautyClassifyInvariant(batch.data(), n, results.data(), graphs, invariant, 1, 1,
+                                      3, nullptr) == 0);
+        assert(pairsAgree(batch, results, n) && "isomorphic graphs should have one canonical form");
+        for (int g = 0; g < graphs && invariant == 0; g++) {
+            assert(nautyClassify(&batch[g * n * n], n, plain.data(), 0, 0, 1) == 0);
+            for (int i = 0; i < n; i++) assert(results[g * n + i] == plain[i]);
+        }
+    }
+
+    int64_t chosen[4];
+    std::vector<int64_t> again(graphs * n);
+    assert(nautyClassifyInvariant(batch.data(), n, results.data(), graphs, NAUTY_INVARIANT_AUTO,
+                                  0, 0, 0, chosen) == 0);
+    std::cout << "Auto mode chose invariant " << chosen[0] << " at levels " << chosen[1] << ":"
+              << chosen[2] << std::endl;
+    assert(nautyClassifyInvariant(batch.data(), n, again.data(), graphs, chosen[0], chosen[1],
+                                  chosen[2], chosen[3], nullptr) == 0);
+    assert(again == results && "auto mode should label as its choice does");
+
+    assert(nautyClassifyInvariant(batch.data(), n, results.data(), graphs, 17, 1, 1, 3,
+                                  nullptr) == -4);
+    assert(nautyClassifyInvariant(batch.data(), 0, results.data(), graphs, 0, 1, 1, 3,
+                                  nullptr) == -1);
+}
+
+// Every profile gives isomorphic graphs the same canonical form, on small
+// and two-word graphs, directed and not; "default" is nautyClassify.
+void testProfiles() {
+    std::cout << "\n===== Testing Search Profiles =====\n";
+
+    FastRng rng(46);
+    for (int n : {10, 70}) {
+        std::vector<int64_t> batch;
+        for (int round = 0; round < 8; round++) {
+            std::vector<int64_t> matrix(n * n, 0);
+            for (int i = 0; i < n; i++) {
+                for (int j = i + 1; j < n; j++) {
+                    int d = j - i;
+                    bool arc = round < 4 ? d == 1 || d == n - 1 || d == round + 2 ||
+                                               d == n - round - 2
+                                         : rng.below(n / 3) == 0;
+                    matrix[i * n + j] = arc;
+                    // Half the random graphs are directed.
+                    matrix[j * n + i] = round < 6 ? arc : rng.below(n / 3) == 0;
+                }
+            }
+            appendPair(batch, matrix, n, rng);
+        }
+        int graphs = (int)(batch.size() / (n * n));
+
+        std::vector<int64_t> results(graphs * n), plain(n);
+        for (const char* profile : {"default", "tiny-motif", "sparse-large", "regular-hard"}) {
+            assert(nautyClassifyProfile(batch.data(), n, results.data(), graphs, profile) == 0);
+            assert(pairsAgree(batch, results, n) && "profiles should give one canonical form");
+        }
+        assert(nautyClassifyProfile(batch.data(), n, results.data(), graphs, "default") == 0);
+        for (int g = 0; g < graphs; g++) {
+            assert(nautyClassify(&batch[g * n * n], n, plain.data(), 0, 0, 1) == 0);
+            for (int i = 0; i < n; i++) assert(results[g * n + i] == plain[i]);
+        }
+        assert(nautyClassifyProfile(batch.data(), n, results.data(), graphs, "fast") == -4);
+        assert(nautyClassifyProfile(batch.data(), n, results.data(), graphs, nullptr) == -4);
+    }
+}
+
 int main() {
     // Test parameters
     const int k = 3;  // Motif size
@@ -97,6 +272,10 @@ int main() {
     // Clean up
     delete[] batchedMatrices;
     delete[] batchedResults;
-    
+
+    testFastPath();
+    testInvariants();
+    testProfiles();
+
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,263 @@
+#include "nautyContainer.h"
+#include "nautyDedup.h"
+#include "nautyCore.h"
+#include <gtools.h>
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <set>
+#include <string>
+#include <vector>
+
+static std::string inputPath = "/tmp/nauty_container_test_in.g6";
+static std::string classesPath = "/tmp/nauty_container_test_classes.g6";
+static std::string containerPath = "/tmp/nauty_container_test.ngc";
+
+typedef std::vector<int64_t> Matrix;   // n*n, row-major
+
+static Matrix randomMatrix(FastRng& rng, int n, bool directed, double p) {
+    Matrix adj((size_t)n * n, 0);
+    for (int i = 0; i < n; i++) {
+        for (int j = directed ? 0 : i + 1; j < n; j++) {
+            if (i == j || rng.uniform() >= p) continue;
+            adj[i * n + j] = 1;
+            if (!directed) adj[j * n + i] = 1;
+        }
+    }
+    return adj;
+}
+
+static std::vector<graph> toRows(const Matrix& adj, int n) {
+    int m = SETWORDSNEEDED(n);
+    std::vector<graph> g((size_t)m * n + 1, 0);
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j < n; j++) {
+            if (adj[i * n + j]) ADDELEMENT(GRAPHROW(g.data(), i, m), j);
+        }
+    }
+    return g;
+}
+
+static std::string encode(const Matrix& adj, int n, bool directed) {
+    int m = SETWORDSNEEDED(n);
+    std::vector<graph> g = toRows(adj, n);
+    return directed ? ntod6(g.data(), m, n) : ntog6(g.data(), m, n);
+}
+
+static void writeLines(const std::string& path, const std::vector<std::string>& lines) {
+    std::ofstream f(path);
+    for (const std::string& line : lines) f << line;
+}
+
+// Test case 1: a dense container returns every graph as written, through
+// both the copying and the zero-copy accessors.
+void testDenseRoundTrip() {
+    std::cout << "\nTest 1: Dense round trip" << std::endl;
+
+    const int N = 12, COUNT = 300;
+    FastRng rng(3);
+    std::vector<Matrix> graphs;
+    std::vector<std::string> lines;
+    for (int i = 0; i < COUNT; i++) {
+        graphs.push_back(randomMatrix(rng, N, false, 0.4));
+        lines.push_back(encode(graphs.back(), N, false));
+    }
+    writeLines(inputPath, lines);
+
+    int64_t written = 0;
+    int64_t ret = nautyContainerWrite(inputPath.c_str(), containerPath.c_str(),
+                                      NAUTY_CONTAINER_DENSE, 0, 0, 2, &written);
+    assert(ret == 0 && written == COUNT && "Test 1 write should succeed");
+
+    int64_t id = nautyContainerOpen(containerPath.c_str());
+    assert(id >= 0 && nautyContainerCount(id) == COUNT && "Test 1 open");
+    Matrix adj(N * N);
+    for (int i = 0; i < COUNT; i++) {
+        assert(nautyContainerGraph(id, i, adj.data(), N) == N && adj == graphs[i] &&
+               "Test 1 graphs should round trip in order");
+        int64_t n = 0, m = 0;
+        const uint64_t* rows = nautyContainerRows(id, i, &n, &m);
+        std::vector<graph> expected = toRows(graphs[i], N);
+        assert(rows && n == N && m == 1 && std::equal(rows, rows + N, expected.begin()) &&
+               "Test 1 rows should be nauty's setwords");
+    }
+    assert(nautyContainerGraph(id, 0, adj.data(), N - 1) == -3 && "Test 1 small buffer");
+    assert(nautyContainerGraph(id, COUNT, adj.data(), N) == -2 && "Test 1 out of range");
+    const uint32_t* offsets;
+    const uint32_t* targets;
+    assert(nautyContainerCsr(id, 0, &offsets, &targets) == -3 && "Test 1 dense has no CSR");
+    assert(nautyContainerClose(id) == 0 && nautyContainerCount(id) == -1 && "Test 1 close");
+}
+
+// Test case 2: a CSR container holds graphs of mixed sizes, including ones
+// needing several setwords per row, and digraphs.
+void testCsrRoundTrip() {
+    std::cout << "\nTest 2: CSR round trip" << std::endl;
+
+    FastRng rng(5);
+    for (bool directed : {false, true}) {
+        std::vector<Matrix> graphs;
+        std::vector<int> sizes;
+        std::vector<std::string> lines;
+        for (int i = 0; i < 120; i++) {
+            int n = 1 + (int)rng.below(150);
+            sizes.push_back(n);
+            graphs.push_back(randomMatrix(rng, n, directed, 0.1));
+            lines.push_back(encode(graphs.back(), n, directed));
+        }
+        writeLines(inputPath, lines);
+
+        assert(nautyContainerWrite(inputPath.c_str(), containerPath.c_str(),
+                                   NAUTY_CONTAINER_CSR, 0, 0, 2, nullptr) == 0);
+        int64_t id = nautyContainerOpen(containerPath.c_str());
+        assert(id >= 0 && nautyContainerCount(id) == (int64_t)graphs.size());
+        for (size_t i = 0; i < graphs.size(); i++) {
+            int n = sizes[i];
+            Matrix adj((size_t)n * n);
+            assert(nautyContainerGraph(id, i, adj.data(), n) == n && adj == graphs[i] &&
+                   "Test 2 graphs should round trip");
+
+            const uint32_t* offsets;
+            const uint32_t* targets;
+            assert(nautyContainerCsr(id, i, &offsets, &targets) == n);
+            Matrix fromCsr((size_t)n * n, 0);
+            for (int v = 0; v < n; v++) {
+                for (uint32_t a = offsets[v]; a < offsets[v + 1]; a++) {
+                    fromCsr[v * n + targets[a]] = 1;
+                }
+            }
+            assert(fromCsr == graphs[i] && "Test 2 zero-copy CSR should match");
+        }
+        int64_t n, m;
+        assert(nautyContainerRows(id, 0, &n, &m) == nullptr && "Test 2 CSR has no rows");
+        nautyContainerClose(id);
+    }
+}
+
+// Test case 3: a canonical library of the 34 classes on 5 vertices finds
+// every labelled 5-vertex graph, in either layout.
+void testFind() {
+    std::cout << "\nTest 3: Find by canonical form" << std::endl;
+
+    const int N = 5;
+    std::vector<Matrix> labelled;
+    std::vector<std::string> lines;
+    for (int e = 0; e < 1024; e++) {
+        Matrix adj(N * N, 0);
+        int bit = 0;
+        for (int j = 1; j < N; j++) {
+            for (int i = 0; i < j; i++, bit++) {
+                if (e >> bit & 1) adj[i * N + j] = adj[j * N + i] = 1;
+            }
+        }
+        labelled.push_back(adj);
+        lines.push_back(encode(adj, N, false));
+    }
+    writeLines(inputPath, lines);
+    int64_t classes = 0;
+    nautyDedupStream(inputPath.c_str(), classesPath.c_str(), NAUTY_DEDUP_INPUT,
+                     NAUTY_HASH_FAST, 128, 2, nullptr, &classes);
+    assert(classes == 34);
+
+    for (int64_t layout : {NAUTY_CONTAINER_DENSE, NAUTY_CONTAINER_CSR}) {
+        assert(nautyContainerWrite(classesPath.c_str(), containerPath.c_str(), layout, 1, 1, 2,
+                                   nullptr) == 0);
+        int64_t id = nautyContainerOpen(containerPath.c_str());
+        assert(id >= 0 && nautyContainerCount(id) == 34);
+
+        std::set<int64_t> found;
+        Matrix stored(N * N);
+        for (Matrix& adj : labelled) {
+            int64_t i = nautyContainerFind(id, adj.data(), N);
+            assert(i >= 0 && i < 34 && "Test 3 every graph should be found");
+            // The stored graph is canonical, so it finds itself.
+            nautyContainerGraph(id, i, stored.data(), N);
+            assert(nautyContainerFind(id, stored.data(), N) == i && "Test 3 same class");
+            int edges = 0, storedEdges = 0;
+            for (int k = 0; k < N * N; k++) {
+                edges += adj[k];
+                storedEdges += stored[k];
+            }
+            assert(edges == storedEdges && "Test 3 class should have the same edges");
+            found.insert(i);
+        }
+        assert(found.size() == 34 && "Test 3 every class should be hit");
+
+        Matrix six(36, 0);
+        assert(nautyContainerFind(id, six.data(), 6) == -3 && "Test 3 absent graph");
+        nautyContainerClose(id);
+    }
+
+    assert(nautyContainerWrite(classesPath.c_str(), containerPath.c_str(),
+                               NAUTY_CONTAINER_DENSE, 1, 0, 1, nullptr) == 0);
+    int64_t id = nautyContainerOpen(containerPath.c_str());
+    assert(nautyContainerFind(id, labelled[0].data(), N) == -2 && "Test 3 no hash column");
+    nautyContainerClose(id);
+}
+
+// Test case 4: invalid input and damaged files
+void testErrors() {
+    std::cout << "\nTest 4: Errors" << std::endl;
+
+    FastRng rng(9);
+    writeLines(inputPath, {encode(randomMatrix(rng, 6, false, 0.5), 6, false),
+                           encode(randomMatrix(rng, 7, false, 0.5), 7, false)});
+    const char* in = inputPath.c_str();
+    const char* out = containerPath.c_str();
+    assert(nautyContainerWrite(in, out, NAUTY_CONTAINER_DENSE, 0, 0, 1, nullptr) == -5 &&
+           "Test 4 dense needs one size");
+    assert(!std::ifstream(out) && "Test 4 failed write removes the output");
+    assert(nautyContainerWrite(in, out, NAUTY_CONTAINER_CSR, 0, 0, 1, nullptr) == 0 &&
+           "Test 4 CSR allows mixed sizes");
+    writeLines(inputPath, {encode(randomMatrix(rng, 6, false, 0.5), 6, false),
+                           encode(randomMatrix(rng, 6, true, 0.5), 6, true)});
+    assert(nautyContainerWrite(in, out, NAUTY_CONTAINER_CSR, 0, 0, 1, nullptr) == -5 &&
+           "Test 4 mixed directedness");
+    assert(nautyContainerWrite(in, out, 7, 0, 0, 1, nullptr) == -4 && "Test 4 bad layout");
+    assert(nautyContainerWrite("/nonexistent/in", out, 0, 0, 0, 1, nullptr) == -1);
+    assert(nautyContainerWrite(in, "-", 0, 0, 0, 1, nullptr) == -2 && "Test 4 stdout output");
+    assert(nautyContainerWrite(in, "/tmp", 0, 0, 0, 1, nullptr) == -2 && "Test 4 directory");
+    assert(nautyContainerWrite(in, "/dev/null", 0, 0, 0, 1, nullptr) == -2 && "Test 4 device");
+
+    writeLines(inputPath, {"not a container, but long enough to have a header......\n"});
+    assert(nautyContainerOpen(in) == -2 && "Test 4 bad magic");
+    assert(nautyContainerOpen("/nonexistent/c") == -1 && "Test 4 missing file");
+    assert(nautyContainerClose(12345) == -1 && nautyContainerCount(12345) == -1);
+
+    // Offsets near 2^64 would wrap offset + length back inside the file.
+    writeLines(inputPath, {encode(randomMatrix(rng, 6, false, 0.5), 6, false)});
+    const uint64_t wrapping = ~(uint64_t)7;
+    for (long field : {40L, 48L}) {   // indexOffset, hashOffset
+        assert(nautyContainerWrite(in, out, NAUTY_CONTAINER_DENSE, 1, 1, 1, nullptr) == 0);
+        {
+            std::fstream f(out, std::ios::in | std::ios::out | std::ios::binary);
+            f.seekp(field);
+            f.write((const char*)&wrapping, sizeof(wrapping));
+        }
+        assert(nautyContainerOpen(out) == -2 && "Test 4 damaged offset");
+    }
+
+    // An empty input gives an empty, valid container.
+    writeLines(inputPath, {});
+    assert(nautyContainerWrite(in, out, NAUTY_CONTAINER_DENSE, 1, 1, 1, nullptr) == 0);
+    int64_t id = nautyContainerOpen(out);
+    assert(id >= 0 && nautyContainerCount(id) == 0 && "Test 4 empty container");
+    nautyContainerClose(id);
+}
+
+int main() {
+    std::cout << "Starting Nauty Container Tests" << std::endl;
+
+    testDenseRoundTrip();
+    testCsrRoundTrip();
+    testFind();
+    testErrors();
+    std::remove(inputPath.c_str());
+    std::remove(classesPath.c_str());
+    std::remove(containerPath.c_str());
+
+    std::cout << "\nAll container tests passed successfully!" << std::endl;
+    return 0;
+}
@@ -0,0 +1,396 @@
+#include "nautyDedup.h"
+#include "nautyCore.h"
+#include "nautyExternalSort.h"
+#include "nautyHashSet.h"
+#include "nautySha256.h"
+#include "nautyStream.h"
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <iostream>
+#include <map>
+#include <set>
+#include <string>
+#include <thread>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+static std::string inputPath = "/tmp/nauty_dedup_test_in.g6";
+static std::string outputPath = "/tmp/nauty_dedup_test_out";
+
+static std::vector<std::string> readLines(const std::string& path) {
+    std::ifstream f(path);
+    std::vector<std::string> lines;
+    std::string line;
+    while (std::getline(f, line)) lines.push_back(line);
+    return lines;
+}
+
+static std::string hex(const uint8_t* p, int len) {
+    std::string s;
+    char buf[3];
+    for (int i = 0; i < len; i++) {
+        std::snprintf(buf, sizeof(buf), "%02x", p[i]);
+        s += buf;
+    }
+    return s;
+}
+
+// All graphs on 5 vertices as graph6 (1024 labelled graphs, 34 classes),
+// each edge set written twice under different vertex orders.
+static const int NUM_LABELLED = 1024;
+static const int NUM_CLASSES = 34;
+
+static std::string encode5(int edges) {
+    // Upper triangle by columns: (0,1) (0,2) (1,2) (0,3) (1,3) (2,3) (0,4) ...
+    std::string s(1, (char)(63 + 5));
+    int bits[10];
+    for (int b = 0; b < 10; b++) bits[b] = (edges >> b) & 1;
+    s += (char)(63 + (bits[0] << 5 | bits[1] << 4 | bits[2] << 3 | bits[3] << 2 |
+                      bits[4] << 1 | bits[5]));
+    s += (char)(63 + (bits[6] << 5 | bits[7] << 4 | bits[8] << 3 | bits[9] << 2));
+    return s;
+}
+
+static void writeInput() {
+    std::ofstream f(inputPath);
+    f << ">>graph6<<";
+    for (int e = 0; e < NUM_LABELLED; e++) f << encode5(e) << "\n";
+    for (int e = NUM_LABELLED - 1; e >= 0; e--) f << encode5(e) << "\n";
+}
+
+// Test case 1: SHA-256 known answers.
+void testSha256() {
+    std::cout << "\nTest 1: SHA-256" << std::endl;
+
+    uint8_t digest[32];
+    sha256("", 0, digest);
+    assert(hex(digest, 32) ==
+           "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855");
+    sha256("abc", 3, digest);
+    assert(hex(digest, 32) ==
+           "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad");
+    const char* two = "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq";
+    sha256(two, std::strlen(two), digest);
+    assert(hex(digest, 32) ==
+           "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1");
+}
+
+// Test case 2: the flat set agrees with std::set through several resizes,
+// for both key widths.
+void testFlatHashSet() {
+    std::cout << "\nTest 2: Flat hash set" << std::endl;
+
+    for (int words : {2, 4}) {
+        FlatHashSet set(words);
+        std::set<std::vector<uint64_t>> reference;
+        srand(words);
+        for (int i = 0; i < 300000; i++) {
+            // Few distinct values, so most inserts are duplicates.
+            uint64_t v = (uint64_t)(rand() % 100000);
+            std::vector<uint64_t> key(words);
+            for (int w = 0; w < words; w++) key[w] = (v + w) * 0x9e3779b97f4a7c15ULL;
+            bool isNew = reference.insert(key).second;
+            assert(set.insert(key.data()) == isNew && "Test 2 insert should match std::set");
+        }
+        assert(set.size() == reference.size() && "Test 2 sizes should match");
+        for (const auto& key : reference) assert(set.contains(key.data()));
+        std::cout << words * 64 << "-bit keys: " << set.size() << " keys, "
+                  << set.memoryBytes() / set.size() << " bytes per key" << std::endl;
+    }
+}
+
+// Test case 3: sharded inserts agree with a single table, including equal
+// keys within one batch.
+void testShardedHashSet() {
+    std::cout << "\nTest 3: Sharded hash set" << std::endl;
+
+    ShardedHashSet sharded(2, 4);
+    FlatHashSet single(2);
+    srand(9);
+    for (int batch = 0; batch < 20; batch++) {
+        size_t count = 1 + rand() % 20000;
+        std::vector<uint64_t> keys(2 * count);
+        for (size_t i = 0; i < count; i++) {
+            uint64_t v = (uint64_t)(rand() % 50000) + 1;
+            keys[2 * i] = v * 0x9e3779b97f4a7c15ULL;
+            keys[2 * i + 1] = v * 0xc2b2ae3d27d4eb4fULL;
+        }
+        std::vector<uint8_t> isNew(count);
+        sharded.insertBatch(keys.data(), count, isNew.data());
+        for (size_t i = 0; i < count; i++)
+            assert((bool)isNew[i] == single.insert(&keys[2 * i]) && "Test 3 should agree");
+    }
+    assert(sharded.size() == single.size() && "Test 3 sizes should match");
+
+    // Between batches the shard threads block rather than poll: sleeping
+    // for 200 ms costs them a handful of context switches, not thousands
+    // (after a first pause for their brief spin to end).
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    struct rusage before, after;
+    getrusage(RUSAGE_SELF, &before);
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    getrusage(RUSAGE_SELF, &after);
+    long switches = (after.ru_nvcsw - before.ru_nvcsw) + (after.ru_nivcsw - before.ru_nivcsw);
+    std::cout << "Context switches while idle: " << switches << std::endl;
+    assert(switches < 50 && "Test 3 idle shards should block");
+}
+
+// Test case 4: every 5-vertex graph twice collapses to the 34 classes, the
+// first of each written in input order after the header.
+void testDedupFile() {
+    std::cout << "\nTest 4: Deduplicate a file" << std::endl;
+
+    for (int config = 0; config < 4; config++) {
+        int hash = config / 2 ? NAUTY_HASH_SHA256 : NAUTY_HASH_FAST;
+        int keyBits = config % 2 ? 256 : 128;
+        int64_t read = 0, unique = 0;
+        int64_t ret = nautyDedupStream(inputPath.c_str(), outputPath.c_str(),
+                                       NAUTY_DEDUP_INPUT, hash, keyBits, 3, &read, &unique);
+        assert(ret == 0 && "Test 4 should succeed");
+        assert(read == 2 * NUM_LABELLED && unique == NUM_CLASSES && "Test 4 counts");
+
+        std::vector<std::string> lines = readLines(outputPath);
+        assert(lines.size() == NUM_CLASSES && "Test 4 should write one line per class");
+        assert(lines[0] == ">>graph6<<" + encode5(0) && "Test 4 should keep the header");
+        lines[0].erase(0, 10);
+        int prev = -1;
+        for (const std::string& line : lines) {
+            int e = 0;
+            while (encode5(e) != line) e++;
+            assert(e > prev && "Test 4 should keep first occurrences in order");
+            prev = e;
+        }
+    }
+}
+
+// Test case 5: canonical and hash output agree with the other modes.
+void testOutputModes() {
+    std::cout << "\nTest 5: Output modes" << std::endl;
+
+    int64_t unique = 0;
+    nautyDedupStream(inputPath.c_str(), outputPath.c_str(), NAUTY_DEDUP_CANONICAL,
+                     NAUTY_HASH_FAST, 128, 2, nullptr, &unique);
+    std::vector<std::string> canonical = readLines(outputPath);
+    canonical[0].erase(0, 10);
+    std::set<std::string> distinct(canonical.begin(), canonical.end());
+    assert(distinct.size() == NUM_CLASSES && unique == NUM_CLASSES && "Test 5 canonical");
+
+    for (int keyBits : {128, 256}) {
+        nautyDedupStream(inputPath.c_str(), outputPath.c_str(), NAUTY_DEDUP_HASH,
+                         NAUTY_HASH_FAST, keyBits, 2, nullptr, nullptr);
+        std::ifstream f(outputPath, std::ios::binary | std::ios::ate);
+        assert(f.tellg() == keyBits / 8 * NUM_CLASSES && "Test 5 hash size per class");
+    }
+
+    // The empty graph on 5 vertices is the first class; its SHA-256 key is
+    // the digest of 5 zero rows.
+    nautyDedupStream(inputPath.c_str(), outputPath.c_str(), NAUTY_DEDUP_HASH,
+                     NAUTY_HASH_SHA256, 256, 2, nullptr, nullptr);
+    std::ifstream f(outputPath, std::ios::binary);
+    uint8_t first[32], expected[32];
+    f.read((char*)first, 32);
+    std::vector<graph> empty(5, 0);
+    sha256(empty.data(), empty.size() * sizeof(graph), expected);
+    assert(std::memcmp(first, expected, 32) == 0 && "Test 5 SHA-256 key");
+
+    assert(nautyDedupStream(inputPath.c_str(), nullptr, NAUTY_DEDUP_COUNT, NAUTY_HASH_FAST,
+                            128, 2, nullptr, &unique) == 0 && unique == NUM_CLASSES);
+}
+
+// Test case 6: invalid arguments
+void testInvalidArguments() {
+    std::cout << "\nTest 6: Invalid arguments" << std::endl;
+
+    const char* in = inputPath.c_str();
+    const char* out = outputPath.c_str();
+    assert(nautyDedupStream(in, out, 9, 0, 128, 1, nullptr, nullptr) == -4);
+    assert(nautyDedupStream(in, out, NAUTY_DEDUP_INPUT, 0, 64, 1, nullptr, nullptr) == -5);
+    assert(nautyDedupStream(in, out, NAUTY_DEDUP_INPUT, 2, 128, 1, nullptr, nullptr) == -6);
+    assert(nautyDedupStream(in, nullptr, NAUTY_DEDUP_INPUT, 0, 128, 1, nullptr, nullptr) == -2);
+    assert(nautyDedupStream("/nonexistent/in", out, 0, 0, 128, 1, nullptr, nullptr) == -1);
+}
+
+// Feed count random records to the sorter, then check that the merge
+// yields the smallest record of each key in order.
+static void sortAndCheck(ExternalSorter& sorter, uint64_t count, uint64_t keyRange,
+                         uint64_t seed) {
+    std::map<std::pair<uint64_t, uint64_t>, uint64_t> reference;
+    FastRng rng(seed);
+    for (uint64_t i = 0; i < count; i++) {
+        uint64_t record[3] = {rng.next() % keyRange, rng.next() % 50, rng.next()};
+        assert(sorter.add(record) && "Test 7 add should succeed");
+        auto k = std::make_pair(record[0], record[1]);
+        auto it = reference.find(k);
+        if (it == reference.end() || record[2] < it->second) reference[k] = record[2];
+    }
+    assert(sorter.finish() && "Test 7 finish should succeed");
+    assert(sorter.liveRunCount() <= sorter.fanIn() && "Test 7 final merge within fan-in");
+
+    auto it = reference.begin();
+    const uint64_t* r;
+    while (sorter.next(r)) {
+        assert(it != reference.end() && "Test 7 should not yield extra records");
+        assert(r[0] == it->first.first && r[1] == it->first.second && r[2] == it->second &&
+               "Test 7 should yield the smallest record per key in order");
+        ++it;
+    }
+    assert(it == reference.end() && !sorter.failed() && "Test 7 should yield every key");
+}
+
+// Test case 7: a tiny budget forces many runs, and the merge still yields
+// the smallest record of each key in order. The fan-in follows the budget
+// and the descriptor limit, merging runs early when either is small.
+void testExternalSorter() {
+    std::cout << "\nTest 7: External sorter" << std::endl;
+
+    ExternalSorter sorter(3, 2, 1000 * 3 * sizeof(uint64_t), "/tmp");
+    sortAndCheck(sorter, 50000, 300, 11);
+    assert(sorter.runCount() == 50 && "Test 7 should spill 50 runs");
+    assert(sorter.fanIn() == 2 && "Test 7 tiny budget merges pairs");
+
+    // Five 64 KiB blocks: four runs at a time, with one block to write.
+    ExternalSorter byBudget(3, 2, 5 * (64 << 10), "/tmp");
+    assert(byBudget.fanIn() == 4);
+    sortAndCheck(byBudget, 300000, 100000, 12);
+    assert(byBudget.runCount() == 22);
+
+    // A low descriptor limit caps the fan-in below what the budget allows.
+    struct rlimit saved, low;
+    assert(getrlimit(RLIMIT_NOFILE, &saved) == 0);
+    low = saved;
+    low.rlim_cur = 64 + 2 * 3;
+    assert(setrlimit(RLIMIT_NOFILE, &low) == 0);
+    ExternalSorter byFds(3, 2, 64 << 20, "/tmp");
+    assert(setrlimit(RLIMIT_NOFILE, &saved) == 0);
+    assert(byFds.fanIn() == 3 && "Test 7 fan-in within the descriptor limit");
+}
+
+// Test case 8: out-of-core dedup matches the in-memory output in every
+// mode, with a budget of a few dozen keys.
+void testDedupExternal() {
+    std::cout << "\nTest 8: Out-of-core dedup" << std::endl;
+
+    std::string expectedPath = outputPath + ".expected";
+    for (int mode : {NAUTY_DEDUP_CANONICAL, NAUTY_DEDUP_INPUT, NAUTY_DEDUP_HASH}) {
+        for (int keyBits : {128, 256}) {
+            int64_t read = 0, unique = 0;
+            nautyDedupStream(inputPath.c_str(), expectedPath.c_str(), mode, NAUTY_HASH_FAST,
+                             keyBits, 2, nullptr, nullptr);
+            int64_t ret = nautyDedupExternal(inputPath.c_str(), outputPath.c_str(), mode,
+                                             NAUTY_HASH_FAST, keyBits, 40 * (keyBits / 64 + 1) * 8,
+                                             nullptr, 2, &read, &unique);
+            assert(ret == 0 && "Test 8 should succeed");
+            assert(read == 2 * NUM_LABELLED && unique == NUM_CLASSES && "Test 8 counts");
+
+            std::ifstream a(expectedPath, std::ios::binary), b(outputPath, std::ios::binary);
+            std::string expected((std::istreambuf_iterator<char>(a)), {});
+            std::string actual((std::istreambuf_iterator<char>(b)), {});
+            assert(!actual.empty() && actual == expected && "Test 8 output should match");
+        }
+    }
+
+    int64_t unique = 0;
+    assert(nautyDedupExternal(inputPath.c_str(), nullptr, NAUTY_DEDUP_COUNT, NAUTY_HASH_SHA256,
+                              256, 1000, "/tmp", 1, nullptr, &unique) == 0 &&
+           unique == NUM_CLASSES && "Test 8 count");
+    assert(nautyDedupExternal("-", outputPath.c_str(), NAUTY_DEDUP_INPUT, 0, 128, 0, nullptr, 1,
+                              nullptr, nullptr) == -8 && "Test 8 stdin needs a second pass");
+    assert(nautyDedupExternal(inputPath.c_str(), outputPath.c_str(), NAUTY_DEDUP_INPUT, 0, 128,
+                              1000, "/nonexistent", 1, nullptr, nullptr) == -7 &&
+           "Test 8 unwritable temp dir");
+    std::remove(expectedPath.c_str());
+}
+
+// Test case 9: separate processes, one per shard, split the classes
+// between them, and the merged outputs hold each class once.
+void testShardProcesses() {
+    std::cout << "\nTest 9: Sharded processes" << std::endl;
+
+    const int SHARDS = 3;
+    for (int mode : {NAUTY_DEDUP_INPUT, NAUTY_DEDUP_HASH}) {
+        std::vector<std::string> paths;
+        std::vector<pid_t> children;
+        for (int i = 0; i < SHARDS; i++) {
+            paths.push_back(outputPath + ".shard" + std::to_string(i));
+            pid_t pid = fork();
+            assert(pid >= 0 && "Test 9 fork should succeed");
+            if (pid == 0) {
+                int64_t unique = 0;
+                int64_t ret = nautyDedupShard(inputPath.c_str(), paths[i].c_str(), mode,
+                                              NAUTY_HASH_FAST, 128, i, SHARDS, 2, nullptr,
+                                              &unique);
+                _exit(ret == 0 ? (int)unique : 255);
+            }
+            children.push_back(pid);
+        }
+        int total = 0;
+        for (pid_t pid : children) {
+            int status;
+            waitpid(pid, &status, 0);
+            assert(WIFEXITED(status) && WEXITSTATUS(status) != 255 && "Test 9 shard failed");
+            assert(WEXITSTATUS(status) < NUM_CLASSES && "Test 9 should split the classes");
+            total += WEXITSTATUS(status);
+        }
+        assert(total == NUM_CLASSES && "Test 9 shards should be disjoint");
+
+        std::vector<const char*> shardPaths;
+        for (const std::string& p : paths) shardPaths.push_back(p.c_str());
+        assert(nautyDedupMerge(shardPaths.data(), SHARDS, outputPath.c_str(), mode) == 0);
+
+        std::string expectedPath = outputPath + ".expected";
+        nautyDedupStream(inputPath.c_str(), expectedPath.c_str(), mode, NAUTY_HASH_FAST, 128, 1,
+                         nullptr, nullptr);
+        if (mode == NAUTY_DEDUP_INPUT) {
+            std::vector<std::string> merged = readLines(outputPath);
+            std::vector<std::string> expected = readLines(expectedPath);
+            assert(merged[0].compare(0, 10, ">>graph6<<") == 0 && "Test 9 header first");
+            std::sort(merged.begin(), merged.end());
+            std::sort(expected.begin(), expected.end());
+            assert(merged == expected && "Test 9 merged graphs should match");
+        } else {
+            std::ifstream a(outputPath, std::ios::binary), b(expectedPath, std::ios::binary);
+            std::string merged((std::istreambuf_iterator<char>(a)), {});
+            std::string expected((std::istreambuf_iterator<char>(b)), {});
+            std::set<std::string> mergedKeys, expectedKeys;
+            for (size_t k = 0; k < merged.size(); k += 16) mergedKeys.insert(merged.substr(k, 16));
+            for (size_t k = 0; k < expected.size(); k += 16) {
+                expectedKeys.insert(expected.substr(k, 16));
+            }
+            assert(merged.size() == expected.size() && mergedKeys == expectedKeys &&
+                   "Test 9 merged hashes should match");
+        }
+        for (const std::string& p : paths) std::remove(p.c_str());
+        std::remove(expectedPath.c_str());
+    }
+
+    assert(nautyDedupShard(inputPath.c_str(), outputPath.c_str(), 0, 0, 128, 3, 3, 1, nullptr,
+                           nullptr) == -9 && "Test 9 invalid shard");
+}
+
+int main() {
+    std::cout << "Starting Nauty Dedup Tests" << std::endl;
+
+    writeInput();
+    testSha256();
+    testFlatHashSet();
+    testShardedHashSet();
+    testDedupFile();
+    testOutputModes();
+    testInvalidArguments();
+    testExternalSorter();
+    testDedupExternal();
+    testShardProcesses();
+    std::remove(inputPath.c_str());
+    std::remove(outputPath.c_str());
+
+    std::cout << "\nAll dedup tests passed successfully!" << std::endl;
+    return 0;
+}
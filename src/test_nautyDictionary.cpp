@@ -0,0 +1,247 @@
+#include "nautyDictionary.h"
+#include "nautyCensus.h"
+#include "nautyCore.h"
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <set>
+#include <string>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+static std::string dictPath = "/tmp/nauty_dictionary_test.ncd";
+
+// Random valid keys of motif size k.
+static std::vector<int64_t> randomKeys(FastRng& rng, int k, int count, int range) {
+    std::vector<int64_t> keys;
+    for (int i = 0; i < count; i++) {
+        uint64_t key = rng.below(range);
+        if (k < 8) key &= (1ULL << (k * k)) - 1;
+        keys.push_back((int64_t)key);
+    }
+    return keys;
+}
+
+// Test case 1: ids are dense, stable for repeated classes, distinct per
+// motif size, and map back to their classes.
+void testBasics() {
+    std::cout << "\nTest 1: Ids and reverse lookup" << std::endl;
+
+    std::remove(dictPath.c_str());
+    int64_t dict = nautyDictionaryOpen(dictPath.c_str());
+    assert(dict >= 0 && nautyDictionarySize(dict) == 0 && "Test 1 new dictionary is empty");
+
+    int64_t keys[] = {7, 3, 7, 12, 3};
+    int64_t ids[5];
+    assert(nautyDictionaryIds(dict, 4, keys, 5, ids) == 3 && "Test 1 three new classes");
+    assert(ids[0] == 0 && ids[1] == 1 && ids[2] == 0 && ids[3] == 2 && ids[4] == 1 &&
+           "Test 1 ids in order of first appearance");
+    assert(nautyDictionaryIds(dict, 5, keys, 1, ids) == 1 && ids[0] == 3 &&
+           "Test 1 the same key of another size is another class");
+    assert(nautyDictionaryFind(dict, 4, 12) == 2 && nautyDictionaryFind(dict, 4, 13) == -3 &&
+           nautyDictionarySize(dict) == 4 && "Test 1 find does not add");
+
+    int64_t size, key;
+    assert(nautyDictionaryClass(dict, 3, &size, &key) == 0 && size == 5 && key == 7);
+    assert(nautyDictionaryClass(dict, 4, &size, &key) == -2 && "Test 1 no such class");
+
+    // Size 8 uses all 64 bits.
+    int64_t wide = (int64_t)0x8000000000000001ULL;
+    assert(nautyDictionaryIds(dict, 8, &wide, 1, ids) == 1 &&
+           nautyDictionaryClass(dict, ids[0], &size, &key) == 0 && key == wide);
+    assert(nautyDictionaryClose(dict) == 0);
+}
+
+// Test case 2: reopening keeps every id, and new classes continue the
+// numbering; the table grows through several rebuilds.
+void testPersistence() {
+    std::cout << "\nTest 2: Persistence" << std::endl;
+
+    std::remove(dictPath.c_str());
+    FastRng rng(21);
+    std::vector<int64_t> keys = randomKeys(rng, 6, 20000, 1 << 30);
+    std::vector<int64_t> ids(keys.size());
+    int64_t dict = nautyDictionaryOpen(dictPath.c_str());
+    nautyDictionaryIds(dict, 6, keys.data(), keys.size(), ids.data());
+    int64_t size = nautyDictionarySize(dict);
+    nautyDictionaryClose(dict);
+
+    dict = nautyDictionaryOpen(dictPath.c_str());
+    assert(nautyDictionarySize(dict) == size && "Test 2 size should persist");
+    std::vector<int64_t> again(keys.size());
+    assert(nautyDictionaryIds(dict, 6, keys.data(), keys.size(), again.data()) == 0 &&
+           again == ids && "Test 2 ids should persist");
+    int64_t next = 123456789;
+    int64_t id;
+    nautyDictionaryIds(dict, 6, &next, 1, &id);
+    assert(id == size && "Test 2 numbering should continue");
+    nautyDictionaryClose(dict);
+}
+
+// Test case 3: threads adding overlapping classes agree on every id, and
+// the ids are dense.
+void testThreads() {
+    std::cout << "\nTest 3: Concurrent threads" << std::endl;
+
+    std::remove(dictPath.c_str());
+    int64_t dict = nautyDictionaryOpen(dictPath.c_str());
+    const int THREADS = 8;
+    std::vector<std::vector<int64_t>> keys(THREADS), ids(THREADS);
+    for (int t = 0; t < THREADS; t++) {
+        FastRng rng(100 + t);
+        keys[t] = randomKeys(rng, 5, 20000, 30000);
+        ids[t].resize(keys[t].size());
+    }
+    std::vector<std::thread> threads;
+    for (int t = 0; t < THREADS; t++) {
+        threads.emplace_back([&, t] {
+            nautyDictionaryIds(dict, 5, keys[t].data(), keys[t].size(), ids[t].data());
+        });
+    }
+    for (auto& th : threads) th.join();
+
+    std::map<int64_t, int64_t> idOf;
+    for (int t = 0; t < THREADS; t++) {
+        for (size_t i = 0; i < keys[t].size(); i++) {
+            auto it = idOf.emplace(keys[t][i], ids[t][i]).first;
+            assert(it->second == ids[t][i] && "Test 3 threads should agree");
+        }
+    }
+    std::set<int64_t> distinct;
+    for (auto& kv : idOf) distinct.insert(kv.second);
+    assert(distinct.size() == idOf.size() && *distinct.rbegin() == (int64_t)idOf.size() - 1 &&
+           nautyDictionarySize(dict) == (int64_t)idOf.size() && "Test 3 ids should be dense");
+    nautyDictionaryClose(dict);
+}
+
+// Test case 4: processes sharing the file, each with its own view, agree on
+// every id without coordinating.
+void testProcesses() {
+    std::cout << "\nTest 4: Concurrent processes" << std::endl;
+
+    std::remove(dictPath.c_str());
+    const int PROCS = 4, KEYS = 5000;
+    std::vector<std::string> outputs;
+    std::vector<pid_t> children;
+    for (int p = 0; p < PROCS; p++) {
+        outputs.push_back(dictPath + ".ids" + std::to_string(p));
+        pid_t pid = fork();
+        assert(pid >= 0 && "Test 4 fork should succeed");
+        if (pid == 0) {
+            FastRng rng(200 + p);
+            std::vector<int64_t> keys = randomKeys(rng, 7, KEYS, 8000);
+            std::vector<int64_t> ids(KEYS);
+            int64_t dict = nautyDictionaryOpen(dictPath.c_str());
+            bool ok = dict >= 0 &&
+                      nautyDictionaryIds(dict, 7, keys.data(), KEYS, ids.data()) >= 0;
+            {
+                std::ofstream f(outputs[p]);
+                for (int i = 0; i < KEYS; i++) f << keys[i] << " " << ids[i] << "\n";
+            }
+            nautyDictionaryClose(dict);
+            _exit(ok ? 0 : 1);
+        }
+        children.push_back(pid);
+    }
+    for (pid_t pid : children) {
+        int status;
+        waitpid(pid, &status, 0);
+        assert(WIFEXITED(status) && WEXITSTATUS(status) == 0 && "Test 4 child failed");
+    }
+
+    int64_t dict = nautyDictionaryOpen(dictPath.c_str());
+    std::map<int64_t, int64_t> idOf;
+    for (const std::string& path : outputs) {
+        std::ifstream f(path);
+        int64_t key, id;
+        while (f >> key >> id) {
+            auto it = idOf.emplace(key, id).first;
+            assert(it->second == id && "Test 4 processes should agree");
+            assert(nautyDictionaryFind(dict, 7, key) == id && "Test 4 file should agree");
+        }
+        std::remove(path.c_str());
+    }
+    assert(nautyDictionarySize(dict) == (int64_t)idOf.size() && "Test 4 no duplicates");
+    nautyDictionaryClose(dict);
+}
+
+// Test case 5: census classes get the same ids whatever order a run finds
+// them in.
+void testCensusIds() {
+    std::cout << "\nTest 5: Census class ids" << std::endl;
+
+    std::remove(dictPath.c_str());
+    // A 4x4 grid with diagonals.
+    std::vector<int64_t> offsets(1, 0), neighbors;
+    for (int v = 0; v < 16; v++) {
+        int r = v / 4, c = v % 4;
+        for (int dr = -1; dr <= 1; dr++) {
+            for (int dc = -1; dc <= 1; dc++) {
+                int rr = r + dr, cc = c + dc;
+                if ((dr || dc) && rr >= 0 && rr < 4 && cc >= 0 && cc < 4) {
+                    neighbors.push_back(rr * 4 + cc);
+                }
+            }
+        }
+        offsets.push_back(neighbors.size());
+    }
+    int64_t graph = nautyRegisterGraph(16, offsets.data(), neighbors.data(), 0);
+    int64_t keys[64], counts[64], ids[64];
+    int64_t classes = nautyExactCensus(graph, 4, 2, 64, keys, counts);
+    assert(classes > 1);
+
+    int64_t dict = nautyDictionaryOpen(dictPath.c_str());
+    std::reverse(keys, keys + classes);
+    nautyDictionaryIds(dict, 4, keys, classes, ids);
+    nautyDictionaryClose(dict);
+
+    dict = nautyDictionaryOpen(dictPath.c_str());
+    int64_t again = nautyExactCensus(graph, 4, 1, 64, keys, counts);
+    assert(again == classes);
+    for (int64_t i = 0; i < classes; i++) {
+        int64_t size, key;
+        int64_t id = nautyDictionaryFind(dict, 4, keys[i]);
+        assert(id >= 0 && nautyDictionaryClass(dict, id, &size, &key) == 0 && key == keys[i] &&
+               "Test 5 every class should map back to itself");
+    }
+    nautyDictionaryClose(dict);
+    nautyReleaseGraph(graph);
+}
+
+// Test case 6: invalid arguments and files
+void testErrors() {
+    std::cout << "\nTest 6: Errors" << std::endl;
+
+    std::remove(dictPath.c_str());
+    int64_t dict = nautyDictionaryOpen(dictPath.c_str());
+    int64_t key = 1 << 9, id;
+    assert(nautyDictionaryIds(dict, 3, &key, 1, &id) == -2 && "Test 6 key too wide");
+    assert(nautyDictionaryIds(dict, 9, &key, 1, &id) == -2 && "Test 6 motif size");
+    assert(nautyDictionaryFind(dict, 1, 0) == -2 && "Test 6 motif size");
+    assert(nautyDictionaryIds(999, 3, &key, 1, &id) == -1 && "Test 6 unknown id");
+    assert(nautyDictionaryClose(dict) == 0 && nautyDictionaryClose(dict) == -1);
+
+    std::ofstream(dictPath) << "not a dictionary, but longer than its header would be......\n";
+    assert(nautyDictionaryOpen(dictPath.c_str()) == -2 && "Test 6 bad magic");
+    assert(nautyDictionaryOpen("/nonexistent/dict") == -1 && "Test 6 missing directory");
+}
+
+int main() {
+    std::cout << "Starting Nauty Dictionary Tests" << std::endl;
+
+    testBasics();
+    testPersistence();
+    testThreads();
+    testProcesses();
+    testCensusIds();
+    testErrors();
+    std::remove(dictPath.c_str());
+
+    std::cout << "\nAll dictionary tests passed successfully!" << std::endl;
+    return 0;
+}
@@ -0,0 +1,211 @@
+#include "nautyClassify.h"
+#include "nautyMemory.h"
+#include <cassert>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+// count random n x n matrices, every third one a cycle (regular, so nauty
+// searches), the rest random digraphs.
+static std::vector<int64_t> batch(FastRng& rng, int n, int count) {
+    std::vector<int64_t> out((size_t)count * n * n, 0);
+    for (int b = 0; b < count; b++) {
+        int64_t* a = out.data() + (size_t)b * n * n;
+        for (int i = 0; i < n; i++) {
+            for (int j = 0; j < n; j++) {
+                if (b % 3 == 0) {
+                    a[i * n + j] = (j == (i + 1) % n || i == (j + 1) % n) && i != j;
+                } else {
+                    a[i * n + j] = i != j && rng.below(3) == 0;
+                }
+            }
+        }
+    }
+    return out;
+}
+
+struct Labelled {
+    std::vector<int64_t> plain, invariant, profile;
+};
+
+// Label a batch with nautyClassify, nautyClassifyInvariant and the
+// "regular-hard" profile.
+static Labelled label(std::vector<int64_t>& matrices, int n, int count) {
+    Labelled out;
+    out.plain.resize((size_t)count * n);
+    out.invariant.resize((size_t)count * n);
+    out.profile.resize((size_t)count * n);
+    for (int b = 0; b < count; b++) {
+        assert(nautyClassify(matrices.data() + (size_t)b * n * n, n, out.plain.data() + b * n, 0,
+                             0, 1) == 0);
+    }
+    assert(nautyClassifyInvariant(matrices.data(), n, out.invariant.data(), count, 8, 0, 2, 0,
+                                  nullptr) == 0);
+    assert(nautyClassifyProfile(matrices.data(), n, out.profile.data(), count,
+                                "regular-hard") == 0);
+    return out;
+}
+
+static bool same(const Labelled& a, const Labelled& b) {
+    return a.plain == b.plain && a.invariant == b.invariant && a.profile == b.profile;
+}
+
+// Test case 1: after nautyClassifyReserve, batches of every size up to the
+// reserved one leave the thread's scratch exactly as large, and the
+// labellings are unchanged.
+void testReserve() {
+    std::cout << "\nTest 1: Reserved buffers do not grow" << std::endl;
+
+    FastRng rng(49);
+    const int maxN = 70;
+    std::vector<int> sizes = {5, 70, 12, 33, 64, 65, 2, 40, 1};
+    std::vector<std::vector<int64_t>> matrices;
+    std::vector<Labelled> expected;
+    for (int n : sizes) {
+        matrices.push_back(batch(rng, n, 6));
+        expected.push_back(label(matrices.back(), n, 6));
+    }
+
+    assert(nautyClassifyRelease() == 0);
+    assert(threadScratchBytes() == 0 && "Test 1 release frees the scratch");
+    assert(nautyClassifyReserve(maxN) == 0);
+    size_t reserved = threadScratchBytes();
+    assert(reserved > 0);
+    for (size_t i = 0; i < sizes.size(); i++) {
+        assert(same(label(matrices[i], sizes[i], 6), expected[i]) && "Test 1 labellings");
+        assert(threadScratchBytes() == reserved && "Test 1 scratch should not grow");
+    }
+
+    // A larger graph still works and grows the buffers.
+    std::vector<int64_t> large = batch(rng, 100, 3);
+    Labelled before = label(large, 100, 3);
+    assert(threadScratchBytes() > reserved);
+    assert(nautyClassifyRelease() == 0 && threadScratchBytes() == 0);
+    assert(same(label(large, 100, 3), before) && "Test 1 labelling after release");
+
+    assert(nautyClassifyReserve(0) == -1);
+    assert(nautyClassifyReserve(-5) == -1);
+    assert(nautyClassifyRelease() == 0);
+    std::cout << "ok" << std::endl;
+}
+
+// Test case 2: each thread reserves, labels and releases its own buffers
+// without touching the others'.
+void testThreads() {
+    std::cout << "\nTest 2: Per-thread buffers" << std::endl;
+
+    FastRng rng(7);
+    const int n = 48, count = 9;
+    std::vector<int64_t> matrices = batch(rng, n, count);
+    Labelled expected = label(matrices, n, count);
+    nautyClassifyRelease();
+
+    runThreads(4, [&](int t) {
+        std::vector<int64_t> mine = matrices;
+        assert(threadScratchBytes() == 0 || t == 0);
+        assert(nautyClassifyReserve(n + t) == 0);
+        size_t reserved = threadScratchBytes();
+        for (int round = 0; round < 3; round++) {
+            assert(same(label(mine, n, count), expected) && "Test 2 labellings");
+            assert(threadScratchBytes() == reserved && "Test 2 scratch should not grow");
+        }
+        assert(nautyClassifyRelease() == 0 && threadScratchBytes() == 0);
+    });
+    std::cout << "ok" << std::endl;
+}
+
+// Test case 3: with a budget, a thread frees its buffers after a call that
+// left more than the budget, and keeps them after calls under it.
+void testBudget() {
+    std::cout << "\nTest 3: Memory budget" << std::endl;
+
+    FastRng rng(3);
+    std::vector<int64_t> large = batch(rng, 600, 2), small = batch(rng, 20, 4);
+    Labelled largeLabels = label(large, 600, 2), smallLabels = label(small, 20, 4);
+    assert(threadRetainedBytes() > 100000);
+
+    assert(nautyClassifyMemoryBudget(-1) == -1);
+    assert(nautyClassifyMemoryBudget(100000) == 0);
+    assert(same(label(large, 600, 2), largeLabels) && "Test 3 labellings");
+    assert(threadRetainedBytes() == 0 && "Test 3 over budget: freed");
+    assert(same(label(small, 20, 4), smallLabels));
+    size_t kept = threadRetainedBytes();
+    assert(kept > 0 && kept <= 100000 && "Test 3 under budget: kept");
+    assert(same(label(small, 20, 4), smallLabels) && threadRetainedBytes() == kept);
+
+    assert(nautyClassifyMemoryBudget(0) == 0);
+    label(large, 600, 2);
+    assert(threadRetainedBytes() > 100000 && "Test 3 no budget");
+    nautyClassifyRelease();
+    std::cout << "ok" << std::endl;
+}
+
+// Test case 4: nautyClassifyMemory reports every live thread's buffers, and
+// nautyClassifyTrim(1) has each thread free them after its next call.
+void testReportAndTrim() {
+    std::cout << "\nTest 4: Per-thread report and trim" << std::endl;
+
+    FastRng rng(4);
+    const int n = 40, count = 6;
+    std::vector<int64_t> matrices = batch(rng, n, count);
+    Labelled expected = label(matrices, n, count);
+
+    const int threads = 4;
+    std::atomic<int> labelled{0}, trimmed{0};
+    std::atomic<bool> trimDone{false}, checked{false};
+    runThreads(threads, [&](int t) {
+        std::vector<int64_t> mine = matrices;
+        if (t == 0) {
+            Backoff wait;
+            while (labelled.load() < threads - 1) wait.pause();
+            std::vector<int64_t> bytes(threads + 1, -1);
+            assert(nautyClassifyMemory(bytes.data(), threads + 1) == threads &&
+                   "Test 4 one entry per live thread");
+            for (int i = 0; i < threads; i++) assert(bytes[i] > 0);
+            assert(bytes[threads] == -1 && nautyClassifyMemory(nullptr, 0) == threads);
+            assert(nautyClassifyMemory(bytes.data(), -1) == -1);
+
+            assert(nautyClassifyTrim(1) > 0 && threadRetainedBytes() == 0);
+            trimDone = true;
+            Backoff wait2;
+            while (trimmed.load() < threads - 1) wait2.pause();
+            assert(nautyClassifyMemory(bytes.data(), threads) == threads);
+            for (int i = 0; i < threads; i++) assert(bytes[i] == 0 && "Test 4 trimmed");
+            checked = true;
+            return;
+        }
+        assert(same(label(mine, n, count), expected));
+        labelled++;
+        Backoff wait;
+        while (!trimDone.load()) wait.pause();
+        assert(threadRetainedBytes() > 0 && "Test 4 trim waits for the thread's next call");
+        std::vector<int64_t> out(n);
+        assert(nautyClassify(mine.data(), n, out.data(), 0, 0, 1) == 0);
+        assert(threadRetainedBytes() == 0);
+        trimmed++;
+        Backoff wait2;
+        while (!checked.load()) wait2.pause();
+    });
+
+    // The threads are gone, and so are their entries.
+    int64_t bytes[2];
+    assert(nautyClassifyMemory(bytes, 2) == 1);
+
+    // A thread that only asks for the report is not in it.
+    int64_t seen = -1;
+    std::thread([&] { seen = nautyClassifyMemory(bytes, 2); }).join();
+    assert(seen == 1 && "Test 4 a reporting thread is not listed");
+    std::cout << "ok" << std::endl;
+}
+
+int main() {
+    std::cout << "Starting Nauty Memory Tests" << std::endl;
+
+    testReserve();
+    testThreads();
+    testBudget();
+    testReportAndTrim();
+
+    std::cout << "\nAll memory tests passed successfully!" << std::endl;
+    return 0;
+}
@@ -0,0 +1,280 @@
+#include "nautyClassify.h"
+#include "nautyParallel.h"
+#include "nautySetOps.h"
+#include <cassert>
+#include <cmath>
+#include <iostream>
+#include <string>
+#include <vector>
+
+struct TestGraph {
+    std::string name;
+    int n;
+    std::vector<std::vector<bool>> adj;
+    bool directed = false;
+};
+
+static TestGraph emptyGraph(const std::string& name, int n) {
+    return TestGraph{name, n, std::vector<std::vector<bool>>(n, std::vector<bool>(n, false))};
+}
+
+static void addEdge(TestGraph& t, int i, int j) {
+    t.adj[i][j] = t.adj[j][i] = true;
+}
+
+// Paley graph on q = 1 mod 4 vertices: strongly regular, vertex-transitive.
+static TestGraph paley(int q) {
+    TestGraph t = emptyGraph("paley " + std::to_string(q), q);
+    std::vector<bool> square(q, false);
+    for (int x = 1; x < q; x++) square[x * x % q] = true;
+    for (int i = 0; i < q; i++) {
+        for (int j = i + 1; j < q; j++) {
+            if (square[(j - i) % q]) addEdge(t, i, j);
+        }
+    }
+    return t;
+}
+
+// d-dimensional hypercube.
+static TestGraph hypercube(int d) {
+    TestGraph t = emptyGraph("hypercube " + std::to_string(d), 1 << d);
+    for (int v = 0; v < t.n; v++) {
+        for (int b = 0; b < d; b++) {
+            if (v < (v ^ (1 << b))) addEdge(t, v, v ^ (1 << b));
+        }
+    }
+    return t;
+}
+
+// k x k rook's graph: strongly regular with a large group.
+static TestGraph rook(int k) {
+    TestGraph t = emptyGraph("rook " + std::to_string(k), k * k);
+    for (int a = 0; a < t.n; a++) {
+        for (int b = a + 1; b < t.n; b++) {
+            if (a / k == b / k || a % k == b % k) addEdge(t, a, b);
+        }
+    }
+    return t;
+}
+
+// count disjoint cycles of length len: many equivalent root children.
+static TestGraph cycles(int count, int len) {
+    TestGraph t = emptyGraph(std::to_string(count) + " cycles", count * len);
+    for (int c = 0; c < count; c++) {
+        for (int i = 0; i < len; i++) addEdge(t, c * len + i, c * len + (i + 1) % len);
+    }
+    return t;
+}
+
+// Random cubic graph by pairing points, retried until simple.
+static TestGraph cubic(int n, FastRng& rng) {
+    for (;;) {
+        TestGraph t = emptyGraph("cubic " + std::to_string(n), n);
+        std::vector<int> points(3 * n);
+        for (int i = 0; i < 3 * n; i++) points[i] = i / 3;
+        for (int i = 3 * n - 1; i > 0; i--) std::swap(points[i], points[rng.below(i + 1)]);
+        bool simple = true;
+        for (int i = 0; i < 3 * n && simple; i += 2) {
+            int a = points[i], b = points[i + 1];
+            simple = a != b && !t.adj[a][b];
+            if (simple) addEdge(t, a, b);
+        }
+        if (simple) return t;
+    }
+}
+
+// Random digraph in which every vertex has the same out-degree.
+static TestGraph outRegular(int n, int degree, FastRng& rng) {
+    TestGraph t = emptyGraph("out-regular " + std::to_string(n), n);
+    t.directed = true;
+    for (int i = 0; i < n; i++) {
+        for (int added = 0; added < degree;) {
+            int j = (int)rng.below(n);
+            if (j != i && !t.adj[i][j]) {
+                t.adj[i][j] = true;
+                added++;
+            }
+        }
+    }
+    return t;
+}
+
+// t with its vertices randomly renumbered.
+static TestGraph shuffled(const TestGraph& t, FastRng& rng) {
+    std::vector<int> perm(t.n);
+    for (int i = 0; i < t.n; i++) perm[i] = i;
+    for (int i = t.n - 1; i > 0; i--) std::swap(perm[i], perm[rng.below(i + 1)]);
+    TestGraph out = emptyGraph(t.name + " (shuffled)", t.n);
+    out.directed = t.directed;
+    for (int i = 0; i < t.n; i++) {
+        for (int j = 0; j < t.n; j++) out.adj[perm[i]][perm[j]] = t.adj[i][j];
+    }
+    return out;
+}
+
+static std::vector<graph> toNauty(const TestGraph& t, int m) {
+    std::vector<graph> g((size_t)m * t.n, 0);
+    for (int i = 0; i < t.n; i++) {
+        for (int j = 0; j < t.n; j++) {
+            if (t.adj[i][j]) ADDELEMENT(GRAPHROW(g.data(), i, m), j);
+        }
+    }
+    return g;
+}
+
+static std::vector<TestGraph> testGraphs() {
+    FastRng rng(47);
+    std::vector<TestGraph> graphs = {paley(13), paley(29), hypercube(4), hypercube(5), rook(5),
+                                     cycles(6, 5), cycles(3, 24), cubic(40, rng),
+                                     outRegular(30, 3, rng)};
+    graphs.push_back(shuffled(paley(29), rng));
+    graphs.push_back(shuffled(rook(6), rng));
+    graphs.push_back(shuffled(cycles(4, 20), rng));
+    return graphs;
+}
+
+// Test case 1: the parallel labelling, canonical graph, group order and
+// orbit count are sequential nauty's, over thread counts and settings that
+// change the tree (invariant levels, target cells, Schreier pruning).
+void testSameLabelling() {
+    std::cout << "\nTest 1: Same labelling as sequential nauty" << std::endl;
+
+    std::vector<SearchSettings> settings(7);
+    settings[1].invariant.invariant = 8;  // distances at the root only
+    settings[1].invariant.minInvarLevel = 1;
+    settings[1].invariant.maxInvarLevel = 1;
+    settings[2].invariant.invariant = 2;  // adjtriang down to level 3
+    settings[2].invariant.minInvarLevel = 0;
+    settings[2].invariant.maxInvarLevel = 3;
+    settings[2].invariant.invarArg = 0;
+    settings[3].dispatch = graphDispatch(TARGET_FIRST);
+    settings[3].schreier = true;
+    settings[4].dispatch = graphDispatch(TARGET_BEST);
+    settings[5].tcLevel = 1;
+    settings[6].sparse = true;
+
+    for (const TestGraph& t : testGraphs()) {
+        int n = t.n, m = SETWORDSNEEDED(n);
+        std::vector<graph> g = toNauty(t, m);
+        for (int digraph = t.directed; digraph < 2; digraph++) {
+            for (size_t s = 0; s < settings.size(); s++) {
+                std::vector<int> lab(n), plab(n);
+                std::vector<graph> canong((size_t)m * n), pcanong((size_t)m * n);
+                statsblk stats, pstats;
+                canonicalLabel(g.data(), m, n, digraph, lab.data(), canong.data(), &stats,
+                               &settings[s]);
+                for (int threads : {2, 3, 8}) {
+                    parallelCanonicalLabel(g.data(), m, n, digraph, plab.data(), pcanong.data(),
+                                           &pstats, &settings[s], threads);
+                    assert(plab == lab && "Test 1 labelling should be nauty's");
+                    assert(pcanong == canong && "Test 1 canonical graph should be nauty's");
+                    assert(pstats.numorbits == stats.numorbits && "Test 1 orbits");
+                    assert(pstats.grpsize2 == stats.grpsize2 &&
+                           pstats.grpsize1 == stats.grpsize1 && "Test 1 group order");
+                }
+            }
+        }
+        std::cout << t.name << ": ok" << std::endl;
+    }
+}
+
+// Test case 2: nautyClassifyParallel gives nautyClassify's results on a
+// batch mixing graphs that refine to discrete and symmetric ones.
+void testClassifyParallel() {
+    std::cout << "\nTest 2: nautyClassifyParallel" << std::endl;
+
+    FastRng rng(2);
+    int n = 36;
+    std::vector<int64_t> batch;
+    int count = 0;
+    auto append = [&](const TestGraph& t) {
+        for (int i = 0; i < n; i++) {
+            for (int j = 0; j < n; j++) batch.push_back(t.adj[i][j] ? 1 : 0);
+        }
+        count++;
+    };
+    append(rook(6));
+    append(shuffled(rook(6), rng));
+    append(cycles(6, 6));
+    append(cubic(36, rng));
+    append(outRegular(36, 4, rng));
+    TestGraph random = emptyGraph("random", n);
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j < n; j++) random.adj[i][j] = i != j && rng.below(3) == 0;
+    }
+    append(random);
+
+    std::vector<int64_t> expected((size_t)count * n), results((size_t)count * n);
+    for (int i = 0; i < count; i++) {
+        assert(nautyClassify(batch.data() + (size_t)i * n * n, n, expected.data() + i * n, 0, 0,
+                             1) == 0);
+    }
+    int64_t stats[NAUTY_CLASSIFY_STATS];
+    for (int64_t threads : {1, 4, 0}) {
+        nautyClassifyStats(stats, 1);
+        assert(nautyClassifyParallel(batch.data(), n, results.data(), count, threads) == 0);
+        assert(results == expected && "Test 2 labelling should be nautyClassify's");
+        nautyClassifyStats(stats, 1);
+        assert(stats[0] == count && stats[1] >= 1 && stats[2] > 0);
+    }
+    assert(nautyClassifyParallel(batch.data(), 0, results.data(), 1, 2) == -1);
+}
+
+// Test case 3: nautyClassifyGroup reports nauty's group order and orbit
+// count, from the generators the threads published, on one or more
+// threads and for a batch reusing one group context.
+void testGroupOrder() {
+    std::cout << "\nTest 3: nautyClassifyGroup" << std::endl;
+
+    for (const TestGraph& t : testGraphs()) {
+        int n = t.n, m = SETWORDSNEEDED(n);
+        std::vector<graph> g = toNauty(t, m);
+        std::vector<int> lab(n);
+        std::vector<graph> canong((size_t)m * n);
+        statsblk stats;
+        canonicalLabel(g.data(), m, n, t.directed, lab.data(), canong.data(), &stats);
+        double expected = std::log10(stats.grpsize1) + stats.grpsize2;
+
+        std::vector<int64_t> matrix;
+        for (int i = 0; i < n; i++) {
+            for (int j = 0; j < n; j++) matrix.push_back(t.adj[i][j] ? 1 : 0);
+        }
+        for (int64_t threads : {1, 3}) {
+            double mantissa;
+            int64_t exponent, orbits;
+            assert(nautyClassifyGroup(matrix.data(), n, 1, threads, &mantissa, &exponent,
+                                      &orbits) == 0);
+            assert(std::fabs(std::log10(mantissa) + exponent - expected) < 1e-9 &&
+                   "Test 3 group order should be nauty's");
+            assert(orbits == stats.numorbits && "Test 3 orbits");
+        }
+        std::cout << t.name << ": ok" << std::endl;
+    }
+
+    // rook 6 and its shuffle: the same group twice.
+    FastRng rng(3);
+    std::vector<int64_t> batch;
+    for (const TestGraph& t : {rook(6), shuffled(rook(6), rng)}) {
+        for (int i = 0; i < 36; i++) {
+            for (int j = 0; j < 36; j++) batch.push_back(t.adj[i][j] ? 1 : 0);
+        }
+    }
+    double mantissa[2];
+    int64_t exponent[2], orbits[2];
+    assert(nautyClassifyGroup(batch.data(), 36, 2, 2, mantissa, exponent, orbits) == 0);
+    assert(mantissa[0] == mantissa[1] && exponent[0] == exponent[1] && orbits[0] == 1);
+    // (6!)^2 * 2
+    assert(std::fabs(mantissa[0] * std::pow(10.0, exponent[0]) - 1036800) < 1e-6);
+    assert(nautyClassifyGroup(batch.data(), 0, 1, 1, mantissa, exponent, orbits) == -1);
+}
+
+int main() {
+    std::cout << "Starting Nauty Parallel Tests" << std::endl;
+
+    testSameLabelling();
+    testClassifyParallel();
+    testGroupOrder();
+
+    std::cout << "\nAll parallel tests passed successfully!" << std::endl;
+    return 0;
+}
@@ -0,0 +1,125 @@
+#include "nautyRefine.h"
+#include "nautyCore.h"
+#include "testGraphs.h"
+#include <cassert>
+#include <iostream>
+#include <vector>
+
+static const char* KERNELS[] = {"scalar", "popcnt", "avx2", "avx512"};
+
+// Test case 1: every kernel the CPU has counts as the scalar one, for
+// lengths around each kernel's vector width.
+void testKernels() {
+    std::cout << "\nTest 1: Intersection kernels" << std::endl;
+
+    FastRng rng(1);
+    std::vector<setword> a(64), b(64);
+    for (setword& w : a) w = rng.next();
+    for (setword& w : b) w = rng.next();
+    std::cout << "Selected kernel: " << intersectKernelName() << std::endl;
+    const char* best = intersectKernelName();
+
+    std::vector<int> expected;
+    assert(selectIntersectKernel("scalar"));
+    for (int m = 0; m <= 40; m++) expected.push_back(intersectCount(a.data(), b.data(), m));
+    for (const char* name : KERNELS) {
+        if (!selectIntersectKernel(name)) {
+            std::cout << "  " << name << " not supported" << std::endl;
+            continue;
+        }
+        for (int m = 0; m <= 40; m++) {
+            assert(intersectCount(a.data(), b.data(), m) == expected[m] &&
+                   "Test 1 kernels should agree");
+        }
+    }
+    assert(!selectIntersectKernel("sse9") && "Test 1 unknown kernel");
+    selectIntersectKernel(best);
+}
+
+// Test case 2: refineWide leaves exactly what nauty's refine does, from
+// random colourings with random active cells.
+void testRefine() {
+    std::cout << "\nTest 2: Refinement matches nauty's refine" << std::endl;
+
+    const char* best = intersectKernelName();
+    FastRng rng(2);
+    for (int trial = 0; trial < 200; trial++) {
+        int n = 65 + (int)rng.below(400);
+        int m = SETWORDSNEEDED(n);
+        bool directed = trial % 4 == 0;
+        std::vector<graph> g = randomGraph(rng, n, directed, 0.02 + 0.3 * rng.uniform());
+
+        // Cells of random sizes over a random ordering.
+        std::vector<int> lab(n), ptn(n);
+        for (int i = 0; i < n; i++) lab[i] = i;
+        for (int i = n - 1; i > 0; i--) std::swap(lab[i], lab[rng.below(i + 1)]);
+        int colours = 1 + (int)rng.below(6);
+        std::vector<setword> active(m, 0);
+        int cells = 0;
+        for (int i = 0; i < n; i++) {
+            bool last = i == n - 1 || rng.below(n / colours + 1) == 0;
+            ptn[i] = last ? 0 : 1;
+            if (i == 0 || ptn[i - 1] == 0) {
+                cells++;
+                if (rng.below(2) == 0 || cells == 1) ADDELEMENT(active.data(), i);
+            }
+        }
+
+        for (const char* name : KERNELS) {
+            if (!selectIntersectKernel(name)) continue;
+            std::vector<int> lab1 = lab, ptn1 = ptn, lab2 = lab, ptn2 = ptn, count(n);
+            std::vector<setword> active1 = active, active2 = active;
+            int cells1 = cells, cells2 = cells, code1, code2;
+            {
+                NautyGuard guard;
+                refine(g.data(), lab1.data(), ptn1.data(), 0, &cells1, count.data(),
+                       active1.data(), &code1, m, n);
+            }
+            refineWide(g.data(), lab2.data(), ptn2.data(), 0, &cells2, count.data(),
+                       active2.data(), &code2, m, n);
+            assert(lab1 == lab2 && ptn1 == ptn2 && cells1 == cells2 && code1 == code2 &&
+                   active1 == active2 && "Test 2 refinement should be identical");
+        }
+    }
+    selectIntersectKernel(best);
+}
+
+// Test case 3: canonical forms through the wrapper equal plain nauty's.
+void testCanonical() {
+    std::cout << "\nTest 3: Canonical forms unchanged" << std::endl;
+
+    FastRng rng(3);
+    for (int trial = 0; trial < 30; trial++) {
+        int n = 70 + (int)rng.below(200);
+        int m = SETWORDSNEEDED(n);
+        bool directed = trial % 3 == 0;
+        // Sparse regular-ish graphs need deep refinement.
+        std::vector<graph> g = randomGraph(rng, n, directed, 4.0 / n);
+        std::vector<graph> mine((size_t)m * n), theirs((size_t)m * n);
+        std::vector<int> lab(n), ptn(n), orbits(n);
+        canonicalLabel(g.data(), m, n, directed, lab.data(), mine.data(), nullptr);
+
+        DEFAULTOPTIONS_GRAPH(options);
+        options.getcanon = TRUE;
+        options.digraph = directed ? TRUE : FALSE;
+        statsblk stats;
+        std::vector<setword> workspace(100 * m);
+        {
+            NautyGuard guard;
+            nauty(g.data(), lab.data(), ptn.data(), nullptr, orbits.data(), &options, &stats,
+                  workspace.data(), 100 * m, m, n, theirs.data());
+        }
+        assert(mine == theirs && "Test 3 canonical forms should be identical");
+    }
+}
+
+int main() {
+    std::cout << "Starting Nauty Refine Tests" << std::endl;
+
+    testKernels();
+    testRefine();
+    testCanonical();
+
+    std::cout << "\nAll refine tests passed successfully!" << std::endl;
+    return 0;
+}
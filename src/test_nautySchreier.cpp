@@ -0,0 +1,232 @@
+#include "nautySchreier.h"
+#include <cassert>
+#include <cmath>
+#include <iostream>
+#include <set>
+#include <vector>
+
+typedef std::vector<int> Perm;
+
+static double orderOf(SchreierGroup& group) {
+    double mantissa;
+    int exponent;
+    group.order(&mantissa, &exponent);
+    return mantissa * std::pow(10.0, exponent);
+}
+
+static bool sameOrder(double a, double b) {
+    return std::fabs(a - b) <= 1e-9 * b;
+}
+
+static Perm cycle(int n) {
+    Perm p(n);
+    for (int i = 0; i < n; i++) p[i] = (i + 1) % n;
+    return p;
+}
+
+static Perm transposition(int n, int a, int b) {
+    Perm p(n);
+    for (int i = 0; i < n; i++) p[i] = i;
+    std::swap(p[a], p[b]);
+    return p;
+}
+
+static Perm compose(const Perm& a, const Perm& b) {
+    Perm p(a.size());
+    for (size_t i = 0; i < a.size(); i++) p[i] = a[b[i]];
+    return p;
+}
+
+// Every element of the group generated by gens, by closure.
+static std::set<Perm> elements(const std::vector<Perm>& gens, int n) {
+    Perm id(n);
+    for (int i = 0; i < n; i++) id[i] = i;
+    std::set<Perm> seen = {id};
+    std::vector<Perm> queue = {id};
+    while (!queue.empty()) {
+        Perm p = queue.back();
+        queue.pop_back();
+        for (const Perm& g : gens) {
+            Perm q = compose(g, p);
+            if (seen.insert(q).second) queue.push_back(q);
+        }
+    }
+    return seen;
+}
+
+// Generators nauty reports for the k x k rook's graph, and its orbits.
+static std::vector<Perm> collected;
+static void collect(int, int* perm, int*, int, int, int n) {
+    collected.emplace_back(perm, perm + n);
+}
+
+static void rookGenerators(int k, std::vector<Perm>& gens, statsblk& stats,
+                           std::vector<int>& orbits) {
+    int n = k * k, m = SETWORDSNEEDED(n);
+    std::vector<graph> g((size_t)m * n, 0);
+    for (int a = 0; a < n; a++) {
+        for (int b = 0; b < n; b++) {
+            if (a != b && (a / k == b / k || a % k == b % k)) {
+                ADDELEMENT(GRAPHROW(g.data(), a, m), b);
+            }
+        }
+    }
+    std::vector<int> lab(n), ptn(n);
+    orbits.resize(n);
+    DEFAULTOPTIONS_GRAPH(options);
+    options.userautomproc = collect;
+    collected.clear();
+    {
+        NautyGuard guard;
+        densenauty(g.data(), lab.data(), ptn.data(), orbits.data(), &options, &stats, m, n,
+                   nullptr);
+    }
+    gens = collected;
+}
+
+// Test case 1: group orders and orbits of symmetric, cyclic and trivial groups.
+void testOrders() {
+    std::cout << "\nTest 1: Orders of known groups" << std::endl;
+
+    SchreierGroup group;
+    double factorial = 1;
+    for (int n = 1; n <= 15; n++) {
+        factorial *= n;
+        group.reset(n);
+        if (n > 1) group.addGenerator(transposition(n, 0, 1).data());
+        group.addGenerator(cycle(n).data());
+        assert(sameOrder(orderOf(group), factorial) && "Test 1 symmetric group order");
+        std::vector<int> orbits(n);
+        assert(group.orbits(orbits.data()) == 1);
+    }
+
+    group.reset(12);
+    group.addGenerator(cycle(12).data());
+    assert(sameOrder(orderOf(group), 12) && "Test 1 cyclic group order");
+    group.addGenerator(compose(cycle(12), cycle(12)).data());
+    assert(sameOrder(orderOf(group), 12) && "Test 1 redundant generator");
+
+    group.reset(7);
+    std::vector<int> orbits(7);
+    assert(sameOrder(orderOf(group), 1) && group.orbits(orbits.data()) == 7);
+    Perm id = transposition(7, 3, 3);
+    group.addGenerator(id.data());
+    assert(sameOrder(orderOf(group), 1) && "Test 1 identity generator");
+
+    // (0 1)(2 3) and (4 5 6): order 6, orbits {0,1} {2,3} {4,5,6}.
+    Perm p = {1, 0, 3, 2, 5, 6, 4};
+    group.addGenerator(p.data());
+    assert(sameOrder(orderOf(group), 6));
+    assert(group.orbits(orbits.data()) == 3);
+    assert((orbits == std::vector<int>{0, 0, 2, 2, 4, 4, 4}));
+    assert(group.orbitRepresentative(6) == 4 && group.numGenerators() == 2);
+
+    // Far more generators than the first segments hold: none is dropped.
+    group.reset(4);
+    Perm swap = transposition(4, 0, 1);
+    for (int i = 0; i < (1 << 21); i++) group.addGenerator(swap.data());
+    group.addGenerator(cycle(4).data());
+    assert(group.numGenerators() == (1 << 21) + 1);
+    assert(sameOrder(orderOf(group), 24) && "Test 1 last of many generators kept");
+    std::cout << "ok" << std::endl;
+}
+
+// Test case 2: the group from nauty's generators has nauty's order and
+// orbits, and for small groups the order counts every element.
+void testNautyGenerators() {
+    std::cout << "\nTest 2: Groups from nauty's generators" << std::endl;
+
+    SchreierGroup group;
+    for (int k = 2; k <= 7; k++) {
+        std::vector<Perm> gens;
+        statsblk stats;
+        std::vector<int> nautyOrbits;
+        rookGenerators(k, gens, stats, nautyOrbits);
+        int n = k * k;
+        group.reset(n);
+        for (const Perm& g : gens) group.addGenerator(g.data());
+        assert(sameOrder(orderOf(group), stats.grpsize1 * std::pow(10.0, stats.grpsize2)) &&
+               "Test 2 order should be nauty's");
+        std::vector<int> orbits(n);
+        assert(group.orbits(orbits.data()) == stats.numorbits && orbits == nautyOrbits);
+
+        if (k > 3) continue;
+        std::set<Perm> all = elements(gens, n);
+        assert(sameOrder(orderOf(group), (double)all.size()));
+    }
+    std::cout << "ok" << std::endl;
+}
+
+// Test case 3: generators added from several threads at once, with queries
+// in between, give the same group as adding them in turn.
+void testConcurrentGenerators() {
+    std::cout << "\nTest 3: Concurrent generators" << std::endl;
+
+    std::vector<Perm> gens;
+    statsblk stats;
+    std::vector<int> nautyOrbits;
+    rookGenerators(6, gens, stats, nautyOrbits);
+    int n = 36;
+    double expected = stats.grpsize1 * std::pow(10.0, stats.grpsize2);
+
+    SchreierGroup group(n);
+    int threads = 4, perThread = 500;
+    runThreads(threads, [&](int t) {
+        FastRng rng(t + 1);
+        Perm p = gens[0];
+        std::vector<int> orbits(n);
+        for (int i = 0; i < perThread; i++) {
+            // Random products of the generators, and the generators themselves.
+            p = compose(gens[rng.below(gens.size())], p);
+            group.addGenerator(i < (int)gens.size() ? gens[i].data() : p.data());
+            if (i % 100 == 0) group.orbits(orbits.data());
+            if (t == 0 && i % 250 == 0) orderOf(group);
+        }
+    });
+    assert(group.numGenerators() == (size_t)threads * perThread);
+    assert(sameOrder(orderOf(group), expected) && "Test 3 order");
+    std::vector<int> orbits(n);
+    assert(group.orbits(orbits.data()) == stats.numorbits && orbits == nautyOrbits);
+    std::cout << "ok" << std::endl;
+}
+
+// Test case 4: independent contexts on several threads, each reset between
+// degrees; rounds of one degree reuse the memory of the last.
+void testIndependentContexts() {
+    std::cout << "\nTest 4: Independent contexts" << std::endl;
+
+    runThreads(4, [&](int t) {
+        SchreierGroup group;
+        for (int round = 0; round < 30; round++) {
+            int n = 6 + (round + t) % 5;
+            group.reset(n);
+            group.addGenerator(transposition(n, 0, n - 1).data());
+            group.addGenerator(cycle(n).data());
+            double factorial = 1;
+            for (int i = 2; i <= n; i++) factorial *= i;
+            assert(sameOrder(orderOf(group), factorial) && "Test 4 order");
+        }
+        size_t bytes[3];
+        for (size_t& b : bytes) {
+            group.reset(12);
+            group.addGenerator(transposition(12, 0, 1).data());
+            group.addGenerator(cycle(12).data());
+            orderOf(group);
+            b = group.retainedBytes();
+        }
+        assert(bytes[2] == bytes[1] && "Test 4 memory reused");
+    });
+    std::cout << "ok" << std::endl;
+}
+
+int main() {
+    std::cout << "Starting Nauty Schreier Tests" << std::endl;
+
+    testOrders();
+    testNautyGenerators();
+    testConcurrentGenerators();
+    testIndependentContexts();
+
+    std::cout << "\nAll Schreier tests passed successfully!" << std::endl;
+    return 0;
+}
@@ -0,0 +1,186 @@
+#include "nautySetOps.h"
+#include "testGraphs.h"
+#include <cassert>
+#include <iostream>
+#include <vector>
+
+static const char* LEVELS[] = {"generic", "popcnt", "avx2"};
+
+// A random partition of 0..n-1 into up to `colours` cells, with a random
+// subset of the cells active.
+static int randomPartition(FastRng& rng, int n, int colours, std::vector<int>& lab,
+                           std::vector<int>& ptn, std::vector<setword>& active) {
+    lab.resize(n);
+    ptn.resize(n);
+    active.assign(SETWORDSNEEDED(n), 0);
+    for (int i = 0; i < n; i++) lab[i] = i;
+    for (int i = n - 1; i > 0; i--) std::swap(lab[i], lab[rng.below(i + 1)]);
+    int cells = 0;
+    for (int i = 0; i < n; i++) {
+        bool last = i == n - 1 || rng.below(n / colours + 1) == 0;
+        ptn[i] = last ? 0 : 1;
+        if (i == 0 || ptn[i - 1] == 0) {
+            cells++;
+            if (rng.below(2) == 0 || cells == 1) ADDELEMENT(active.data(), i);
+        }
+    }
+    return cells;
+}
+
+// Test case 1: the builtin primitives agree with nauty's macros.
+void testPrimitives() {
+    std::cout << "\nTest 1: Set primitives" << std::endl;
+
+    FastRng rng(1);
+    for (int trial = 0; trial < 10000; trial++) {
+        setword x = rng.next() >> rng.below(WORDSIZE);
+        assert(setwordPopcount(x) == POPCOUNT(x) && "Test 1 popcount");
+        if (x) assert(setwordFirstBit(x) == FIRSTBITNZ(x) && "Test 1 first bit");
+    }
+
+    std::vector<setword> s(5);
+    for (int trial = 0; trial < 1000; trial++) {
+        for (setword& w : s) w = rng.below(3) == 0 ? 0 : rng.next() & rng.next() & rng.next();
+        int m = 1 + (int)rng.below(5);
+        for (int pos = -1; pos < m * WORDSIZE; pos++) {
+            assert(nextElement(s.data(), m, pos) == nextelement(s.data(), m, pos) &&
+                   "Test 1 nextelement");
+        }
+    }
+}
+
+// Test case 2: every level's dispatch entries give what naugraph.c's do.
+void testDispatch() {
+    std::cout << "\nTest 2: Dispatch vector matches naugraph" << std::endl;
+
+    const char* best = setOpsName();
+    std::cout << "Selected level: " << best << std::endl;
+    FastRng rng(2);
+    for (int trial = 0; trial < 300; trial++) {
+        int n = trial % 2 == 0 ? 2 + (int)rng.below(WORDSIZE - 1) : 65 + (int)rng.below(200);
+        int m = SETWORDSNEEDED(n);
+        bool directed = trial % 3 == 0;
+        std::vector<graph> g = randomGraph(rng, n, directed, 0.05 + 0.4 * rng.uniform());
+        std::vector<int> lab, ptn;
+        std::vector<setword> active;
+        int cells = randomPartition(rng, n, 1 + (int)rng.below(6), lab, ptn, active);
+
+        std::vector<int> perm(n);
+        for (int i = 0; i < n; i++) perm[i] = i;
+        if (trial % 4 != 0) {
+            for (int i = n - 1; i > 0; i--) std::swap(perm[i], perm[rng.below(i + 1)]);
+        }
+        std::vector<graph> canong((size_t)m * n);
+        {
+            NautyGuard guard;
+            updatecan(g.data(), canong.data(), perm.data(), 0, m, n);
+        }
+        // A near miss for testcanlab: one vertex moved.
+        std::vector<int> lab2 = perm;
+        if (trial % 2 == 1) std::swap(lab2[rng.below(n)], lab2[rng.below(n)]);
+
+        for (const char* name : LEVELS) {
+            if (!selectSetOps(name)) {
+                if (trial == 0) std::cout << "  " << name << " not supported" << std::endl;
+                continue;
+            }
+            const dispatchvec* d = graphDispatch();
+            NautyGuard guard;
+
+            assert(d->isautom(g.data(), perm.data(), directed, m, n) ==
+                       isautom(g.data(), perm.data(), directed, m, n) &&
+                   "Test 2 isautom");
+
+            int rows1, rows2;
+            int cmp1 = testcanlab(g.data(), canong.data(), lab2.data(), &rows1, m, n);
+            int cmp2 = d->testcanlab(g.data(), canong.data(), lab2.data(), &rows2, m, n);
+            assert(cmp1 == cmp2 && rows1 == rows2 && "Test 2 testcanlab");
+
+            std::vector<graph> can1 = canong, can2 = canong;
+            int same = (int)rng.below(n);
+            updatecan(g.data(), can1.data(), lab2.data(), same, m, n);
+            d->updatecan(g.data(), can2.data(), lab2.data(), same, m, n);
+            assert(can1 == can2 && "Test 2 updatecan");
+
+            int hint = rng.below(2) == 0 ? -1 : (int)rng.below(n);
+            for (int tcLevel : {-1, 100}) {
+                assert(d->targetcell(g.data(), lab.data(), ptn.data(), 0, tcLevel, directed,
+                                     hint, m, n) ==
+                           targetcell(g.data(), lab.data(), ptn.data(), 0, tcLevel, directed,
+                                      hint, m, n) &&
+                       "Test 2 targetcell");
+                assert(graphDispatch(TARGET_FIRST)->targetcell(g.data(), lab.data(), ptn.data(),
+                                                               0, tcLevel, directed, hint, m,
+                                                               n) ==
+                           targetcell(g.data(), lab.data(), ptn.data(), 0, -1, directed, hint,
+                                      m, n) &&
+                       "Test 2 first target cell");
+                assert(graphDispatch(TARGET_BEST)->targetcell(g.data(), lab.data(), ptn.data(),
+                                                              0, tcLevel, directed, hint, m,
+                                                              n) ==
+                           targetcell(g.data(), lab.data(), ptn.data(), 0, directed ? -1 : 100,
+                                      directed, hint, m, n) &&
+                       "Test 2 best target cell");
+            }
+
+            if (m == 1) {
+                std::vector<int> lab1 = lab, ptn1 = ptn, lab3 = lab, ptn3 = ptn, count(n);
+                std::vector<setword> active1 = active, active3 = active;
+                int cells1 = cells, cells3 = cells, code1, code3;
+                refine1(g.data(), lab1.data(), ptn1.data(), 0, &cells1, count.data(),
+                        active1.data(), &code1, m, n);
+                d->refine1(g.data(), lab3.data(), ptn3.data(), 0, &cells3, count.data(),
+                           active3.data(), &code3, m, n);
+                assert(lab1 == lab3 && ptn1 == ptn3 && cells1 == cells3 && code1 == code3 &&
+                       active1 == active3 && "Test 2 refine1");
+            }
+        }
+    }
+    selectSetOps(best);
+}
+
+// Test case 3: canonical forms on every level equal plain nauty's.
+void testCanonical() {
+    std::cout << "\nTest 3: Canonical forms unchanged" << std::endl;
+
+    const char* best = setOpsName();
+    FastRng rng(3);
+    for (int trial = 0; trial < 40; trial++) {
+        int n = trial % 2 == 0 ? 5 + (int)rng.below(WORDSIZE - 5) : 70 + (int)rng.below(150);
+        int m = SETWORDSNEEDED(n);
+        bool directed = trial % 3 == 0;
+        std::vector<graph> g = randomGraph(rng, n, directed, 4.0 / n);
+        std::vector<graph> theirs((size_t)m * n);
+        std::vector<int> lab(n), ptn(n), orbits(n);
+
+        DEFAULTOPTIONS_GRAPH(options);
+        options.getcanon = TRUE;
+        options.digraph = directed ? TRUE : FALSE;
+        statsblk stats;
+        std::vector<setword> workspace(100 * m);
+        {
+            NautyGuard guard;
+            nauty(g.data(), lab.data(), ptn.data(), nullptr, orbits.data(), &options, &stats,
+                  workspace.data(), 100 * m, m, n, theirs.data());
+        }
+
+        for (const char* name : LEVELS) {
+            if (!selectSetOps(name)) continue;
+            std::vector<graph> mine((size_t)m * n);
+            canonicalLabel(g.data(), m, n, directed, lab.data(), mine.data(), nullptr);
+            assert(mine == theirs && "Test 3 canonical forms should be identical");
+        }
+    }
+    selectSetOps(best);
+}
+
+int main() {
+    std::cout << "Starting Nauty Set Ops Tests" << std::endl;
+
+    testPrimitives();
+    testDispatch();
+    testCanonical();
+
+    std::cout << "\nAll set ops tests passed successfully!" << std::endl;
+    return 0;
+}
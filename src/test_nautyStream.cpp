@@ -0,0 +1,477 @@
+#include "nautyStream.h"
+#include "nautyDedup.h"
+#include "nautyCore.h"
+#include "nautyFormat.h"
+#include <gtools.h>
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <sys/stat.h>
+#include <thread>
+#include <vector>
+#include <zlib.h>
+
+typedef std::vector<std::vector<bool>> Matrix;
+
+// graph6 (upper triangle by columns) or digraph6 (full matrix by rows).
+static std::string encode(const Matrix& adj, bool directed) {
+    int n = adj.size();
+    std::string s = directed ? "&" : "";
+    if (n <= 62) {
+        s += (char)(63 + n);
+    } else {
+        s += '~';
+        for (int shift = 12; shift >= 0; shift -= 6) s += (char)(63 + ((n >> shift) & 63));
+    }
+    int bits = 0, x = 0;
+    auto put = [&](bool bit) {
+        x = (x << 1) | bit;
+        if (++bits == 6) {
+            s += (char)(63 + x);
+            bits = x = 0;
+        }
+    };
+    if (directed) {
+        for (int i = 0; i < n; i++)
+            for (int j = 0; j < n; j++) put(adj[i][j]);
+    } else {
+        for (int j = 1; j < n; j++)
+            for (int i = 0; i < j; i++) put(adj[i][j]);
+    }
+    if (bits) s += (char)(63 + (x << (6 - bits)));
+    return s;
+}
+
+static Matrix randomGraph(int n, bool directed) {
+    Matrix adj(n, std::vector<bool>(n, false));
+    for (int i = 0; i < n; i++)
+        for (int j = 0; j < n; j++)
+            if (i != j && (directed || i < j) && rand() % 3 == 0) {
+                adj[i][j] = true;
+                if (!directed) adj[j][i] = true;
+            }
+    return adj;
+}
+
+static Matrix permute(const Matrix& adj) {
+    int n = adj.size();
+    std::vector<int> perm(n);
+    for (int i = 0; i < n; i++) perm[i] = i;
+    std::random_shuffle(perm.begin(), perm.end());
+    Matrix out(n, std::vector<bool>(n, false));
+    for (int i = 0; i < n; i++)
+        for (int j = 0; j < n; j++) out[perm[i]][perm[j]] = adj[i][j];
+    return out;
+}
+
+static std::vector<std::string> readLines(const std::string& path) {
+    std::ifstream f(path);
+    std::vector<std::string> lines;
+    std::string line;
+    while (std::getline(f, line)) lines.push_back(line);
+    return lines;
+}
+
+static std::string readFile(const std::string& path) {
+    std::ifstream f(path, std::ios::binary);
+    std::stringstream ss;
+    ss << f.rdbuf();
+    return ss.str();
+}
+
+// Input: NUM graphs, then relabelled copies of the same graphs, mixing
+// graph6 and digraph6 and sizes that need more than one setword per row.
+// The file is a few megabytes, so it spans several read batches.
+static const int NUM = 40000;
+static std::string inputPath = "/tmp/nauty_stream_test_in.g6";
+static std::string outputPath = "/tmp/nauty_stream_test_out";
+
+static void writeInput() {
+    srand(3);
+    std::vector<Matrix> graphs;
+    std::vector<bool> directed;
+    for (int i = 0; i < NUM; i++) {
+        int n = (i % 100 == 0) ? 70 + rand() % 20 : 3 + rand() % 10;
+        directed.push_back(i % 3 == 0);
+        graphs.push_back(randomGraph(n, directed.back()));
+    }
+    std::ofstream f(inputPath);
+    f << ">>graph6<<";
+    for (int i = 0; i < NUM; i++) f << encode(graphs[i], directed[i]) << "\n";
+    for (int i = 0; i < NUM; i++) f << encode(permute(graphs[i]), directed[i]) << "\r\n";
+}
+
+// BGZF, as bgzip writes it: gzip members of at most 64 KiB, each recording
+// its compressed size, ending with an empty member.
+static std::string bgzf(const std::string& text) {
+    std::string out;
+    auto member = [&](const char* data, size_t len) {
+        z_stream z;
+        std::memset(&z, 0, sizeof(z));
+        deflateInit2(&z, 6, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY);
+        std::string body(compressBound(len) + 16, '\0');
+        z.next_in = (Bytef*)data;
+        z.avail_in = len;
+        z.next_out = (Bytef*)&body[0];
+        z.avail_out = body.size();
+        deflate(&z, Z_FINISH);
+        body.resize(z.total_out);
+        deflateEnd(&z);
+        size_t bsize = 18 + body.size() + 8 - 1;
+        const unsigned char header[18] = {0x1f, 0x8b, 8, 4, 0, 0, 0, 0, 0, 0xff, 6, 0,
+                                          'B', 'C', 2, 0, (unsigned char)bsize,
+                                          (unsigned char)(bsize >> 8)};
+        out.append((const char*)header, 18);
+        out += body;
+        uint32_t trailer[2] = {(uint32_t)crc32(0, (const Bytef*)data, len), (uint32_t)len};
+        out.append((const char*)trailer, 8);
+    };
+    for (size_t at = 0; at < text.size(); at += 60000) {
+        member(text.data() + at, std::min<size_t>(60000, text.size() - at));
+    }
+    member("", 0);
+    return out;
+}
+
+// Ordinary gzip, split into members of the given size.
+static std::string gzip(const std::string& text, size_t memberSize) {
+    std::string out;
+    for (size_t at = 0; at < text.size(); at += memberSize) {
+        size_t len = std::min(memberSize, text.size() - at);
+        z_stream z;
+        std::memset(&z, 0, sizeof(z));
+        deflateInit2(&z, 6, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY);
+        std::string member(compressBound(len) + 64, '\0');
+        z.next_in = (Bytef*)text.data() + at;
+        z.avail_in = len;
+        z.next_out = (Bytef*)&member[0];
+        z.avail_out = member.size();
+        deflate(&z, Z_FINISH);
+        member.resize(z.total_out);
+        deflateEnd(&z);
+        out += member;
+    }
+    return out;
+}
+
+// Test case 1: ordered canonical output pairs up relabelled copies.
+void testOrderedCanonical() {
+    std::cout << "\nTest 1: Ordered canonical strings" << std::endl;
+
+    int64_t graphs = 0;
+    int64_t ret = nautyClassifyStream(inputPath.c_str(), outputPath.c_str(),
+                                      NAUTY_OUTPUT_CANONICAL, 1, 4, &graphs);
+    assert(ret == 0 && "Test 1 should succeed");
+    assert(graphs == 2 * NUM && "Test 1 should label every graph");
+
+    std::vector<std::string> lines = readLines(outputPath);
+    assert(lines.size() == 2 * NUM && "Test 1 should write one line per graph");
+    for (int i = 0; i < NUM; i++) {
+        assert(lines[i] == lines[i + NUM] && "Test 1 copies should match");
+        assert((lines[i][0] == '&') == (i % 3 == 0) && "Test 1 should keep the format");
+    }
+}
+
+// Test case 2: unordered output is a permutation of the ordered output.
+void testUnordered() {
+    std::cout << "\nTest 2: Unordered output" << std::endl;
+
+    nautyClassifyStream(inputPath.c_str(), outputPath.c_str(), NAUTY_OUTPUT_CANONICAL, 1, 3,
+                        nullptr);
+    std::vector<std::string> ordered = readLines(outputPath);
+    int64_t ret = nautyClassifyStream(inputPath.c_str(), outputPath.c_str(),
+                                      NAUTY_OUTPUT_CANONICAL, 0, 3, nullptr);
+    std::vector<std::string> unordered = readLines(outputPath);
+    assert(ret == 0 && "Test 2 should succeed");
+
+    std::sort(ordered.begin(), ordered.end());
+    std::sort(unordered.begin(), unordered.end());
+    assert(ordered == unordered && "Test 2 should produce the same lines");
+}
+
+// Test case 3: binary hashes are 16 bytes and pair up like the strings.
+void testHashes() {
+    std::cout << "\nTest 3: Binary hashes" << std::endl;
+
+    int64_t ret = nautyClassifyStream(inputPath.c_str(), outputPath.c_str(),
+                                      NAUTY_OUTPUT_HASH, 1, 2, nullptr);
+    assert(ret == 0 && "Test 3 should succeed");
+
+    std::string data = readFile(outputPath);
+    assert(data.size() == 16 * 2 * NUM && "Test 3 should write 16 bytes per graph");
+    for (int i = 0; i < NUM; i++)
+        assert(data.compare(16 * i, 16, data, 16 * (i + NUM), 16) == 0 &&
+               "Test 3 hashes of copies should match");
+    assert(data.compare(0, 16, data, 16, 16) != 0 && "Test 3 different graphs differ");
+}
+
+// Test case 4: malformed lines and bad paths are reported.
+void testErrors() {
+    std::cout << "\nTest 4: Errors" << std::endl;
+
+    std::string bad = "/tmp/nauty_stream_test_bad.g6";
+    {
+        std::ofstream f(bad);
+        f << "Bw\nBw!!\nBw\n";
+    }
+    int64_t graphs = 0;
+    int64_t ret = nautyClassifyStream(bad.c_str(), outputPath.c_str(), NAUTY_OUTPUT_CANONICAL,
+                                      1, 1, &graphs);
+    assert(ret == -3 && graphs == 1 && "Test 4 should stop at the malformed line");
+    assert(nautyClassifyStream("/nonexistent/in", outputPath.c_str(), 0, 1, 1, nullptr) == -1);
+    assert(nautyClassifyStream(bad.c_str(), "/nonexistent/out", 0, 1, 1, nullptr) == -2);
+    assert(nautyClassifyStream(bad.c_str(), outputPath.c_str(), 7, 1, 1, nullptr) == -4);
+
+    // A ten-byte sparse6 line claiming a million vertices is rejected, not
+    // allocated.
+    {
+        std::ofstream f(bad);
+        f << "Bw\n:~~??BsH?\n";
+    }
+    ret = nautyClassifyStream(bad.c_str(), outputPath.c_str(), NAUTY_OUTPUT_CANONICAL, 1, 1,
+                              &graphs);
+    assert(ret == -3 && graphs == 1 && "Test 4 should reject a graph too large to label");
+    std::remove(bad.c_str());
+}
+
+// Test case 5: the vectorised decoder matches stringtograph on random
+// strings of every length class, including rows of several setwords.
+void testDecoder() {
+    std::cout << "\nTest 5: Decoder against stringtograph" << std::endl;
+
+    srand(5);
+    for (int trial = 0; trial < 2000; trial++) {
+        int n = trial < 200 ? trial % 100 + 1 : 1 + rand() % 300;
+        bool directed = trial % 2 == 1;
+        size_t bodyLen = directed ? ((size_t)n * n + 5) / 6 : ((size_t)n * (n - 1) / 2 + 5) / 6;
+        Matrix empty(n, std::vector<bool>(n, false));
+        std::string s = encode(empty, directed);
+        size_t header = s.size() - bodyLen;
+        for (size_t i = header; i < s.size(); i++) s[i] = (char)(63 + rand() % 64);
+
+        int m = SETWORDSNEEDED(n);
+        std::vector<graph> expected(m * n), actual(m * n, ~(setword)0);
+        std::string line = s + "\n";
+        stringtograph(&line[0], expected.data(), m);
+
+        std::vector<uint8_t> bits(unpackedSize(bodyLen));
+        unpackSixBit(s.data() + header, bodyLen, bits.data());
+        if (directed) {
+            digraph6Rows(bits.data(), m, n, actual.data());
+        } else {
+            graph6Rows(bits.data(), m, n, actual.data());
+        }
+        assert(expected == actual && "Test 5 rows should match stringtograph");
+    }
+
+    std::vector<size_t> ends;
+    std::string text = "a\nbb\n\nccc";
+    text += std::string(40, 'x') + "\n";
+    findLineEnds(text.data(), text.size(), ends);
+    assert((ends == std::vector<size_t>{2, 5, 6, text.size()}) && "Test 5 line ends");
+}
+
+// Test case 6: a pipe, which cannot be mapped, gives the same output as the
+// mapped file.
+void testPipeInput() {
+    std::cout << "\nTest 6: Pipe input" << std::endl;
+
+    nautyClassifyStream(inputPath.c_str(), outputPath.c_str(), NAUTY_OUTPUT_CANONICAL, 1, 2,
+                        nullptr);
+    std::string mapped = readFile(outputPath);
+
+    std::string fifo = "/tmp/nauty_stream_test_fifo";
+    std::remove(fifo.c_str());
+    assert(mkfifo(fifo.c_str(), 0600) == 0 && "Test 6 should create a fifo");
+    std::thread writer([&] {
+        std::string data = readFile(inputPath);
+        std::ofstream f(fifo, std::ios::binary);
+        f << data;
+    });
+    int64_t ret = nautyClassifyStream(fifo.c_str(), outputPath.c_str(),
+                                      NAUTY_OUTPUT_CANONICAL, 1, 2, nullptr);
+    writer.join();
+    std::remove(fifo.c_str());
+    assert(ret == 0 && readFile(outputPath) == mapped && "Test 6 output should match");
+}
+
+// Test case 7: labelg-compatible labelling keeps the header, pairs up
+// relabelled copies with and without an invariant, and checks arguments.
+void testLabelg() {
+    std::cout << "\nTest 7: labelg-compatible labelling" << std::endl;
+
+    for (int invariant : {0, 8}) {
+        int64_t graphs = 0;
+        int64_t ret = nautyLabelStream(inputPath.c_str(), outputPath.c_str(), nullptr,
+                                       invariant, 0, 2, 3, 3, &graphs);
+        assert(ret == 0 && graphs == 2 * NUM && "Test 7 should label every graph");
+
+        std::vector<std::string> lines = readLines(outputPath);
+        assert(lines.size() == 2 * NUM && "Test 7 should write one line per graph");
+        assert(lines[0].compare(0, 10, ">>graph6<<") == 0 && "Test 7 should keep the header");
+        lines[0].erase(0, 10);
+        for (int i = 0; i < NUM; i++)
+            assert(lines[i] == lines[i + NUM] && "Test 7 copies should match");
+    }
+
+    assert(nautyLabelStream(inputPath.c_str(), outputPath.c_str(), nullptr, 17, 1, 1, 3, 1,
+                            nullptr) == -4 && "Test 7 should reject unknown invariants");
+}
+
+// Test case 8: incremental sparse6 input, where most lines only toggle
+// edges of the graph before them, labels as the equivalent sparse6 file
+// does, from a mapped file or a pipe, across many batches.
+void testIncremental() {
+    std::cout << "\nTest 8: Incremental sparse6" << std::endl;
+
+    const int N = 40, COUNT = 200000;
+    std::string is6Path = "/tmp/nauty_stream_test_in.is6";
+    std::string s6Path = "/tmp/nauty_stream_test_in.s6";
+    std::string expected = "/tmp/nauty_stream_test_expected";
+    srand(8);
+    for (int keyframes : {500, COUNT}) {
+        std::vector<graph> g(N, 0), prev(N, 0);
+        {
+            std::ofstream is6(is6Path), s6(s6Path);
+            for (int i = 0; i < COUNT; i++) {
+                for (int k = 0; k < 3; k++) {
+                    int a = rand() % N, b = rand() % N;
+                    if (a == b) continue;
+                    FLIPELEMENT(GRAPHROW(g.data(), a, 1), b);
+                    FLIPELEMENT(GRAPHROW(g.data(), b, 1), a);
+                }
+                is6 << ntois6(g.data(), i % keyframes ? prev.data() : nullptr, 1, N);
+                s6 << ntos6(g.data(), 1, N);
+                prev = g;
+            }
+        }
+
+        int64_t graphs = 0;
+        assert(nautyClassifyStream(s6Path.c_str(), expected.c_str(), NAUTY_OUTPUT_CANONICAL, 1,
+                                   1, nullptr) == 0);
+        int64_t ret = nautyClassifyStream(is6Path.c_str(), outputPath.c_str(),
+                                          NAUTY_OUTPUT_CANONICAL, 1, 4, &graphs);
+        assert(ret == 0 && graphs == COUNT && "Test 8 should label every graph");
+        assert(readFile(outputPath) == readFile(expected) && "Test 8 output should match");
+
+        std::string fifo = "/tmp/nauty_stream_test_fifo";
+        std::remove(fifo.c_str());
+        assert(mkfifo(fifo.c_str(), 0600) == 0);
+        std::thread writer([&] {
+            std::string data = readFile(is6Path);
+            std::ofstream f(fifo, std::ios::binary);
+            f << data;
+        });
+        ret = nautyClassifyStream(fifo.c_str(), outputPath.c_str(), NAUTY_OUTPUT_CANONICAL, 1, 4,
+                                  nullptr);
+        writer.join();
+        std::remove(fifo.c_str());
+        assert(ret == 0 && readFile(outputPath) == readFile(expected) &&
+               "Test 8 pipe output should match");
+
+        // Kept incremental lines are written out whole.
+        nautyDedupStream(s6Path.c_str(), expected.c_str(), NAUTY_DEDUP_INPUT, NAUTY_HASH_FAST,
+                         128, 1, nullptr, nullptr);
+        nautyDedupStream(is6Path.c_str(), outputPath.c_str(), NAUTY_DEDUP_INPUT,
+                         NAUTY_HASH_FAST, 128, 4, nullptr, nullptr);
+        assert(readFile(outputPath) == readFile(expected) && "Test 8 dedup should match");
+    }
+
+    std::ofstream(is6Path) << ";Bc\n";
+    assert(nautyClassifyStream(is6Path.c_str(), outputPath.c_str(), NAUTY_OUTPUT_CANONICAL, 1,
+                               1, nullptr) == -3 && "Test 8 needs a graph to start from");
+    std::remove(is6Path.c_str());
+    std::remove(s6Path.c_str());
+    std::remove(expected.c_str());
+}
+
+// Test case 9: queue statistics describe the calling thread's last run.
+void testStats() {
+    std::cout << "\nTest 9: Queue statistics" << std::endl;
+
+    nautyClassifyStream(inputPath.c_str(), outputPath.c_str(), NAUTY_OUTPUT_HASH, 1, 2,
+                        nullptr);
+    int64_t stats[NAUTY_STREAM_STATS];
+    assert(nautyStreamStats(stats) == 0);
+    struct stat st;
+    stat(inputPath.c_str(), &st);
+    assert(stats[0] >= st.st_size >> 20 && stats[0] <= (st.st_size >> 20) + 2 &&
+           "Test 9 should count about one batch per MiB");
+    assert(stats[4] == 4 && "Test 9 capacity is two batches per worker");
+    assert(stats[3] >= 0 && stats[3] <= stats[0] * stats[4] && "Test 9 depth within capacity");
+
+    std::thread other([] {
+        int64_t mine[NAUTY_STREAM_STATS];
+        nautyStreamStats(mine);
+        assert(mine[0] == 0 && "Test 9 another thread has no run yet");
+    });
+    other.join();
+}
+
+// Test case 10: gzip input, as one member, many members or BGZF, from a
+// file or a pipe, labels as the uncompressed file does.
+void testCompressed() {
+    std::cout << "\nTest 10: Compressed input" << std::endl;
+
+    nautyClassifyStream(inputPath.c_str(), outputPath.c_str(), NAUTY_OUTPUT_CANONICAL, 1, 2,
+                        nullptr);
+    std::string expected = readFile(outputPath);
+    std::string text = readFile(inputPath);
+    std::string gzPath = "/tmp/nauty_stream_test_in.g6.gz";
+    std::string fifo = "/tmp/nauty_stream_test_fifo";
+
+    for (const std::string& data : {gzip(text, text.size()), gzip(text, 100000), bgzf(text)}) {
+        std::ofstream(gzPath, std::ios::binary) << data;
+        int64_t graphs = 0;
+        int64_t ret = nautyClassifyStream(gzPath.c_str(), outputPath.c_str(),
+                                          NAUTY_OUTPUT_CANONICAL, 1, 3, &graphs);
+        assert(ret == 0 && graphs == 2 * NUM && readFile(outputPath) == expected &&
+               "Test 10 compressed file should label as plain text");
+
+        std::remove(fifo.c_str());
+        assert(mkfifo(fifo.c_str(), 0600) == 0);
+        std::thread writer([&] {
+            std::ofstream f(fifo, std::ios::binary);
+            f << data;
+        });
+        ret = nautyClassifyStream(fifo.c_str(), outputPath.c_str(), NAUTY_OUTPUT_CANONICAL, 1,
+                                  2, nullptr);
+        writer.join();
+        std::remove(fifo.c_str());
+        assert(ret == 0 && readFile(outputPath) == expected &&
+               "Test 10 compressed pipe should label as plain text");
+
+        // A truncated stream is a read error, not a short success.
+        std::ofstream(gzPath, std::ios::binary) << data.substr(0, data.size() / 2);
+        assert(nautyClassifyStream(gzPath.c_str(), outputPath.c_str(), NAUTY_OUTPUT_CANONICAL,
+                                   1, 2, nullptr) == -1 && "Test 10 truncated input");
+    }
+    std::remove(gzPath.c_str());
+}
+
+int main() {
+    std::cout << "Starting Nauty Stream Tests" << std::endl;
+
+    writeInput();
+    testOrderedCanonical();
+    testUnordered();
+    testHashes();
+    testErrors();
+    testDecoder();
+    testPipeInput();
+    testLabelg();
+    testIncremental();
+    testStats();
+    testCompressed();
+    std::remove(inputPath.c_str());
+    std::remove(outputPath.c_str());
+
+    std::cout << "\nAll stream tests passed successfully!" << std::endl;
+    return 0;
+}